@@ -0,0 +1,532 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/dvhop-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/spectrum-module.h"
+#include "ns3/propagation-module.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <sys/resource.h>
+
+using namespace ns3;
+
+/**
+ * \brief Unattended DV-Hop benchmark.
+ *
+ * Generates a topology, picks the beacons, runs the protocol over ad hoc Wi-Fi
+ * limited to a unit disk of --range meters, and measures the run: wall-clock time,
+ * simulator events per second, peak RSS, DV-Hop control traffic and localization
+ * error. The summary goes to stdout and, as JSON, to --summary.
+ *
+ * With --analytical the packets are skipped altogether: dvhop::AnalyticalEngine
+ * computes the converged tables, hop sizes and positions straight from the same
+ * topology and beacons, for sweeps over many parameter points. --localization
+ * writes the per-node errors of either mode in the CSV format of dvhop-example.
+ *
+ * --channel=grid replaces the YANS channel by a dvhop::GridSpectrumChannel (and the
+ * PHYs by SpectrumWifiPhys) which only visits, and caches the losses to, the PHYs
+ * within --range of each transmitter.
+ *
+ * --channel=unitdisk drops Wi-Fi altogether for dvhop::UnitDiskNetDevices: every node
+ * within --range receives each frame after a fixed delay, with no MAC or PHY events.
+ * Compare its events and wall time with the yans run of the same scenario to see what
+ * the Wi-Fi model costs at protocol scale.
+ *
+ * Topologies, all over a square sized so that a node has --density neighbours on
+ * average:
+ *  - grid: nodes on a square grid
+ *  - random: uniform over the square
+ *  - clustered: gaussian clusters of about 50 nodes around uniform centres
+ *  - cshape: uniform over a C, the square without a notch open on the right side,
+ *    the classic anisotropic case for DV-Hop
+ *
+ * --converge stops the packet-level run once no DV-Hop table has changed for
+ * --quietIntervals HELLO intervals, instead of at --time; either way the summary holds the
+ * convergence time, the time of the last table change. --verify checks the converged
+ * tables against a breadth-first search over the unit disk.
+ *
+ * Replications share --seed and differ by --run, the RngSeedManager run number; the
+ * devices and the protocol draw from fixed streams. dvhop-sweep.py runs this program
+ * over a grid of parameters and runs, and merges the summaries.
+ *
+ * ./waf --run "dvhop-benchmark --topology=random --nodes=1000 --density=12 --beaconRatio=0.1 --run=3"
+ */
+
+namespace {
+
+/// Benchmark parameters
+struct Scenario
+{
+  std::string topology;
+  uint32_t nodes;
+  double density;       ///< Average neighbours per node
+  double range;         ///< Radio range, m
+  double beaconRatio;
+  uint32_t seed;
+  uint32_t run;         ///< Run number, one per independent replication
+  double step;          ///< Grid step, m, sets the size of the area instead of density when positive
+  double helloInterval; ///< HELLO interval of DV-Hop, s
+  double time;          ///< Simulated time, s
+  std::string summary;  ///< JSON summary file, empty for none
+  bool analytical;      ///< Converged state from AnalyticalEngine instead of packets
+  std::string localization;  ///< Localization CSV file, empty for none
+  std::string channel;  ///< yans, grid or unitdisk
+  bool converge;        ///< Stop at convergence rather than at time
+  uint32_t quietIntervals;  ///< HELLO intervals without table change that make convergence
+  bool verify;          ///< Check the converged tables against the hop counts of a BFS
+};
+
+/// Measurements of one run
+struct Results
+{
+  double side;
+  uint32_t beacons;
+  double wallSeconds;
+  uint64_t events;
+  long peakRssKb;
+  uint64_t controlPackets;
+  uint64_t controlBytes;
+  uint32_t localized;
+  double meanError;
+  double rmsError;
+  double maxError;
+  bool converged;
+  double convergenceTime;     ///< Last table change, s
+  uint32_t oracleMismatches;  ///< Tables disagreeing with the BFS, with verify
+};
+
+bool
+InCShape (double x, double y, double side)
+{
+  //The notch: the middle third of the height, from a third of the width to the right side
+  return !(x > side / 3 && y > side / 3 && y < 2 * side / 3);
+}
+
+/// Positions of the nodes for the chosen topology
+Ptr<ListPositionAllocator>
+CreatePositions (Scenario const &s, double side)
+{
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+  uniform->SetAttribute ("Min", DoubleValue (0));
+  uniform->SetAttribute ("Max", DoubleValue (side));
+
+  if (s.topology == "grid")
+    {
+      uint32_t width = std::ceil (std::sqrt (double (s.nodes)));
+      double step = side / width;
+      for (uint32_t i = 0; i < s.nodes; ++i)
+        {
+          positions->Add (Vector ((i % width) * step, (i / width) * step, 0));
+        }
+    }
+  else if (s.topology == "random")
+    {
+      for (uint32_t i = 0; i < s.nodes; ++i)
+        {
+          double x = uniform->GetValue ();
+          positions->Add (Vector (x, uniform->GetValue (), 0));
+        }
+    }
+  else if (s.topology == "clustered")
+    {
+      uint32_t clusters = std::max (1u, s.nodes / 50);
+      std::vector<Vector> centres;
+      for (uint32_t c = 0; c < clusters; ++c)
+        {
+          double x = uniform->GetValue ();
+          centres.push_back (Vector (x, uniform->GetValue (), 0));
+        }
+      Ptr<NormalRandomVariable> normal = CreateObject<NormalRandomVariable> ();
+      normal->SetAttribute ("Variance", DoubleValue (std::pow (side / (2 * std::sqrt (double (clusters))), 2)));
+      for (uint32_t i = 0; i < s.nodes; ++i)
+        {
+          Vector const &centre = centres[i % clusters];
+          double x = std::min (side, std::max (0.0, centre.x + normal->GetValue ()));
+          double y = std::min (side, std::max (0.0, centre.y + normal->GetValue ()));
+          positions->Add (Vector (x, y, 0));
+        }
+    }
+  else if (s.topology == "cshape")
+    {
+      for (uint32_t i = 0; i < s.nodes; )
+        {
+          double x = uniform->GetValue ();
+          double y = uniform->GetValue ();
+          if (InCShape (x, y, side))
+            {
+              positions->Add (Vector (x, y, 0));
+              ++i;
+            }
+        }
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown topology " << s.topology << ", use grid, random, clustered or cshape");
+    }
+  return positions;
+}
+
+/// Ad hoc Wi-Fi where every node within range, and only those, hears a transmission
+NetDeviceContainer
+CreateDevices (NodeContainer const &nodes, double range, std::string const &channel)
+{
+  if (channel == "unitdisk")
+    {
+      UnitDiskHelper unitDisk;
+      unitDisk.SetChannelAttribute ("Range", DoubleValue (range));
+      return unitDisk.Install (nodes);
+    }
+  WifiMacHelper wifiMac;
+  wifiMac.SetType ("ns3::AdhocWifiMac");
+  WifiHelper wifi;
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
+  if (channel == "grid")
+    {
+      Ptr<dvhop::GridSpectrumChannel> gridChannel = CreateObject<dvhop::GridSpectrumChannel> ();
+      gridChannel->SetAttribute ("Cutoff", DoubleValue (range));
+      Ptr<RangePropagationLossModel> loss = CreateObject<RangePropagationLossModel> ();
+      loss->SetAttribute ("MaxRange", DoubleValue (range));
+      gridChannel->AddPropagationLossModel (loss);
+      gridChannel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+      SpectrumWifiPhyHelper wifiPhy = SpectrumWifiPhyHelper::Default ();
+      wifiPhy.SetChannel (gridChannel);
+      return wifi.Install (wifiPhy, wifiMac, nodes);
+    }
+  if (channel != "yans")
+    {
+      NS_FATAL_ERROR ("Unknown channel " << channel << ", use yans, grid or unitdisk");
+    }
+  YansWifiChannelHelper wifiChannel;
+  wifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
+  wifiChannel.AddPropagationLoss ("ns3::RangePropagationLossModel", "MaxRange", DoubleValue (range));
+  YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
+  wifiPhy.SetChannel (wifiChannel.Create ());
+  return wifi.Install (wifiPhy, wifiMac, nodes);
+}
+
+Ptr<dvhop::RoutingProtocol>
+GetDvhop (Ptr<Node> node)
+{
+  return DynamicCast<dvhop::RoutingProtocol> (node->GetObject<Ipv4> ()->GetRoutingProtocol ());
+}
+
+/// Picks beaconRatio of the nodes, at least 3, at random
+std::vector<bool>
+PickBeacons (uint32_t nodes, double beaconRatio)
+{
+  uint32_t beacons = std::min (nodes, std::max (3u, uint32_t (std::floor (nodes * beaconRatio + 0.5))));
+  std::vector<uint32_t> ids;
+  for (uint32_t i = 0; i < nodes; ++i)
+    {
+      ids.push_back (i);
+    }
+  //Partial Fisher-Yates shuffle
+  std::vector<bool> isBeacon (nodes, false);
+  Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable> ();
+  for (uint32_t i = 0; i < beacons; ++i)
+    {
+      std::swap (ids[i], ids[pick->GetInteger (i, ids.size () - 1)]);
+      isBeacon[ids[i]] = true;
+    }
+  return isBeacon;
+}
+
+/// Makes beacons of the picked nodes, at their real positions
+void
+SetBeacons (NodeContainer const &nodes, std::vector<bool> const &isBeacon)
+{
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      if (isBeacon[i])
+        {
+          Ptr<dvhop::RoutingProtocol> dvhop = GetDvhop (nodes.Get (i));
+          Vector pos = nodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+          dvhop->SetIsBeacon (true);
+          dvhop->SetPosition (pos.x, pos.y);
+        }
+    }
+}
+
+/// Line of the localization CSV of dvhop-example
+void
+WriteLocalizationLine (std::ostream &os, double time, uint32_t node, Vector const &real, Vector const &estimate)
+{
+  os << time << "," << node << ","
+     << real.x << "," << real.y << ","
+     << estimate.x << "," << estimate.y << ","
+     << CalculateDistance (real, estimate) << "\n";
+}
+
+/// Accumulates the error of one localized node
+void
+AddError (Results &r, double error, double &sum, double &squares)
+{
+  r.localized++;
+  sum += error;
+  squares += error * error;
+  r.maxError = std::max (r.maxError, error);
+}
+
+/// Control traffic and localization error of every node, after the run
+void
+CollectResults (NodeContainer const &nodes, Results &r, std::ostream *csv)
+{
+  r.controlPackets = r.controlBytes = 0;
+  r.localized = 0;
+  double sum = 0, squares = 0;
+  r.maxError = 0;
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      Ptr<dvhop::RoutingProtocol> dvhop = GetDvhop (nodes.Get (i));
+      r.controlPackets += dvhop->GetControlPacketsSent ();
+      r.controlBytes += dvhop->GetControlBytesSent ();
+      if (dvhop->IsBeacon () || !dvhop->IsLocalized ())
+        {
+          continue;
+        }
+      AddError (r, CalculateDistance (dvhop->GetPosition (), dvhop->GetRealPosition ()), sum, squares);
+      if (csv)
+        {
+          WriteLocalizationLine (*csv, Simulator::Now ().GetSeconds (), i, dvhop->GetRealPosition (), dvhop->GetPosition ());
+        }
+    }
+  r.meanError = r.localized > 0 ? sum / r.localized : 0;
+  r.rmsError = r.localized > 0 ? std::sqrt (squares / r.localized) : 0;
+}
+
+/// Packet-level run over Wi-Fi
+void
+RunPacketLevel (Scenario const &s, Ptr<ListPositionAllocator> positions, std::vector<bool> const &isBeacon,
+                Results &r, std::ostream *csv)
+{
+  NodeContainer nodes;
+  nodes.Create (s.nodes);
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  NetDeviceContainer devices = CreateDevices (nodes, s.range, s.channel);
+  DVHopHelper dvhop;
+  dvhop.Set ("HelloInterval", TimeValue (Seconds (s.helloInterval)));
+  dvhop.SetHelloFormat (dvhop::RoutingProtocol::AGGREGATED_HELLO);
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (dvhop);
+  stack.Install (nodes);
+  //Fixed streams for the protocol and the devices, so that a run draws the same numbers
+  //for them whatever else the scenario creates; the run number makes replications independent
+  int64_t streams = dvhop.AssignStreams (nodes, 0);
+  if (s.channel == "unitdisk")
+    {
+      UnitDiskHelper ().AssignStreams (devices, streams);
+    }
+  else
+    {
+      WifiHelper ().AssignStreams (devices, streams);
+    }
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  address.Assign (devices);
+  SetBeacons (nodes, isBeacon);
+
+  Ptr<dvhop::ConvergenceMonitor> monitor = CreateObject<dvhop::ConvergenceMonitor> ();
+  monitor->SetAttribute ("CheckInterval", TimeValue (Seconds (s.helloInterval)));
+  monitor->SetAttribute ("QuietIntervals", UintegerValue (s.quietIntervals));
+  monitor->SetAttribute ("StopOnConvergence", BooleanValue (s.converge));
+  monitor->SetAttribute ("OracleRange", DoubleValue (s.verify ? s.range : 0));
+  monitor->Install (nodes);
+
+  Simulator::Stop (Seconds (s.time));
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  r.wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  r.events = Simulator::GetEventCount ();
+  r.converged = monitor->IsConverged ();
+  //The last table change so far when not converged
+  r.convergenceTime = (r.converged ? monitor->GetConvergenceTime () : monitor->GetLastChange ()).GetSeconds ();
+  r.oracleMismatches = monitor->GetNOracleMismatches ();
+
+  CollectResults (nodes, r, csv);
+  Simulator::Destroy ();
+}
+
+/// Converged state computed by the analytical engine, no packet at all
+void
+RunAnalytical (Scenario const &s, Ptr<ListPositionAllocator> positions, std::vector<bool> const &isBeacon,
+               Results &r, std::ostream *csv)
+{
+  dvhop::AnalyticalEngine engine;
+  engine.SetRange (s.range);
+  std::vector<Vector> real;
+  for (uint32_t i = 0; i < s.nodes; ++i)
+    {
+      real.push_back (positions->GetNext ());
+      engine.AddNode (real[i].x, real[i].y, isBeacon[i]);
+    }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  engine.Run ();
+  r.wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  r.events = 0;
+  r.controlPackets = r.controlBytes = 0;
+  //No time in the analytical mode
+  r.converged = false;
+  r.convergenceTime = 0;
+  r.oracleMismatches = 0;
+
+  r.localized = 0;
+  double sum = 0, squares = 0;
+  r.maxError = 0;
+  for (uint32_t i = 0; i < s.nodes; ++i)
+    {
+      Vector estimate;
+      if (engine.GetPosition (i, estimate.x, estimate.y))
+        {
+          AddError (r, CalculateDistance (estimate, real[i]), sum, squares);
+        }
+    }
+  r.meanError = r.localized > 0 ? sum / r.localized : 0;
+  r.rmsError = r.localized > 0 ? std::sqrt (squares / r.localized) : 0;
+  if (csv)
+    {
+      engine.WriteLocalization (*csv, s.time);
+    }
+}
+
+void
+WriteSummary (std::ostream &os, Scenario const &s, Results const &r)
+{
+  os << std::setprecision (10);
+  os << "{\n"
+     << "  \"mode\": \"" << (s.analytical ? "analytical" : "packet") << "\",\n"
+     << "  \"channel\": \"" << s.channel << "\",\n"
+     << "  \"topology\": \"" << s.topology << "\",\n"
+     << "  \"nodes\": " << s.nodes << ",\n"
+     << "  \"density\": " << s.density << ",\n"
+     << "  \"range\": " << s.range << ",\n"
+     << "  \"side\": " << r.side << ",\n"
+     << "  \"beaconRatio\": " << s.beaconRatio << ",\n"
+     << "  \"beacons\": " << r.beacons << ",\n"
+     << "  \"seed\": " << s.seed << ",\n"
+     << "  \"run\": " << s.run << ",\n"
+     << "  \"step\": " << s.step << ",\n"
+     << "  \"helloInterval\": " << s.helloInterval << ",\n"
+     << "  \"simTime\": " << s.time << ",\n"
+     << "  \"wallSeconds\": " << r.wallSeconds << ",\n"
+     << "  \"events\": " << r.events << ",\n"
+     << "  \"eventsPerSecond\": " << (r.wallSeconds > 0 ? r.events / r.wallSeconds : 0) << ",\n"
+     << "  \"peakRssKb\": " << r.peakRssKb << ",\n"
+     << "  \"controlPackets\": " << r.controlPackets << ",\n"
+     << "  \"controlBytes\": " << r.controlBytes << ",\n"
+     << "  \"localized\": " << r.localized << ",\n"
+     << "  \"meanError\": " << r.meanError << ",\n"
+     << "  \"rmsError\": " << r.rmsError << ",\n"
+     << "  \"maxError\": " << r.maxError << ",\n"
+     << "  \"converged\": " << (r.converged ? "true" : "false") << ",\n"
+     << "  \"convergenceTime\": " << r.convergenceTime << ",\n"
+     << "  \"oracleMismatches\": " << r.oracleMismatches << "\n"
+     << "}\n";
+}
+
+} // anonymous namespace
+
+int main (int argc, char **argv)
+{
+  Scenario s;
+  s.topology = "random";
+  s.nodes = 200;
+  s.density = 10;
+  s.range = 100;
+  s.beaconRatio = 0.1;
+  s.seed = 1;
+  s.run = 1;
+  s.step = 0;
+  s.helloInterval = 1;
+  s.time = 30;
+  s.summary = "dvhop-benchmark.json";
+  s.analytical = false;
+  s.channel = "yans";
+  s.converge = false;
+  s.quietIntervals = 5;
+  s.verify = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("topology", "Node placement: grid, random, clustered or cshape.", s.topology);
+  cmd.AddValue ("nodes", "Number of nodes.", s.nodes);
+  cmd.AddValue ("density", "Average number of neighbours of a node, sets the size of the area.", s.density);
+  cmd.AddValue ("range", "Radio range, m.", s.range);
+  cmd.AddValue ("beaconRatio", "Fraction of the nodes that are beacons.", s.beaconRatio);
+  cmd.AddValue ("seed", "Seed of the random number generators.", s.seed);
+  cmd.AddValue ("run", "Run number: independent replications share the seed and differ by run.", s.run);
+  cmd.AddValue ("step", "Grid step, m: the area holds a sqrt(nodes)-wide grid of this step. 0 to size it from --density.", s.step);
+  cmd.AddValue ("helloInterval", "HELLO interval of DV-Hop, s.", s.helloInterval);
+  cmd.AddValue ("time", "Simulated time, s.", s.time);
+  cmd.AddValue ("summary", "JSON file for the summary, empty for none.", s.summary);
+  cmd.AddValue ("analytical", "Compute the converged state analytically instead of simulating the packets.", s.analytical);
+  cmd.AddValue ("channel", "Channel: yans, grid for the spatially indexed one, or unitdisk for no Wi-Fi at all.", s.channel);
+  cmd.AddValue ("converge", "Stop once the DV-Hop tables have converged instead of at --time.", s.converge);
+  cmd.AddValue ("quietIntervals", "HELLO intervals without any table change that make convergence.", s.quietIntervals);
+  cmd.AddValue ("verify", "Check the converged tables against a breadth-first search over the unit disk.", s.verify);
+  cmd.AddValue ("localization", "CSV file for the per-node localization errors, empty for none.", s.localization);
+  cmd.Parse (argc, argv);
+
+  RngSeedManager::SetSeed (s.seed);
+  RngSeedManager::SetRun (s.run);
+
+  Results r;
+  if (s.step > 0)
+    {
+      r.side = s.step * std::ceil (std::sqrt (double (s.nodes)));
+    }
+  else
+    {
+      //Square where a disk of radius range holds density nodes on average
+      r.side = std::sqrt (s.nodes * M_PI * s.range * s.range / s.density);
+      if (s.topology == "cshape")
+        {
+          //Same density over the C, which takes 7/9 of the square
+          r.side *= std::sqrt (9.0 / 7.0);
+        }
+    }
+
+  //Positions, then beacons: the same random draws in both modes
+  Ptr<ListPositionAllocator> positions = CreatePositions (s, r.side);
+  std::vector<bool> isBeacon = PickBeacons (s.nodes, s.beaconRatio);
+  r.beacons = std::count (isBeacon.begin (), isBeacon.end (), true);
+
+  std::ofstream csv;
+  if (!s.localization.empty ())
+    {
+      csv.open (s.localization.c_str ());
+      csv << "Time,Node,RealX,RealY,EstimatedX,EstimatedY,LocalizationError\n";
+    }
+  if (s.analytical)
+    {
+      RunAnalytical (s, positions, isBeacon, r, csv.is_open () ? &csv : 0);
+    }
+  else
+    {
+      RunPacketLevel (s, positions, isBeacon, r, csv.is_open () ? &csv : 0);
+    }
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  r.peakRssKb = usage.ru_maxrss;
+
+  WriteSummary (std::cout, s, r);
+  if (!s.summary.empty ())
+    {
+      std::ofstream file (s.summary.c_str ());
+      WriteSummary (file, s, r);
+    }
+  return 0;
+}
@@ -9,6 +9,8 @@
 #include "ns3/wifi-module.h"
 #include "ns3/wifi-mac-helper.h"
 #include "ns3/netanim-module.h"
+#include "ns3/spectrum-module.h"
+#include "ns3/propagation-module.h"
 #include <iostream>
 #include <cmath>
 #include <vector>
@@ -51,7 +53,41 @@ private:
   bool pcap;
   /// Print routes if true
   bool printRoutes;
+  /// Aggregate the beacons of each HELLO up to the MTU if true, one packet per beacon otherwise
+  bool aggregate;
+  /// Drive the HELLOs with a Trickle timer if true
+  bool trickle;
+  /// Only multipoint relays re-advertise beacons if true
+  bool mpr;
+  /// Beacons kept by each node, 0 for all of them
+  uint32_t maxBeacons;
+  /// Lifetime of the beacon entries, seconds, 0 to keep them forever
+  double beaconLifetime;
+  /// Store every DistanceTable in one shared arena if true
+  bool tableArena;
+  /// Refine the position estimates with Levenberg-Marquardt if true
+  bool refinement;
+  /// Wi-Fi channel: yans, or grid for the spatially indexed GridSpectrumChannel
+  std::string channel;
+  /// Cutoff range of the grid channel, meters
+  double cutoff;
+  /// Seed and run number of the random number generators
+  uint32_t seed;
+  uint32_t run;
+  /// Stop once the distance tables have converged rather than at totalTime
+  bool converge;
   
+  //\}
+  ///\name results
+  //\{
+  /// DV-Hop packets and bytes sent by all nodes
+  uint32_t controlPackets;
+  uint64_t controlBytes;
+  /// Nodes re-advertising the beacons learnt from others
+  uint32_t relays;
+  /// Refinements of the position estimates, and their iterations
+  uint32_t refinements;
+  uint64_t refinementIterations;
   //\}
   ///\name Node Termination
   //\{
@@ -65,6 +101,7 @@ private:
   NodeContainer nodes;
   NetDeviceContainer devices;
   Ipv4InterfaceContainer interfaces;
+  Ptr<dvhop::ConvergenceMonitor> monitor;
   std::ofstream latencyLogFile;
   std::ofstream localizationLogFile;
   //\}
@@ -74,6 +111,8 @@ private:
   Vector GetRealPosition(uint32_t nodeId) const;
   void CreateNodes ();
   void CheckAndStopNodes();
+  void HandleNodeDeath(Ptr<Node> node);
+  void CollectControlTraffic ();
   void SimulateCriticalCondition();
   void SetCriticalCondition();
   void CreateDevices ();
@@ -109,7 +148,24 @@ DVHopExample::DVHopExample () :
   step (50),
   totalTime (10),
   pcap (true),
-  printRoutes (true)
+  printRoutes (true),
+  aggregate (true),
+  trickle (false),
+  mpr (false),
+  maxBeacons (0),
+  beaconLifetime (0),
+  tableArena (false),
+  refinement (false),
+  channel ("yans"),
+  cutoff (250),
+  seed (12345),
+  run (1),
+  converge (false),
+  controlPackets (0),
+  controlBytes (0),
+  relays (0),
+  refinements (0),
+  refinementIterations (0)
 {
   localizationLogFile.open("localization_data.csv");
   localizationLogFile << "Time,Node,RealX,RealY,EstimatedX,EstimatedY,LocalizationError\n";
@@ -126,7 +182,6 @@ DVHopExample::Configure (int argc, char **argv)
   // Enable DVHop logs by default. Comment this if too noisy
   LogComponentEnable("DVHopRoutingProtocol", LOG_LEVEL_ALL);
 
-  SeedManager::SetSeed (12345);
   CommandLine cmd;
 
   cmd.AddValue ("pcap", "Write PCAP traces.", pcap);
@@ -134,8 +189,22 @@ DVHopExample::Configure (int argc, char **argv)
   cmd.AddValue ("size", "Number of nodes.", size);
   cmd.AddValue ("time", "Simulation time, s.", totalTime);
   cmd.AddValue ("step", "Grid step, m", step);
+  cmd.AddValue ("aggregate", "Aggregate the beacons of each HELLO, false for one legacy packet per beacon.", aggregate);
+  cmd.AddValue ("trickle", "Use the Trickle timer for HELLOs.", trickle);
+  cmd.AddValue ("mpr", "Only multipoint relays re-advertise beacons.", mpr);
+  cmd.AddValue ("maxBeacons", "Nearest beacons kept by each node, 0 for all.", maxBeacons);
+  cmd.AddValue ("beaconLifetime", "Lifetime of the beacon entries, s, 0 to keep them forever.", beaconLifetime);
+  cmd.AddValue ("tableArena", "Store the distance tables in one shared arena.", tableArena);
+  cmd.AddValue ("refinement", "Refine the position estimates with Levenberg-Marquardt.", refinement);
+  cmd.AddValue ("channel", "Wi-Fi channel: yans, or grid for the spatially indexed one.", channel);
+  cmd.AddValue ("cutoff", "Cutoff range of the grid channel, m.", cutoff);
+  cmd.AddValue ("seed", "Seed of the random number generators.", seed);
+  cmd.AddValue ("run", "Run number: independent replications share the seed and differ by run.", run);
+  cmd.AddValue ("converge", "Stop once the distance tables have converged, at most after time.", converge);
 
   cmd.Parse (argc, argv);
+  RngSeedManager::SetSeed (seed);
+  RngSeedManager::SetRun (run);
   return true;
 }
 
@@ -149,6 +218,10 @@ DVHopExample::Run ()
 
   CreateBeacons();
 
+  monitor = CreateObject<dvhop::ConvergenceMonitor> ();
+  monitor->SetAttribute ("StopOnConvergence", BooleanValue (converge));
+  monitor->Install (nodes);
+
   std::cout << "Starting simulation for " << totalTime << " s ...\n";
 
   Simulator::Stop (Seconds (totalTime));
@@ -157,12 +230,42 @@ DVHopExample::Run ()
 
   Simulator::Run ();
   LogLocalizationData();
+  CollectControlTraffic ();
   Simulator::Destroy ();
 }
 
 void
-DVHopExample::Report (std::ostream &)
+DVHopExample::Report (std::ostream & os)
+{
+  os << "Control traffic: " << controlPackets << " packets, " << controlBytes << " bytes\n";
+  os << "Relays: " << relays << " of " << size << " nodes\n";
+  if (monitor->IsConverged ())
+    {
+      os << "Converged at " << monitor->GetConvergenceTime ().GetSeconds () << " s, detected at "
+         << monitor->GetDetectionTime ().GetSeconds () << " s\n";
+    }
+  else
+    {
+      os << "Not converged, last table change at " << monitor->GetLastChange ().GetSeconds () << " s\n";
+    }
+  if (refinements > 0)
+    {
+      os << "Refinement: " << double (refinementIterations) / refinements << " iterations per estimate\n";
+    }
+}
+
+void
+DVHopExample::CollectControlTraffic ()
 {
+  for (uint32_t i = 0; i < size; ++i)
+    {
+      Ptr<dvhop::RoutingProtocol> dvhop = DynamicCast<dvhop::RoutingProtocol> (nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+      controlPackets += dvhop->GetControlPacketsSent ();
+      controlBytes += dvhop->GetControlBytesSent ();
+      relays += dvhop->IsMprRelay () ? 1 : 0;
+      refinements += dvhop->GetRefinements ();
+      refinementIterations += dvhop->GetRefinementIterations ();
+    }
 }
 
 void
@@ -244,10 +347,11 @@ DVHopExample::CreateBeacons()
     beacnum = size/2;
   }
 
+  Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable> ();
   std::vector<int> v;
   int randnum;
   for(int i = 0; i < beacnum; i++){
-    randnum = rand() % size;
+    randnum = pick->GetInteger (0, size - 1);
     if(!(std::find(v.begin(), v.end(), randnum) != v.end())){
       v.push_back(randnum);
     } else {
@@ -279,11 +383,28 @@ DVHopExample::CreateDevices ()
 {
   WifiMacHelper wifiMac = WifiMacHelper();
   wifiMac.SetType ("ns3::AdhocWifiMac");
+  WifiHelper wifi = WifiHelper();
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
+  if (channel == "grid")
+    {
+      // Same loss and delay models as YansWifiChannelHelper::Default, nothing heard beyond the cutoff
+      Ptr<dvhop::GridSpectrumChannel> gridChannel = CreateObject<dvhop::GridSpectrumChannel> ();
+      gridChannel->SetAttribute ("Cutoff", DoubleValue (cutoff));
+      gridChannel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+      gridChannel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+      SpectrumWifiPhyHelper wifiPhy = SpectrumWifiPhyHelper::Default ();
+      wifiPhy.SetChannel (gridChannel);
+      devices = wifi.Install (wifiPhy, wifiMac, nodes);
+      if (pcap)
+        {
+          wifiPhy.EnablePcapAll (std::string ("aodv"));
+        }
+      return;
+    }
+
   YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
   YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
   wifiPhy.SetChannel (wifiChannel.Create ());
-  WifiHelper wifi = WifiHelper();
-  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
   devices = wifi.Install (wifiPhy, wifiMac, nodes);
 
   if (pcap)
@@ -296,6 +417,9 @@ void DVHopExample::LogLocalizationData() {
   for (uint32_t i = 0; i < size; ++i) {
     Ptr<Ipv4RoutingProtocol> proto = nodes.Get(i)->GetObject<Ipv4>()->GetRoutingProtocol();
     Ptr<dvhop::RoutingProtocol> dvhop = DynamicCast<dvhop::RoutingProtocol>(proto);
+    if (!dvhop->IsLocalized()) {
+      continue;
+    }
 
     Vector realPosition = dvhop->GetRealPosition();
     Vector estimatedPosition = dvhop->GetPosition();
@@ -316,12 +440,24 @@ DVHopExample::InstallInternetStack ()
 {
   DVHopHelper dvhop;
   // you can configure DVhop attributes here using aodv.Set(name, value)
+  dvhop.SetHelloFormat (aggregate ? dvhop::RoutingProtocol::AGGREGATED_HELLO : dvhop::RoutingProtocol::LEGACY_HELLO);
+  dvhop.Set ("Trickle", BooleanValue (trickle));
+  dvhop.Set ("MprEnabled", BooleanValue (mpr));
+  dvhop.Set ("MaxBeacons", UintegerValue (maxBeacons));
+  dvhop.Set ("BeaconLifetime", TimeValue (Seconds (beaconLifetime)));
+  dvhop.Set ("Refinement", BooleanValue (refinement));
+  if (tableArena)
+    {
+      dvhop.EnableTableArena ();
+    }
   InternetStackHelper stack;
   stack.SetRoutingHelper (dvhop); // has effect on the next Install ()
   stack.Install (nodes);
   Ipv4AddressHelper address;
   address.SetBase ("10.0.0.0", "255.0.0.0");
   interfaces = address.Assign (devices);
+  // Fixed streams: the protocol draws the same numbers for a given run whatever else changes
+  dvhop.AssignStreams (nodes, 0);
 
   Ptr<OutputStreamWrapper> distStream = Create<OutputStreamWrapper>("dvhop.distances", std::ios::out);
   dvhop.PrintDistanceTableAllAt(Seconds(9), distStream);
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+# -*- Mode: python; py-indent-offset: 4; indent-tabs-mode: nil; coding: utf-8; -*-
+"""
+Parallel multi-run parameter sweep over dvhop-benchmark.
+
+Expands a grid of benchmark parameters into points and runs every point
+--runs times, one process per run and as many processes at a time as there
+are cores. Replications share --seed and differ by the RngSeedManager run
+number, so each run is independent and reproducible on its own. The same run
+numbers are used at every point (common random numbers), which makes the
+differences between points less noisy than the points themselves.
+
+The JSON summaries of the runs are merged into one CSV table: one line per
+point, with the mean and the confidence interval half-width of each metric.
+With --target-width, points keep getting replications, in batches of
+--runs, until the confidence interval of the metric is narrow enough or
+--max-runs is reached. With --set converge=1, each run stops as soon as its
+DV-Hop tables have converged, which cuts the wall time of long horizons and
+makes convergenceTime a metric like the others.
+
+Run it from the ns-3 root after building, e.g.:
+
+  ./waf build
+  src/dvhop/examples/dvhop-sweep.py \\
+      --param nodes=100,200,400 --param beaconRatio=0.1,0.2 \\
+      --param helloInterval=1,2 --set topology=grid --set step=80 \\
+      --runs 5 --target-width meanError=2 --max-runs 40
+"""
+
+import argparse
+import concurrent.futures
+import csv
+import glob
+import itertools
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+METRICS = [
+    "wallSeconds", "events", "eventsPerSecond", "peakRssKb",
+    "controlPackets", "controlBytes", "localized",
+    "meanError", "rmsError", "maxError",
+    "converged", "convergenceTime", "oracleMismatches",
+]
+
+# Two-sided Student t quantiles for df = 1..30, then the normal quantile
+T_QUANTILES = {
+    0.90: [6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812,
+           1.796, 1.782, 1.771, 1.761, 1.753, 1.746, 1.740, 1.734, 1.729, 1.725,
+           1.721, 1.717, 1.714, 1.711, 1.708, 1.706, 1.703, 1.701, 1.699, 1.697],
+    0.95: [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+           2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+           2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042],
+    0.99: [63.657, 9.925, 5.841, 4.604, 4.032, 3.707, 3.499, 3.355, 3.250, 3.169,
+           3.106, 3.055, 3.012, 2.977, 2.947, 2.921, 2.898, 2.878, 2.861, 2.845,
+           2.831, 2.819, 2.807, 2.797, 2.787, 2.779, 2.771, 2.763, 2.756, 2.750],
+}
+Z_QUANTILES = {0.90: 1.645, 0.95: 1.960, 0.99: 2.576}
+
+
+def t_quantile(confidence, df):
+    if df <= len(T_QUANTILES[confidence]):
+        return T_QUANTILES[confidence][df - 1]
+    return Z_QUANTILES[confidence]
+
+
+def mean_and_halfwidth(values, confidence):
+    """Mean and half-width of the confidence interval, infinite with one value"""
+    n = len(values)
+    mean = sum(values) / n
+    if n < 2:
+        return mean, math.inf
+    variance = sum((v - mean) ** 2 for v in values) / (n - 1)
+    return mean, t_quantile(confidence, n - 1) * math.sqrt(variance / n)
+
+
+def parse_assignment(text):
+    name, sep, values = text.partition("=")
+    if not sep or not name or not values:
+        raise argparse.ArgumentTypeError("expected name=value[,value...], got %r" % text)
+    return name, values.split(",")
+
+
+def find_program(ns3_dir):
+    """The built dvhop-benchmark, whatever the build profile"""
+    found = sorted(glob.glob(os.path.join(ns3_dir, "build", "**", "*dvhop-benchmark*"), recursive=True))
+    found = [f for f in found if os.access(f, os.X_OK) and not f.endswith((".o", ".py"))]
+    if not found:
+        sys.exit("dvhop-benchmark not found under %s/build: build it, or give --program" % ns3_dir)
+    return found[0]
+
+
+def run_environment(ns3_dir):
+    """Like ./waf shell: the ns-3 libraries on the loader path"""
+    env = dict(os.environ)
+    lib = os.path.join(ns3_dir, "build", "lib")
+    if os.path.isdir(lib):
+        env["LD_LIBRARY_PATH"] = lib + os.pathsep + env.get("LD_LIBRARY_PATH", "")
+    return env
+
+
+class Sweep(object):
+    def __init__(self, args):
+        self.args = args
+        self.program = args.program or find_program(args.ns3_dir)
+        self.env = run_environment(args.ns3_dir)
+        self.outdir = args.keep or tempfile.mkdtemp(prefix="dvhop-sweep-")
+        os.makedirs(self.outdir, exist_ok=True)
+        names = [name for name, _ in args.param]
+        self.points = [dict(zip(names, values))
+                       for values in itertools.product(*[values for _, values in args.param])]
+        self.fixed = dict((name, values[0]) for name, values in args.set)
+        self.results = [[] for _ in self.points]
+
+    def command(self, point, run, summary):
+        options = dict(self.fixed)
+        options.update(point)
+        options["seed"] = str(self.args.seed)
+        options["run"] = str(run)
+        options["summary"] = summary
+        return [self.program] + ["--%s=%s" % (k, v) for k, v in sorted(options.items())]
+
+    def job(self, index, run):
+        summary = os.path.join(self.outdir, "point%d-run%d.json" % (index, run))
+        command = self.command(self.points[index], run, summary)
+        done = subprocess.run(command, env=self.env, stdout=subprocess.DEVNULL,
+                              stderr=subprocess.PIPE, universal_newlines=True)
+        if done.returncode != 0:
+            raise RuntimeError("%s failed (%d):\n%s" % (" ".join(command), done.returncode, done.stderr))
+        with open(summary) as f:
+            return index, json.load(f)
+
+    def run_batch(self, jobs):
+        with concurrent.futures.ThreadPoolExecutor(max_workers=self.args.jobs) as pool:
+            futures = [pool.submit(self.job, index, run) for index, run in jobs]
+            for i, future in enumerate(concurrent.futures.as_completed(futures)):
+                index, summary = future.result()
+                self.results[index].append(summary)
+                sys.stderr.write("\r%d/%d runs" % (i + 1, len(jobs)))
+        sys.stderr.write("\n")
+
+    def too_wide(self):
+        """Points whose target interval is still too wide, and may get more runs"""
+        if not self.args.target_width:
+            return []
+        metric, width = self.args.target_width
+        pending = []
+        for index, results in enumerate(self.results):
+            _, halfwidth = mean_and_halfwidth([r[metric] for r in results], self.args.confidence)
+            if 2 * halfwidth > width and len(results) < self.args.max_runs:
+                pending.append(index)
+        return pending
+
+    def run(self):
+        jobs = [(index, run) for index in range(len(self.points))
+                for run in range(1, self.args.runs + 1)]
+        self.run_batch(jobs)
+        pending = self.too_wide()
+        while pending:
+            jobs = []
+            for index in pending:
+                done = len(self.results[index])
+                last = min(done + self.args.runs, self.args.max_runs)
+                jobs += [(index, run) for run in range(done + 1, last + 1)]
+            self.run_batch(jobs)
+            pending = self.too_wide()
+
+    def write(self, out):
+        names = [name for name, _ in self.args.param]
+        writer = csv.writer(out)
+        header = names + ["runs"]
+        for metric in METRICS:
+            header += [metric, metric + "Ci"]
+        writer.writerow(header)
+        for point, results in zip(self.points, self.results):
+            row = [point[name] for name in names] + [len(results)]
+            for metric in METRICS:
+                mean, halfwidth = mean_and_halfwidth([r[metric] for r in results], self.args.confidence)
+                row += ["%.6g" % mean, "%.6g" % halfwidth]
+            writer.writerow(row)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0],
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--param", type=parse_assignment, action="append", default=[],
+                        metavar="NAME=V1,V2,...",
+                        help="benchmark option swept over these values, e.g. nodes=100,200")
+    parser.add_argument("--set", type=parse_assignment, action="append", default=[],
+                        metavar="NAME=VALUE", help="benchmark option fixed for every run")
+    parser.add_argument("--runs", type=int, default=5,
+                        help="replications per point, and per batch with --target-width")
+    parser.add_argument("--seed", type=int, default=1, help="seed shared by every run")
+    parser.add_argument("--confidence", type=float, default=0.95, choices=sorted(T_QUANTILES),
+                        help="confidence level of the intervals")
+    parser.add_argument("--target-width", type=parse_assignment, metavar="METRIC=WIDTH",
+                        help="add runs until the confidence interval of METRIC is at most WIDTH wide")
+    parser.add_argument("--max-runs", type=int, default=50, help="replications cap with --target-width")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="simultaneous runs")
+    parser.add_argument("--ns3-dir", default=".", help="ns-3 root, where ./waf built the program")
+    parser.add_argument("--program", help="dvhop-benchmark executable, found in the build by default")
+    parser.add_argument("--keep", metavar="DIR", help="keep the summary of every run in DIR")
+    parser.add_argument("--output", default="dvhop-sweep.csv", help="merged table, - for stdout")
+    args = parser.parse_args()
+
+    if args.runs < 1 or args.max_runs < args.runs:
+        parser.error("need 1 <= --runs <= --max-runs")
+    if args.target_width:
+        metric, width = args.target_width
+        if metric not in METRICS or len(width) != 1:
+            parser.error("--target-width takes one of %s and one width" % ", ".join(METRICS))
+        args.target_width = (metric, float(width[0]))
+    for name, values in args.set:
+        if len(values) != 1:
+            parser.error("--set %s takes one value, use --param to sweep it" % name)
+    for name in ("seed", "run", "summary"):
+        if name in [n for n, _ in args.param + args.set]:
+            parser.error("%s is set by the sweep itself" % name)
+
+    sweep = Sweep(args)
+    sys.stderr.write("%d points, %s, %d at a time\n" % (len(sweep.points), sweep.program, args.jobs))
+    sweep.run()
+    if args.output == "-":
+        sweep.write(sys.stdout)
+    else:
+        with open(args.output, "w", newline="") as out:
+            sweep.write(out)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,534 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/dvhop-module.h"
+#include "ns3/core-module.h"
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <sys/resource.h>
+
+using namespace ns3;
+
+/**
+ * \brief DistanceTable micro benchmark.
+ *
+ * Compares the flat DistanceTable against the std::map layout it replaced, with
+ * the access patterns of the protocol: inserting the beacons, looking them up
+ * one by one, and walking the whole table to build a HELLO.
+ *
+ * ./waf --run "dvhop-table-bench --maxBeacons=10000 --rounds=100"
+ *
+ * With --nodes it compares instead the memory taken by the tables of a whole
+ * simulation where every node knows every beacon, or --known of them: one map
+ * per node, one flat table per node, or tables on a shared DistanceTableArena.
+ * --layout builds only one of them, so the peak RSS of the process can be
+ * compared as well.
+ *
+ * ./waf --run "dvhop-table-bench --nodes=100000 --beacons=1000 --known=8 --layout=arena"
+ *
+ * With --localization it times the position estimate that follows an advertisement
+ * changing the hops of one beacon: solved again from the whole table, or updated
+ * in the accumulated normal equations.
+ *
+ * ./waf --run "dvhop-table-bench --localization=1 --beacons=1000"
+ *
+ * With --batch it localizes that many nodes, each knowing --beacons beacons, one
+ * node at a time and with the BatchLocalization engine, and reports nodes per second.
+ *
+ * ./waf --run "dvhop-table-bench --batch=100000 --beacons=50"
+ *
+ * With --precision it localizes nodes of a random network from hop counts with each
+ * numeric policy of the localization, and reports the cost of building and solving
+ * the system, the distance to the double precision estimate, and the error.
+ *
+ * ./waf --run "dvhop-table-bench --precision=1 --beacons=50"
+ */
+
+namespace {
+
+/// The former DistanceTable storage, walked the way SendHello used to do it
+class MapTable
+{
+public:
+  void AddBeacon (Ipv4Address beacon, uint16_t hops, double x, double y, uint16_t seqNo)
+  {
+    dvhop::BeaconInfo &info = m_table[beacon];
+    info.SetHops (hops);
+    info.SetPosition (std::make_pair (x, y));
+    info.SetSeqNo (seqNo);
+  }
+  uint16_t GetHopsTo (Ipv4Address beacon) const
+  {
+    std::map<Ipv4Address, dvhop::BeaconInfo>::const_iterator it = m_table.find (beacon);
+    return it != m_table.end () ? it->second.GetHops () : 0;
+  }
+  dvhop::Position GetBeaconPosition (Ipv4Address beacon) const
+  {
+    std::map<Ipv4Address, dvhop::BeaconInfo>::const_iterator it = m_table.find (beacon);
+    return it != m_table.end () ? it->second.GetPosition () : std::make_pair (-1.0, -1.0);
+  }
+  uint16_t GetSequenceNumber (Ipv4Address beacon) const
+  {
+    std::map<Ipv4Address, dvhop::BeaconInfo>::const_iterator it = m_table.find (beacon);
+    return it != m_table.end () ? it->second.GetSeqNo () : 0;
+  }
+  std::vector<Ipv4Address> GetKnownBeacons () const
+  {
+    std::vector<Ipv4Address> beacons;
+    for (std::map<Ipv4Address, dvhop::BeaconInfo>::const_iterator it = m_table.begin (); it != m_table.end (); ++it)
+      {
+        beacons.push_back (it->first);
+      }
+    return beacons;
+  }
+
+  /// Bytes taken by the red-black tree nodes: the value plus three pointers and a colour
+  size_t GetMemoryUsage () const
+  {
+    return sizeof (*this) + m_table.size () * (sizeof (std::pair<const Ipv4Address, dvhop::BeaconInfo>) + 4 * sizeof (void *));
+  }
+
+private:
+  std::map<Ipv4Address, dvhop::BeaconInfo> m_table;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double
+NsPerOp (Clock::time_point start, uint64_t ops)
+{
+  return std::chrono::duration<double, std::nano> (Clock::now () - start).count () / ops;
+}
+
+/// Peak resident set size of the process, in kilobytes
+long
+PeakRssKb ()
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/// Fills one table per node with known beacons, a window starting at a different
+/// beacon for each node, and reports the bytes taken
+void
+RunMemoryComparison (uint32_t nodes, uint32_t beacons, uint32_t known, std::string layout)
+{
+  std::vector<Ipv4Address> addresses;
+  for (uint32_t b = 0; b < beacons; ++b)
+    {
+      addresses.push_back (Ipv4Address (0x0a000001 + b * 7));
+    }
+  known = (known == 0 || known > beacons) ? beacons : known;
+
+  std::cout << nodes << " nodes x " << beacons << " beacons, " << known << " known by each node\n";
+  if (layout == "all" || layout == "map")
+    {
+      std::vector<MapTable> tables (nodes);
+      size_t bytes = 0;
+      for (uint32_t n = 0; n < nodes; ++n)
+        {
+          for (uint32_t k = 0; k < known; ++k)
+            {
+              uint32_t b = (n + k) % beacons;
+              tables[n].AddBeacon (addresses[b], 1 + (n + b) % 30, b, b, 1);
+            }
+          bytes += tables[n].GetMemoryUsage ();
+        }
+      std::cout << std::setw (8) << "map" << std::setw (14) << bytes / 1024 << " kB\n";
+    }
+  if (layout == "all" || layout == "flat")
+    {
+      std::vector<dvhop::DistanceTable *> tables;
+      size_t bytes = 0;
+      for (uint32_t n = 0; n < nodes; ++n)
+        {
+          tables.push_back (new dvhop::DistanceTable ());
+          for (uint32_t k = 0; k < known; ++k)
+            {
+              uint32_t b = (n + k) % beacons;
+              tables[n]->AddBeacon (addresses[b], 1 + (n + b) % 30, b, b, 1);
+            }
+          bytes += tables[n]->GetMemoryUsage ();
+        }
+      std::cout << std::setw (8) << "flat" << std::setw (14) << bytes / 1024 << " kB\n";
+      for (uint32_t n = 0; n < nodes; ++n)
+        {
+          delete tables[n];
+        }
+    }
+  if (layout == "all" || layout == "arena")
+    {
+      Ptr<dvhop::DistanceTableArena> arena = Create<dvhop::DistanceTableArena> ();
+      std::vector<dvhop::DistanceTable *> tables;
+      size_t bytes = 0;
+      for (uint32_t n = 0; n < nodes; ++n)
+        {
+          tables.push_back (new dvhop::DistanceTable ());
+          tables[n]->UseArena (arena);
+          for (uint32_t k = 0; k < known; ++k)
+            {
+              uint32_t b = (n + k) % beacons;
+              tables[n]->AddBeacon (addresses[b], 1 + (n + b) % 30, b, b, 1);
+            }
+          bytes += tables[n]->GetMemoryUsage ();
+        }
+      bytes += arena->GetMemoryUsage ();
+      std::cout << std::setw (8) << "arena" << std::setw (14) << bytes / 1024 << " kB\n";
+      for (uint32_t n = 0; n < nodes; ++n)
+        {
+          delete tables[n];
+        }
+    }
+  std::cout << "Peak RSS: " << PeakRssKb () << " kB\n";
+}
+
+/// Cost of a new estimate after each advertisement, from scratch and incremental
+void
+RunLocalizationComparison (uint32_t beacons, uint32_t updates)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (2);
+
+  dvhop::DistanceTable table;
+  for (uint32_t b = 0; b < beacons; ++b)
+    {
+      table.AddBeacon (Ipv4Address (0x0a000001 + b), rng->GetInteger (1, 30), rng->GetValue (0, 1000), rng->GetValue (0, 1000), 1);
+    }
+  std::vector<Ipv4Address> changed;
+  std::vector<uint16_t> hops;
+  for (uint32_t u = 0; u < updates; ++u)
+    {
+      changed.push_back (Ipv4Address (0x0a000001 + rng->GetInteger (0, beacons - 1)));
+      hops.push_back (rng->GetInteger (1, 30));
+    }
+
+  const double hopSize = 35;
+  dvhop::Localization loc;
+  Clock::time_point start;
+  double x = 0, y = 0, sink = 0;
+
+  start = Clock::now ();
+  for (uint32_t u = 0; u < updates; ++u)
+    {
+      table.AddBeacon (changed[u], hops[u], 0, 0, 1);
+      loc.Reset ();
+      table.ForEach ([&loc] (Ipv4Address, dvhop::BeaconInfo const &info)
+        {
+          loc.AddBeacon (info.GetPosition ().first, info.GetPosition ().second, info.GetHops ());
+        });
+      loc.Solve (hopSize, x, y);
+      sink += x + y;
+    }
+  double fullNs = NsPerOp (start, updates);
+
+  start = Clock::now ();
+  for (uint32_t u = 0; u < updates; ++u)
+    {
+      dvhop::Position pos = table.GetBeaconPosition (changed[u]);
+      loc.RemoveBeacon (pos.first, pos.second, table.GetHopsTo (changed[u]));
+      table.AddBeacon (changed[u], hops[u], 0, 0, 1);
+      loc.AddBeacon (pos.first, pos.second, hops[u]);
+      loc.Solve (hopSize, x, y);
+      sink += x + y;
+    }
+  double incrementalNs = NsPerOp (start, updates);
+
+  std::cout << std::fixed << std::setprecision (1);
+  std::cout << beacons << " beacons, " << updates << " advertisements\n";
+  std::cout << std::setw (14) << "from scratch" << std::setw (12) << fullNs << " ns/estimate\n";
+  std::cout << std::setw (14) << "incremental" << std::setw (12) << incrementalNs << " ns/estimate\n";
+  //Keeps the compiler from dropping the loops
+  if (sink == 0)
+    {
+      std::cout << "";
+    }
+}
+
+/// Throughput of the per-node and batch localization of a whole network
+void
+RunBatchComparison (uint32_t nodes, uint32_t beacons)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (3);
+
+  std::vector<double> bx, by;
+  for (uint32_t b = 0; b < beacons; ++b)
+    {
+      bx.push_back (rng->GetValue (0, 1000));
+      by.push_back (rng->GetValue (0, 1000));
+    }
+  Ptr<dvhop::DistanceTableArena> arena = Create<dvhop::DistanceTableArena> ();
+  std::vector<dvhop::DistanceTable *> tables;
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      tables.push_back (new dvhop::DistanceTable ());
+      tables[n]->UseArena (arena);
+      for (uint32_t b = 0; b < beacons; ++b)
+        {
+          tables[n]->AddBeacon (Ipv4Address (0x0a000001 + b), rng->GetInteger (1, 30), bx[b], by[b], 1);
+        }
+    }
+
+  const double hopSize = 35;
+  std::vector<double> perNodeX (nodes), perNodeY (nodes);
+  Clock::time_point start = Clock::now ();
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      dvhop::Localization loc;
+      tables[n]->ForEach ([&loc] (Ipv4Address, dvhop::BeaconInfo const &info)
+        {
+          loc.AddBeacon (info.GetPosition ().first, info.GetPosition ().second, info.GetHops ());
+        });
+      loc.Solve (hopSize, perNodeX[n], perNodeY[n]);
+    }
+  double perNodeS = std::chrono::duration<double> (Clock::now () - start).count ();
+
+  dvhop::BatchLocalization batch;
+  start = Clock::now ();
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      batch.AddNode (*tables[n], hopSize);
+    }
+  double gatherS = std::chrono::duration<double> (Clock::now () - start).count ();
+
+  std::cout << nodes << " nodes x " << beacons << " beacons, AVX2 " << (dvhop::BatchLocalization::HasSimd () ? "on" : "off") << "\n";
+  std::cout << std::setw (20) << "per node" << std::setw (14) << uint64_t (nodes / perNodeS) << " nodes/s\n";
+  std::cout << std::setw (20) << "gather" << std::setw (14) << uint64_t (nodes / gatherS) << " nodes/s\n";
+
+  const char *names[] = { "batch scalar", "batch simd", "batch simd threads" };
+  bool simd[] = { false, true, true };
+  uint32_t threads[] = { 1, 1, 0 };
+  for (uint32_t k = 0; k < 3; ++k)
+    {
+      batch.SetSimd (simd[k]);
+      batch.SetThreads (threads[k]);
+      start = Clock::now ();
+      batch.Solve ();
+      double solveS = std::chrono::duration<double> (Clock::now () - start).count ();
+
+      double maxError = 0;
+      for (uint32_t n = 0; n < nodes; ++n)
+        {
+          double x = perNodeX[n], y = perNodeY[n];
+          batch.GetPosition (n, x, y);
+          maxError = std::max (maxError, std::max (std::fabs (x - perNodeX[n]), std::fabs (y - perNodeY[n])));
+        }
+      std::cout << std::setw (20) << names[k] << std::setw (14) << uint64_t (nodes / solveS) << " nodes/s"
+                << ", max difference " << maxError << "\n";
+    }
+
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      delete tables[n];
+    }
+}
+
+/// Cost and accuracy of the localization with each numeric policy
+template <typename Precision>
+void
+RunPrecision (std::string name, std::vector<double> const &bx, std::vector<double> const &by,
+              std::vector<double> const &nx, std::vector<double> const &ny, std::vector<uint16_t> const &hops,
+              double hopSize, std::vector<double> &refX, std::vector<double> &refY)
+{
+  uint32_t beacons = bx.size ();
+  uint32_t nodes = nx.size ();
+  std::vector<double> x (nodes, 0), y (nodes, 0);
+
+  Clock::time_point start = Clock::now ();
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      dvhop::BasicLocalization<Precision> loc;
+      for (uint32_t b = 0; b < beacons; ++b)
+        {
+          loc.AddBeacon (bx[b], by[b], hops[n * beacons + b]);
+        }
+      loc.Solve (hopSize, x[n], y[n]);
+    }
+  double ns = NsPerOp (start, nodes);
+
+  if (refX.empty ())
+    {
+      refX = x;
+      refY = y;
+    }
+  double deviation = 0, error = 0;
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      deviation = std::max (deviation, std::hypot (x[n] - refX[n], y[n] - refY[n]));
+      error += std::hypot (x[n] - nx[n], y[n] - ny[n]);
+    }
+  std::cout << std::setw (8) << name << std::setw (14) << ns << std::setw (16) << deviation
+            << std::setw (14) << error / nodes << "\n";
+}
+
+void
+RunPrecisionComparison (uint32_t nodes, uint32_t beacons)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (4);
+
+  //Beacons and nodes over 2 km x 2 km, ranges of 100 m per hop
+  const double side = 2000, hopSize = 100;
+  std::vector<double> bx, by, nx, ny;
+  std::vector<uint16_t> hops;
+  for (uint32_t b = 0; b < beacons; ++b)
+    {
+      bx.push_back (rng->GetValue (0, side));
+      by.push_back (rng->GetValue (0, side));
+    }
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      nx.push_back (rng->GetValue (0, side));
+      ny.push_back (rng->GetValue (0, side));
+      for (uint32_t b = 0; b < beacons; ++b)
+        {
+          hops.push_back (std::ceil (std::hypot (nx[n] - bx[b], ny[n] - by[b]) / hopSize));
+        }
+    }
+
+  std::cout << std::setprecision (4);
+  std::cout << nodes << " nodes x " << beacons << " beacons\n";
+  std::cout << std::setw (8) << "policy" << std::setw (14) << "ns/node" << std::setw (16) << "max vs double"
+            << std::setw (14) << "mean error" << "\n";
+  std::vector<double> refX, refY;
+  RunPrecision<dvhop::DoublePrecision> ("double", bx, by, nx, ny, hops, hopSize, refX, refY);
+  RunPrecision<dvhop::FloatPrecision> ("float", bx, by, nx, ny, hops, hopSize, refX, refY);
+  RunPrecision<dvhop::FixedPrecision> ("fixed", bx, by, nx, ny, hops, hopSize, refX, refY);
+}
+
+} // anonymous namespace
+
+int main (int argc, char **argv)
+{
+  uint32_t maxBeacons = 10000;
+  uint32_t rounds = 20;
+  uint32_t nodes = 0;
+  uint32_t beacons = 1000;
+  uint32_t known = 0;
+  std::string layout = "all";
+  bool localization = false;
+  uint32_t batch = 0;
+  bool precision = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("maxBeacons", "Largest table size, the sizes go from 10 up to it in powers of ten.", maxBeacons);
+  cmd.AddValue ("rounds", "Repetitions of the lookup and HELLO phases.", rounds);
+  cmd.AddValue ("nodes", "Compare the memory of this many tables instead of timing one.", nodes);
+  cmd.AddValue ("beacons", "Beacons known by every node in the memory comparison.", beacons);
+  cmd.AddValue ("known", "Beacons known by each node in the memory comparison, 0 for all of them.", known);
+  cmd.AddValue ("layout", "Tables built by the memory comparison: map, flat, arena or all.", layout);
+  cmd.AddValue ("localization", "Time the position estimates instead of the table.", localization);
+  cmd.AddValue ("batch", "Time the localization of this many nodes at once instead of the table.", batch);
+  cmd.AddValue ("precision", "Compare the numeric policies of the localization instead of the table.", precision);
+  cmd.Parse (argc, argv);
+
+  if (nodes > 0)
+    {
+      RunMemoryComparison (nodes, beacons, known, layout);
+      return 0;
+    }
+  if (batch > 0)
+    {
+      RunBatchComparison (batch, beacons);
+      return 0;
+    }
+  if (precision)
+    {
+      RunPrecisionComparison (rounds * 1000, beacons);
+      return 0;
+    }
+  if (localization)
+    {
+      RunLocalizationComparison (beacons, rounds * 1000);
+      return 0;
+    }
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (1);
+
+  std::cout << std::fixed << std::setprecision (1);
+  std::cout << std::setw (8) << "beacons" << std::setw (10) << "phase"
+            << std::setw (14) << "map ns/entry" << std::setw (15) << "flat ns/entry" << "\n";
+
+  for (uint32_t n = 10; n <= maxBeacons; n *= 10)
+    {
+      std::vector<Ipv4Address> beacons;
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          beacons.push_back (Ipv4Address (rng->GetInteger (0x0a000000, 0x0affffff)));
+        }
+
+      MapTable map;
+      dvhop::DistanceTable flat;
+      Clock::time_point start;
+      double mapNs, flatNs;
+      uint64_t sink = 0;
+
+      start = Clock::now ();
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          map.AddBeacon (beacons[i], 1 + i % 20, i, i, 1);
+        }
+      mapNs = NsPerOp (start, n);
+      start = Clock::now ();
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          flat.AddBeacon (beacons[i], 1 + i % 20, i, i, 1);
+        }
+      flatNs = NsPerOp (start, n);
+      std::cout << std::setw (8) << n << std::setw (10) << "insert" << std::setw (14) << mapNs << std::setw (15) << flatNs << "\n";
+
+      start = Clock::now ();
+      for (uint32_t r = 0; r < rounds; ++r)
+        {
+          for (uint32_t i = 0; i < n; ++i)
+            {
+              sink += map.GetHopsTo (beacons[i]);
+            }
+        }
+      mapNs = NsPerOp (start, uint64_t (n) * rounds);
+      start = Clock::now ();
+      for (uint32_t r = 0; r < rounds; ++r)
+        {
+          for (uint32_t i = 0; i < n; ++i)
+            {
+              sink += flat.GetHopsTo (beacons[i]);
+            }
+        }
+      flatNs = NsPerOp (start, uint64_t (n) * rounds);
+      std::cout << std::setw (8) << n << std::setw (10) << "lookup" << std::setw (14) << mapNs << std::setw (15) << flatNs << "\n";
+
+      //Building a HELLO: every entry with its position, hops and sequence number
+      start = Clock::now ();
+      for (uint32_t r = 0; r < rounds; ++r)
+        {
+          std::vector<Ipv4Address> known = map.GetKnownBeacons ();
+          for (std::vector<Ipv4Address>::const_iterator it = known.begin (); it != known.end (); ++it)
+            {
+              sink += map.GetBeaconPosition (*it).first + map.GetHopsTo (*it) + map.GetSequenceNumber (*it);
+            }
+        }
+      mapNs = NsPerOp (start, uint64_t (n) * rounds);
+      start = Clock::now ();
+      for (uint32_t r = 0; r < rounds; ++r)
+        {
+          flat.ForEach ([&sink] (Ipv4Address, dvhop::BeaconInfo const &info)
+            {
+              sink += info.GetPosition ().first + info.GetHops () + info.GetSeqNo ();
+            });
+        }
+      flatNs = NsPerOp (start, uint64_t (n) * rounds);
+      std::cout << std::setw (8) << n << std::setw (10) << "hello" << std::setw (14) << mapNs << std::setw (15) << flatNs << "\n";
+
+      //Keeps the compiler from dropping the loops
+      if (sink == 0)
+        {
+          std::cout << "";
+        }
+    }
+
+  return 0;
+}
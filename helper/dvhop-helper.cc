@@ -8,6 +8,7 @@
 #include "ns3/ipv4-list-routing.h"
 #include "ns3/node.h"
 #include "ns3/simulator.h"
+#include "ns3/enum.h"
 #include "ns3/dvhop.h"
 
 namespace ns3 {
@@ -27,6 +28,10 @@ namespace ns3 {
   DVHopHelper::Create (Ptr<Node> node) const
   {
     Ptr<dvhop::RoutingProtocol> agent = m_agentFactory.Create<dvhop::RoutingProtocol> ();
+    if (m_arena)
+      {
+        agent->SetTableArena (m_arena);
+      }
     node->AggregateObject (agent);
     return agent;
   }
@@ -37,6 +42,21 @@ namespace ns3 {
     m_agentFactory.Set (name, value);
   }
 
+  void
+  DVHopHelper::SetHelloFormat (dvhop::RoutingProtocol::HelloFormat format)
+  {
+    m_agentFactory.Set ("HelloFormat", EnumValue (format));
+  }
+
+  void
+  DVHopHelper::EnableTableArena ()
+  {
+    if (!m_arena)
+      {
+        m_arena = ns3::Create<dvhop::DistanceTableArena> ();
+      }
+  }
+
   int64_t
   DVHopHelper::AssignStreams (NodeContainer c, int64_t stream)
   {
@@ -8,6 +8,7 @@
 #include "ns3/node-container.h"
 #include "ns3/output-stream-wrapper.h"
 #include "ns3/ipv4-list-routing.h"
+#include "ns3/dvhop.h"
 
 namespace ns3 {
 
@@ -36,6 +37,22 @@ namespace ns3 {
      */
     void Set(std::string name, const AttributeValue &value);
 
+    /**
+     *Chooses between one HELLO packet per beacon and HELLO packets aggregating several beacons
+     */
+    void SetHelloFormat (dvhop::RoutingProtocol::HelloFormat format);
+
+    /**
+     *Stores the DistanceTables of every node created from now on in one shared
+     *arena, interning beacons and their positions once, for large simulations
+     */
+    void EnableTableArena ();
+
+    /**
+     *The shared arena, or a null pointer when it is not enabled
+     */
+    Ptr<dvhop::DistanceTableArena> GetTableArena () const { return m_arena; }
+
     /**
      *Assign a fixed random variable stream number to the random variables used by this model
      */
@@ -51,6 +68,9 @@ namespace ns3 {
 
     /*The factory to create DVHope Routing object*/
     ObjectFactory m_agentFactory;
+
+    /*Storage shared by the DistanceTables, when enabled. Copies of the helper share it*/
+    Ptr<dvhop::DistanceTableArena> m_arena;
   };
 
 }
@@ -0,0 +1,66 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "unit-disk-helper.h"
+#include "ns3/node.h"
+#include "ns3/mac48-address.h"
+
+#include <set>
+
+namespace ns3 {
+
+  UnitDiskHelper::UnitDiskHelper()
+  {
+    m_channelFactory.SetTypeId ("ns3::dvhop::UnitDiskChannel");
+    m_deviceFactory.SetTypeId ("ns3::dvhop::UnitDiskNetDevice");
+  }
+
+  void
+  UnitDiskHelper::SetChannelAttribute (std::string name, const AttributeValue &value)
+  {
+    m_channelFactory.Set (name, value);
+  }
+
+  void
+  UnitDiskHelper::SetDeviceAttribute (std::string name, const AttributeValue &value)
+  {
+    m_deviceFactory.Set (name, value);
+  }
+
+  NetDeviceContainer
+  UnitDiskHelper::Install (NodeContainer c) const
+  {
+    return Install (c, m_channelFactory.Create<dvhop::UnitDiskChannel> ());
+  }
+
+  NetDeviceContainer
+  UnitDiskHelper::Install (NodeContainer c, Ptr<dvhop::UnitDiskChannel> channel) const
+  {
+    NetDeviceContainer devices;
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Ptr<dvhop::UnitDiskNetDevice> device = m_deviceFactory.Create<dvhop::UnitDiskNetDevice> ();
+        device->SetAddress (Mac48Address::Allocate ());
+        (*i)->AddDevice (device);
+        device->SetChannel (channel);
+        devices.Add (device);
+      }
+    return devices;
+  }
+
+  int64_t
+  UnitDiskHelper::AssignStreams (NetDeviceContainer c, int64_t stream)
+  {
+    int64_t currentStream = stream;
+    std::set<Ptr<Channel> > done;
+    for (NetDeviceContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Ptr<dvhop::UnitDiskChannel> channel = DynamicCast<dvhop::UnitDiskChannel> ((*i)->GetChannel ());
+        if (channel && done.insert (channel).second)
+          {
+            currentStream += channel->AssignStreams (currentStream);
+          }
+      }
+    return (currentStream - stream);
+  }
+
+}
@@ -0,0 +1,57 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef UNIT_DISK_HELPER_H
+#define UNIT_DISK_HELPER_H
+
+#include "ns3/ptr.h"
+#include "ns3/object-factory.h"
+#include "ns3/node-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/unit-disk-channel.h"
+#include "ns3/unit-disk-net-device.h"
+
+namespace ns3 {
+
+  /**
+   *Installs UnitDiskNetDevices on a set of nodes, all attached to one UnitDiskChannel.
+   *Nodes need a MobilityModel before the simulation starts; the devices then take
+   *InternetStackHelper and DVHopHelper as a Wi-Fi device would
+   */
+  class UnitDiskHelper
+  {
+  public:
+    UnitDiskHelper();
+
+    /**
+     *Controls the attributes of ns3::dvhop::UnitDiskChannel: Range, LossProbability and Delay
+     */
+    void SetChannelAttribute (std::string name, const AttributeValue &value);
+
+    /**
+     *Controls the attributes of ns3::dvhop::UnitDiskNetDevice
+     */
+    void SetDeviceAttribute (std::string name, const AttributeValue &value);
+
+    /**
+     *Installs one device per node on a new channel
+     */
+    NetDeviceContainer Install (NodeContainer c) const;
+
+    /**
+     *Installs one device per node on the given channel
+     */
+    NetDeviceContainer Install (NodeContainer c, Ptr<dvhop::UnitDiskChannel> channel) const;
+
+    /**
+     *Assign a fixed random variable stream number to the link losses of the channels
+     *of these devices
+     */
+    int64_t AssignStreams (NetDeviceContainer c, int64_t stream);
+
+  private:
+    ObjectFactory m_channelFactory;
+    ObjectFactory m_deviceFactory;
+  };
+
+}
+
+#endif /* UNIT_DISK_HELPER_H */
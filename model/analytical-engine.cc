@@ -0,0 +1,317 @@
+#include "analytical-engine.h"
+#include "spatial-grid.h"
+#include "worker-pool.h"
+
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    namespace
+    {
+      //Beacons searched together, one per bit of a word
+      const uint32_t GROUP_SIZE = 64;
+    }
+
+    AnalyticalEngine::AnalyticalEngine() :
+      m_range (0),
+      m_threads (0),
+      m_precision (LocalizationSolver::DOUBLE),
+      m_refinement (false),
+      m_refinementIterations (5),
+      m_refinementTolerance (0.01),
+      m_base ("10.0.0.0")
+    {
+    }
+
+    void
+    AnalyticalEngine::SetRefinement(bool enable, uint32_t iterations, double tolerance)
+    {
+      m_refinement = enable;
+      m_refinementIterations = iterations;
+      m_refinementTolerance = tolerance;
+    }
+
+    void
+    AnalyticalEngine::Clear()
+    {
+      m_x.clear ();
+      m_y.clear ();
+      m_isBeacon.clear ();
+      m_beacons.clear ();
+      m_offsets.clear ();
+      m_adjacency.clear ();
+      m_hops.clear ();
+      m_hopSizes.clear ();
+      m_estX.clear ();
+      m_estY.clear ();
+      m_solved.clear ();
+    }
+
+    uint32_t
+    AnalyticalEngine::AddNode(double x, double y, bool isBeacon)
+    {
+      uint32_t node = m_x.size ();
+      m_x.push_back (x);
+      m_y.push_back (y);
+      m_isBeacon.push_back (isBeacon);
+      if (isBeacon)
+        {
+          m_beacons.push_back (node);
+        }
+      return node;
+    }
+
+    uint16_t
+    AnalyticalEngine::GetHops(uint32_t node, uint32_t beacon) const
+    {
+      return m_hops[static_cast<uint64_t> (beacon) * GetNNodes () + node];
+    }
+
+    bool
+    AnalyticalEngine::GetPosition(uint32_t node, double &x, double &y) const
+    {
+      if (!m_solved[node])
+        {
+          return false;
+        }
+      x = m_estX[node];
+      y = m_estY[node];
+      return true;
+    }
+
+    void
+    AnalyticalEngine::Run()
+    {
+      uint32_t nodes = GetNNodes ();
+      uint32_t beacons = GetNBeacons ();
+
+      BuildLinks ();
+
+      m_hops.assign (static_cast<uint64_t> (beacons) * nodes, 0);
+      RunWorkers (&AnalyticalEngine::SearchGroups, (beacons + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+      //Hop sizes. Beacons: the distance to the beacons they reach over the hops to them
+      m_hopSizes.assign (nodes, 0);
+      for (uint32_t b = 0; b < beacons; ++b)
+        {
+          uint32_t node = m_beacons[b];
+          double distance = 0;
+          uint32_t hops = 0;
+          for (uint32_t c = 0; c < beacons; ++c)
+            {
+              uint16_t h = GetHops (node, c);
+              if (h != 0)
+                {
+                  distance += std::hypot (m_x[m_beacons[c]] - m_x[node], m_y[m_beacons[c]] - m_y[node]);
+                  hops += h;
+                }
+            }
+          m_hopSizes[node] = hops > 0 ? distance / hops : 0;
+        }
+      //Other nodes: the hop size of the nearest beacon, the first one on a tie
+      std::vector<uint16_t> nearest (nodes, 0xffff);
+      for (uint32_t b = 0; b < beacons; ++b)
+        {
+          double hopSize = m_hopSizes[m_beacons[b]];
+          uint16_t const *hops = &m_hops[static_cast<uint64_t> (b) * nodes];
+          for (uint32_t node = 0; node < nodes; ++node)
+            {
+              if (!m_isBeacon[node] && hops[node] != 0 && hops[node] < nearest[node])
+                {
+                  nearest[node] = hops[node];
+                  m_hopSizes[node] = hopSize;
+                }
+            }
+        }
+
+      m_estX.assign (nodes, 0);
+      m_estY.assign (nodes, 0);
+      m_solved.assign (nodes, 0);
+      if (m_refinement)
+        {
+          //The tables of the refinement read the simulation clock: create it here, so
+          //that the workers only ever read it
+          Simulator::Now ();
+        }
+      RunWorkers (&AnalyticalEngine::Localize, nodes, MIN_NODES_PER_THREAD);
+    }
+
+    void
+    AnalyticalEngine::BuildLinks()
+    {
+      uint32_t nodes = GetNNodes ();
+      m_offsets.assign (nodes + 1, 0);
+      m_adjacency.clear ();
+      if (nodes == 0 || m_range <= 0)
+        {
+          return;
+        }
+
+      //The neighbours of a node are among those of the cells around it
+      SpatialGrid grid;
+      for (uint32_t i = 0; i < nodes; ++i)
+        {
+          grid.Add (i, m_x[i], m_y[i]);
+        }
+      grid.Build (m_range);
+
+      double range2 = m_range * m_range;
+      std::vector<uint32_t> near;
+      for (uint32_t i = 0; i < nodes; ++i)
+        {
+          near.clear ();
+          grid.GetNear (m_x[i], m_y[i], near);
+          for (std::vector<uint32_t>::const_iterator j = near.begin (); j != near.end (); ++j)
+            {
+              double dx = m_x[*j] - m_x[i];
+              double dy = m_y[*j] - m_y[i];
+              //Within the range, as RangePropagationLossModel
+              if (*j != i && dx * dx + dy * dy <= range2)
+                {
+                  m_adjacency.push_back (*j);
+                }
+            }
+          m_offsets[i + 1] = m_adjacency.size ();
+        }
+    }
+
+    void
+    AnalyticalEngine::SearchGroups(uint32_t begin, uint32_t end)
+    {
+      uint32_t nodes = GetNNodes ();
+      std::vector<uint64_t> visited (nodes);
+      std::vector<uint64_t> frontier (nodes);
+      std::vector<uint64_t> next (nodes);
+      for (uint32_t group = begin; group < end; ++group)
+        {
+          //Bit k of a word stands for beacon first + k
+          uint32_t first = group * GROUP_SIZE;
+          uint32_t count = std::min (GROUP_SIZE, GetNBeacons () - first);
+          std::fill (visited.begin (), visited.end (), 0);
+          std::fill (frontier.begin (), frontier.end (), 0);
+          for (uint32_t k = 0; k < count; ++k)
+            {
+              visited[m_beacons[first + k]] |= uint64_t (1) << k;
+              frontier[m_beacons[first + k]] |= uint64_t (1) << k;
+            }
+
+          //Level by level: a node is reached at this level by the beacons that reached
+          //one of its neighbours at the previous one, and not itself before
+          for (uint16_t hops = 1; hops != 0; ++hops)
+            {
+              bool reached = false;
+              for (uint32_t node = 0; node < nodes; ++node)
+                {
+                  uint64_t bits = 0;
+                  for (uint32_t a = m_offsets[node]; a < m_offsets[node + 1]; ++a)
+                    {
+                      bits |= frontier[m_adjacency[a]];
+                    }
+                  bits &= ~visited[node];
+                  next[node] = bits;
+                  if (bits == 0)
+                    {
+                      continue;
+                    }
+                  reached = true;
+                  visited[node] |= bits;
+                  for (; bits != 0; bits &= bits - 1)
+                    {
+                      uint32_t k = __builtin_ctzll (bits);
+                      m_hops[static_cast<uint64_t> (first + k) * nodes + node] = hops;
+                    }
+                }
+              if (!reached)
+                {
+                  break;
+                }
+              frontier.swap (next);
+            }
+        }
+    }
+
+    void
+    AnalyticalEngine::Localize(uint32_t begin, uint32_t end)
+    {
+      LocalizationSolver solver;
+      solver.SetPrecision (m_precision);
+      for (uint32_t node = begin; node < end; ++node)
+        {
+          double hopSize = m_hopSizes[node];
+          if (m_isBeacon[node] || hopSize <= 0)
+            {
+              continue;
+            }
+          solver.Reset ();
+          for (uint32_t b = 0; b < GetNBeacons (); ++b)
+            {
+              uint16_t hops = GetHops (node, b);
+              if (hops != 0)
+                {
+                  solver.AddBeacon (m_x[m_beacons[b]], m_y[m_beacons[b]], hops);
+                }
+            }
+          double x, y;
+          if (!solver.Solve (hopSize, x, y))
+            {
+              continue;
+            }
+          if (m_refinement)
+            {
+              DistanceTable table;
+              FillTable (node, table);
+              solver.Refine (table, hopSize, m_refinementIterations, m_refinementTolerance, x, y);
+            }
+          m_estX[node] = x;
+          m_estY[node] = y;
+          m_solved[node] = 1;
+        }
+    }
+
+    void
+    AnalyticalEngine::RunWorkers(void (AnalyticalEngine::*work)(uint32_t, uint32_t), uint32_t items, uint32_t minItems)
+    {
+      ParallelFor (items, m_threads, minItems, std::bind (work, this, std::placeholders::_1, std::placeholders::_2));
+    }
+
+    void
+    AnalyticalEngine::FillTable(uint32_t node, DistanceTable &table) const
+    {
+      for (uint32_t b = 0; b < GetNBeacons (); ++b)
+        {
+          uint16_t hops = GetHops (node, b);
+          if (hops != 0)
+            {
+              uint32_t beacon = m_beacons[b];
+              table.AddBeacon (GetAddress (beacon), hops, m_x[beacon], m_y[beacon]);
+            }
+        }
+    }
+
+    void
+    AnalyticalEngine::WriteLocalization(std::ostream &os, double time) const
+    {
+      for (uint32_t node = 0; node < GetNNodes (); ++node)
+        {
+          if (!m_solved[node])
+            {
+              continue;
+            }
+          double error = std::hypot (m_estX[node] - m_x[node], m_estY[node] - m_y[node]);
+          os << time << ","
+             << node << ","
+             << m_x[node] << "," << m_y[node] << ","
+             << m_estX[node] << "," << m_estY[node] << ","
+             << error << "\n";
+        }
+    }
+
+  }
+}
@@ -0,0 +1,146 @@
+#ifndef ANALYTICALENGINE_H
+#define ANALYTICALENGINE_H
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+#include "ns3/ipv4-address.h"
+#include "distance-table.h"
+#include "dvhop-localization.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /**
+     * @brief The AnalyticalEngine class computes the converged state of DV-Hop straight
+     *from the node positions, without any packet, for fast parameter sweeps.
+     *
+     *On a unit-disk graph, and with static nodes, every DistanceTable of the protocol
+     *ends up holding the shortest hop counts to the beacons. Run computes them directly:
+     *- the links come from a grid of cells no smaller than the range, so that each node
+     *  only looks at the nodes of its own and the 8 surrounding cells
+     *- the hop counts come from a multi-source BFS, 64 beacons at a time as the bits of
+     *  one word per node, the groups of beacons split across worker threads
+     *- the hop sizes and the positions then follow the same rules, and use the same
+     *  LocalizationSolver, as RoutingProtocol: each beacon averages over the beacons it
+     *  reaches, and the other nodes take the hop size of their nearest beacon
+     *
+     *Node i gets the address the examples give it, base + i + 1, so that the tables can
+     *be compared with the ones of a packet-level run.
+     */
+    class AnalyticalEngine
+    {
+    public:
+      AnalyticalEngine();
+
+      /**
+       * @brief SetRange Radio range: two nodes are linked when they are at most this far apart
+       */
+      void SetRange(double range)                 { m_range = range; }
+
+      /**
+       * @brief SetThreads Number of worker threads used by Run, 0 for one per core
+       */
+      void SetThreads(uint32_t threads)           { m_threads = threads; }
+
+      /**
+       * @brief SetPrecision Numeric policy of the localization, as the Precision attribute
+       */
+      void SetPrecision(LocalizationSolver::Precision precision) { m_precision = precision; }
+
+      /**
+       * @brief SetRefinement Levenberg-Marquardt refinement of the estimates, as the
+       *Refinement, RefinementIterations and RefinementTolerance attributes
+       */
+      void SetRefinement(bool enable, uint32_t iterations = 5, double tolerance = 0.01);
+
+      /**
+       * @brief SetBaseAddress Network address of the nodes, node i being base + i + 1
+       */
+      void SetBaseAddress(Ipv4Address base)       { m_base = base; }
+
+      /**
+       * @brief Clear Forgets every node
+       */
+      void Clear();
+
+      /**
+       * @brief AddNode Places one node
+       * @return The index of the node
+       */
+      uint32_t AddNode(double x, double y, bool isBeacon);
+
+      /**
+       * @brief Run Computes the links, the hop counts, the hop sizes and the positions
+       */
+      void Run();
+
+      /**
+       * @brief Results, after Run
+       */
+      //{
+      uint32_t    GetNNodes() const                { return m_x.size (); }
+      uint32_t    GetNBeacons() const              { return m_beacons.size (); }
+      uint32_t    GetBeaconNode(uint32_t beacon) const { return m_beacons[beacon]; }
+      Ipv4Address GetAddress(uint32_t node) const  { return Ipv4Address (m_base.Get () + node + 1); }
+      uint64_t    GetNLinks() const                { return m_adjacency.size () / 2; }
+      /// Hops from a node to the beacon-th beacon, 0 when it is out of reach or the node itself
+      uint16_t    GetHops(uint32_t node, uint32_t beacon) const;
+      /// Hop size known by a node, 0 when it reaches no beacon
+      double      GetHopSize(uint32_t node) const  { return m_hopSizes[node]; }
+      /// false for beacons, and for nodes without a solution (see Localization::Solve)
+      bool        GetPosition(uint32_t node, double &x, double &y) const;
+      //}
+
+      /**
+       * @brief FillTable Adds the beacons a node reaches to a DistanceTable, as the
+       *protocol would have them once converged
+       */
+      void FillTable(uint32_t node, DistanceTable &table) const;
+
+      /**
+       * @brief WriteLocalization Writes one line per localized node, in the format of the
+       *localization CSV of the packet-level examples: Time,Node,RealX,RealY,EstimatedX,
+       *EstimatedY,LocalizationError
+       * @param os The stream, the header line is the caller's
+       * @param time The value of the Time column
+       */
+      void WriteLocalization(std::ostream &os, double time) const;
+
+    private:
+      void BuildLinks();
+      void SearchGroups(uint32_t begin, uint32_t end);
+      void Localize(uint32_t begin, uint32_t end);
+      void RunWorkers(void (AnalyticalEngine::*work)(uint32_t, uint32_t), uint32_t items, uint32_t minItems);
+
+      double                        m_range;
+      uint32_t                      m_threads;
+      LocalizationSolver::Precision m_precision;
+      bool                          m_refinement;
+      uint32_t                      m_refinementIterations;
+      double                        m_refinementTolerance;
+      Ipv4Address                   m_base;
+      //Nodes
+      std::vector<double>   m_x;
+      std::vector<double>   m_y;
+      std::vector<uint8_t>  m_isBeacon;
+      std::vector<uint32_t> m_beacons;       //Node of each beacon
+      //Links, compressed rows: the neighbours of node i are m_adjacency[m_offsets[i] .. m_offsets[i + 1])
+      std::vector<uint32_t> m_offsets;
+      std::vector<uint32_t> m_adjacency;
+      //Hops of every node to every beacon, beacon after beacon
+      std::vector<uint16_t> m_hops;
+      //Hop sizes and estimates
+      std::vector<double>   m_hopSizes;
+      std::vector<double>   m_estX;
+      std::vector<double>   m_estY;
+      std::vector<uint8_t>  m_solved;
+    };
+
+  }
+}
+
+#endif // ANALYTICALENGINE_H
@@ -0,0 +1,298 @@
+#include "batch-localization.h"
+#include "dvhop-localization.h"
+#include "worker-pool.h"
+
+#include <algorithm>
+#include <functional>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DVHOP_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    namespace
+    {
+      //Order of the sums filled by the kernels, the fields of Localization::Terms
+      enum Sum { SX, SY, SXX, SYY, SXY, SQ, SXQ, SYQ, SH, SXH, SYH, N_SUMS };
+
+      //Same operations, in the same order, as Localization::Accumulate
+      void
+      SumScalar(double const *x, double const *y, double const *h, uint32_t begin, uint32_t end,
+                double ox, double oy, double sums[N_SUMS])
+      {
+        for (uint32_t i = begin; i < end; ++i)
+          {
+            double dx = x[i] - ox;
+            double dy = y[i] - oy;
+            double q  = dx * dx + dy * dy;
+            double h2 = h[i] * h[i];
+            sums[SX]  += dx;
+            sums[SY]  += dy;
+            sums[SXX] += dx * dx;
+            sums[SYY] += dy * dy;
+            sums[SXY] += dx * dy;
+            sums[SQ]  += q;
+            sums[SXQ] += dx * q;
+            sums[SYQ] += dy * q;
+            sums[SH]  += h2;
+            sums[SXH] += dx * h2;
+            sums[SYH] += dy * h2;
+          }
+      }
+
+#ifdef DVHOP_AVX2_KERNEL
+      __attribute__ ((target ("avx2"))) void
+      SumAvx2(double const *x, double const *y, double const *h, uint32_t n,
+              double ox, double oy, double sums[N_SUMS])
+      {
+        __m256d ox4 = _mm256_set1_pd (ox);
+        __m256d oy4 = _mm256_set1_pd (oy);
+        __m256d acc[N_SUMS];
+        for (int s = 0; s < N_SUMS; ++s)
+          {
+            acc[s] = _mm256_setzero_pd ();
+          }
+
+        uint32_t i = 0;
+        for (; i + 4 <= n; i += 4)
+          {
+            __m256d dx = _mm256_sub_pd (_mm256_loadu_pd (x + i), ox4);
+            __m256d dy = _mm256_sub_pd (_mm256_loadu_pd (y + i), oy4);
+            __m256d hh = _mm256_loadu_pd (h + i);
+            __m256d xx = _mm256_mul_pd (dx, dx);
+            __m256d yy = _mm256_mul_pd (dy, dy);
+            __m256d q  = _mm256_add_pd (xx, yy);
+            __m256d h2 = _mm256_mul_pd (hh, hh);
+            acc[SX]  = _mm256_add_pd (acc[SX], dx);
+            acc[SY]  = _mm256_add_pd (acc[SY], dy);
+            acc[SXX] = _mm256_add_pd (acc[SXX], xx);
+            acc[SYY] = _mm256_add_pd (acc[SYY], yy);
+            acc[SXY] = _mm256_add_pd (acc[SXY], _mm256_mul_pd (dx, dy));
+            acc[SQ]  = _mm256_add_pd (acc[SQ], q);
+            acc[SXQ] = _mm256_add_pd (acc[SXQ], _mm256_mul_pd (dx, q));
+            acc[SYQ] = _mm256_add_pd (acc[SYQ], _mm256_mul_pd (dy, q));
+            acc[SH]  = _mm256_add_pd (acc[SH], h2);
+            acc[SXH] = _mm256_add_pd (acc[SXH], _mm256_mul_pd (dx, h2));
+            acc[SYH] = _mm256_add_pd (acc[SYH], _mm256_mul_pd (dy, h2));
+          }
+
+        double lanes[4];
+        for (int s = 0; s < N_SUMS; ++s)
+          {
+            _mm256_storeu_pd (lanes, acc[s]);
+            sums[s] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+          }
+        //Leave no dirty upper halves to the SSE code of the tail, and of the caller
+        _mm256_zeroupper ();
+        SumScalar (x, y, h, i, n, ox, oy, sums);
+      }
+
+      __attribute__ ((target ("avx2"))) inline __m256d
+      Lanes(double const sums[4][N_SUMS], int s)
+      {
+        return _mm256_set_pd (sums[3][s], sums[2][s], sums[1][s], sums[0][s]);
+      }
+
+      //Localization::Solve for four systems, one per lane, with the same operations in
+      //the same order. x and y are only written for the lanes that have a solution
+      __attribute__ ((target ("avx2"))) void
+      SolveAvx2(double const sums[4][N_SUMS], double const count[4], double const hopSize[4],
+                double const ox[4], double const oy[4], double *x, double *y, uint8_t *solved)
+      {
+        __m256d n   = _mm256_loadu_pd (count);
+        __m256d hs  = _mm256_loadu_pd (hopSize);
+        __m256d s2  = _mm256_mul_pd (hs, hs);
+        __m256d sx  = Lanes (sums, SX);
+        __m256d sy  = Lanes (sums, SY);
+        __m256d cxx = _mm256_sub_pd (Lanes (sums, SXX), _mm256_div_pd (_mm256_mul_pd (sx, sx), n));
+        __m256d cyy = _mm256_sub_pd (Lanes (sums, SYY), _mm256_div_pd (_mm256_mul_pd (sy, sy), n));
+        __m256d cxy = _mm256_sub_pd (Lanes (sums, SXY), _mm256_div_pd (_mm256_mul_pd (sx, sy), n));
+        __m256d sc  = _mm256_sub_pd (Lanes (sums, SQ), _mm256_mul_pd (s2, Lanes (sums, SH)));
+        __m256d cxc = _mm256_sub_pd (_mm256_sub_pd (Lanes (sums, SXQ), _mm256_mul_pd (s2, Lanes (sums, SXH))),
+                                     _mm256_div_pd (_mm256_mul_pd (sx, sc), n));
+        __m256d cyc = _mm256_sub_pd (_mm256_sub_pd (Lanes (sums, SYQ), _mm256_mul_pd (s2, Lanes (sums, SYH))),
+                                     _mm256_div_pd (_mm256_mul_pd (sy, sc), n));
+
+        __m256d det   = _mm256_sub_pd (_mm256_mul_pd (cxx, cyy), _mm256_mul_pd (cxy, cxy));
+        __m256d trace = _mm256_add_pd (cxx, cyy);
+        //The negations of the failures of the scalar solve, NaNs included
+        __m256d bound = _mm256_mul_pd (_mm256_mul_pd (_mm256_set1_pd (COLLINEAR_RATIO), trace), trace);
+        __m256d ok = _mm256_and_pd (_mm256_cmp_pd (n, _mm256_set1_pd (3), _CMP_GE_OQ),
+                                    _mm256_and_pd (_mm256_cmp_pd (trace, _mm256_setzero_pd (), _CMP_NLE_UQ),
+                                                   _mm256_cmp_pd (det, bound, _CMP_NLE_UQ)));
+        __m256d det2 = _mm256_mul_pd (_mm256_set1_pd (2), det);
+        __m256d ex = _mm256_add_pd (_mm256_loadu_pd (ox),
+                                    _mm256_div_pd (_mm256_sub_pd (_mm256_mul_pd (cyy, cxc), _mm256_mul_pd (cxy, cyc)), det2));
+        __m256d ey = _mm256_add_pd (_mm256_loadu_pd (oy),
+                                    _mm256_div_pd (_mm256_sub_pd (_mm256_mul_pd (cxx, cyc), _mm256_mul_pd (cxy, cxc)), det2));
+
+        double lx[4], ly[4];
+        _mm256_storeu_pd (lx, ex);
+        _mm256_storeu_pd (ly, ey);
+        int mask = _mm256_movemask_pd (ok);
+        _mm256_zeroupper ();
+        for (int l = 0; l < 4; ++l)
+          {
+            solved[l] = (mask >> l) & 1;
+            if (solved[l])
+              {
+                x[l] = lx[l];
+                y[l] = ly[l];
+              }
+          }
+      }
+#endif
+
+      //The sums of one node, its first beacon as the origin, as in Localization::AddBeacon
+      void
+      SumNode(double const *x, double const *y, double const *h, uint32_t n, bool simd, double sums[N_SUMS])
+      {
+        std::fill (sums, sums + N_SUMS, 0.0);
+        if (n == 0)
+          {
+            return;
+          }
+#ifdef DVHOP_AVX2_KERNEL
+        if (simd)
+          {
+            SumAvx2 (x, y, h, n, x[0], y[0], sums);
+            return;
+          }
+#endif
+        SumScalar (x, y, h, 0, n, x[0], y[0], sums);
+      }
+    }
+
+    BatchLocalization::BatchLocalization() :
+      m_threads (0),
+      m_simd (true)
+    {
+      m_offsets.push_back (0);
+    }
+
+    bool
+    BatchLocalization::HasSimd()
+    {
+#ifdef DVHOP_AVX2_KERNEL
+      return __builtin_cpu_supports ("avx2");
+#else
+      return false;
+#endif
+    }
+
+    void
+    BatchLocalization::Clear()
+    {
+      m_x.clear ();
+      m_y.clear ();
+      m_hops.clear ();
+      m_offsets.assign (1, 0);
+      m_hopSizes.clear ();
+      m_estX.clear ();
+      m_estY.clear ();
+      m_solved.clear ();
+    }
+
+    uint32_t
+    BatchLocalization::AddNode(DistanceTable const &table, double hopSize)
+    {
+      size_t i = m_x.size ();
+      m_x.resize (i + table.GetSize ());
+      m_y.resize (i + table.GetSize ());
+      m_hops.resize (i + table.GetSize ());
+      table.ForEach ([this, &i] (Ipv4Address, BeaconInfo const &info)
+        {
+          m_x[i] = info.GetPosition ().first;
+          m_y[i] = info.GetPosition ().second;
+          m_hops[i] = info.GetHops ();
+          i++;
+        });
+      m_offsets.push_back (m_x.size ());
+      m_hopSizes.push_back (hopSize);
+      return m_hopSizes.size () - 1;
+    }
+
+    void
+    BatchLocalization::Solve()
+    {
+      uint32_t nodes = GetNNodes ();
+      m_estX.assign (nodes, 0);
+      m_estY.assign (nodes, 0);
+      m_solved.assign (nodes, 0);
+      bool simd = m_simd && HasSimd ();
+
+      ParallelFor (nodes, m_threads, MIN_NODES_PER_THREAD,
+                   std::bind (&BatchLocalization::SolveRange, this, std::placeholders::_1, std::placeholders::_2, simd));
+    }
+
+    void
+    BatchLocalization::SolveRange(uint32_t begin, uint32_t end, bool simd)
+    {
+      uint32_t node = begin;
+#ifdef DVHOP_AVX2_KERNEL
+      //Four nodes at a time: their sums one after the other, then one solve for the four
+      for (; simd && node + 4 <= end; node += 4)
+        {
+          double sums[4][N_SUMS];
+          double count[4], ox[4], oy[4];
+          for (uint32_t l = 0; l < 4; ++l)
+            {
+              uint32_t first = m_offsets[node + l];
+              uint32_t n = m_offsets[node + l + 1] - first;
+              SumNode (m_x.data () + first, m_y.data () + first, m_hops.data () + first, n, true, sums[l]);
+              count[l] = n;
+              ox[l] = n > 0 ? m_x[first] : 0;
+              oy[l] = n > 0 ? m_y[first] : 0;
+            }
+          SolveAvx2 (sums, count, &m_hopSizes[node], ox, oy, &m_estX[node], &m_estY[node], &m_solved[node]);
+        }
+#endif
+      for (; node < end; ++node)
+        {
+          uint32_t first = m_offsets[node];
+          uint32_t n = m_offsets[node + 1] - first;
+          if (n == 0)
+            {
+              continue;
+            }
+
+          double sums[N_SUMS];
+          SumNode (&m_x[first], &m_y[first], &m_hops[first], n, simd, sums);
+          Localization::Terms terms;
+          terms.nBeacons = n;
+          terms.originX = m_x[first];
+          terms.originY = m_y[first];
+          terms.sx  = sums[SX];
+          terms.sy  = sums[SY];
+          terms.sxx = sums[SXX];
+          terms.syy = sums[SYY];
+          terms.sxy = sums[SXY];
+          terms.sq  = sums[SQ];
+          terms.sxq = sums[SXQ];
+          terms.syq = sums[SYQ];
+          terms.sh  = sums[SH];
+          terms.sxh = sums[SXH];
+          terms.syh = sums[SYH];
+          m_solved[node] = Localization::Solve (terms, m_hopSizes[node], m_estX[node], m_estY[node]);
+        }
+    }
+
+    bool
+    BatchLocalization::GetPosition(uint32_t node, double &x, double &y) const
+    {
+      if (node >= m_solved.size () || !m_solved[node])
+        {
+          return false;
+        }
+      x = m_estX[node];
+      y = m_estY[node];
+      return true;
+    }
+
+  }
+}
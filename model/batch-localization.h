@@ -0,0 +1,99 @@
+#ifndef BATCHLOCALIZATION_H
+#define BATCHLOCALIZATION_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "distance-table.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /**
+     * @brief The BatchLocalization class estimates the position of many nodes at once,
+     *for offline evaluation of large runs.
+     *
+     *The beacons of every node are gathered into one structure-of-arrays: the X, Y and
+     *hop columns of all the nodes, back to back, with the first entry of each node at
+     *m_offsets[node]. The normal equation sums of a node are then a straight reduction
+     *over its slice, done four beacons at a time with AVX2 when the CPU has it, and
+     *the O(1) solves follow four nodes at a time. The nodes are split across worker
+     *threads.
+     *
+     *Each node gets the same equations, origin and solve as a Localization filled from
+     *its DistanceTable: the scalar kernel gives bit-identical results, the AVX2 one only
+     *sums in a different order; its solve is lane by lane that of Localization.
+     *
+     *The batch only pays when the sums are not already at hand: a RoutingProtocol keeps
+     *those of its own table up to date, so reading its estimate is cheaper than gathering
+     *its table here.
+     */
+    class BatchLocalization
+    {
+    public:
+      BatchLocalization();
+
+      /**
+       * @brief SetThreads Number of worker threads used by Solve, 0 for one per core
+       */
+      void SetThreads(uint32_t threads) { m_threads = threads; }
+
+      /**
+       * @brief SetSimd Enables the AVX2 kernel, when the CPU supports it
+       */
+      void SetSimd(bool enable)         { m_simd = enable; }
+
+      /**
+       * @brief HasSimd true if the AVX2 kernel is compiled in and the CPU supports it
+       */
+      static bool HasSimd();
+
+      /**
+       * @brief Clear Forgets every node
+       */
+      void Clear();
+
+      /**
+       * @brief AddNode Gathers the beacons of one node
+       * @param table The distance table of the node
+       * @param hopSize The hop size known by the node
+       * @return The index of the node in the batch
+       */
+      uint32_t AddNode(DistanceTable const &table, double hopSize);
+
+      uint32_t GetNNodes() const { return m_hopSizes.size (); }
+
+      /**
+       * @brief Solve Estimates the position of every node in the batch
+       */
+      void Solve();
+
+      /**
+       * @brief GetPosition The estimate of a node, after Solve
+       * @return false when the node has no solution (see Localization::Solve)
+       */
+      bool GetPosition(uint32_t node, double &x, double &y) const;
+
+    private:
+      void SolveRange(uint32_t begin, uint32_t end, bool simd);
+
+      uint32_t m_threads;
+      bool     m_simd;
+      //Beacons of all the nodes, node after node
+      std::vector<double>   m_x;
+      std::vector<double>   m_y;
+      std::vector<double>   m_hops;
+      std::vector<uint32_t> m_offsets;
+      std::vector<double>   m_hopSizes;
+      //Estimates
+      std::vector<double>   m_estX;
+      std::vector<double>   m_estY;
+      std::vector<uint8_t>  m_solved;
+    };
+
+  }
+}
+
+#endif // BATCHLOCALIZATION_H
@@ -0,0 +1,187 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "convergence-monitor.h"
+#include "dvhop.h"
+#include "analytical-engine.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/ipv4.h"
+#include "ns3/mobility-model.h"
+#include "ns3/trace-source-accessor.h"
+
+NS_LOG_COMPONENT_DEFINE ("DVHopConvergenceMonitor");
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    NS_OBJECT_ENSURE_REGISTERED (ConvergenceMonitor);
+
+    TypeId
+    ConvergenceMonitor::GetTypeId (void)
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::ConvergenceMonitor")
+          .SetParent<Object> ()
+          .AddConstructor<ConvergenceMonitor> ()
+          .AddAttribute ("CheckInterval",
+                         "Time between two looks at the table changes.",
+                         TimeValue (Seconds (1)),
+                         MakeTimeAccessor (&ConvergenceMonitor::m_checkInterval),
+                         MakeTimeChecker ())
+          .AddAttribute ("QuietIntervals",
+                         "Checks in a row without any table change before declaring convergence.",
+                         UintegerValue (5),
+                         MakeUintegerAccessor (&ConvergenceMonitor::m_quietIntervals),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("StopOnConvergence",
+                         "Stop the simulation once converged.",
+                         BooleanValue (true),
+                         MakeBooleanAccessor (&ConvergenceMonitor::m_stopOnConvergence),
+                         MakeBooleanChecker ())
+          .AddAttribute ("OracleRange",
+                         "Check the tables at convergence against a breadth-first search over "
+                         "a unit disk of this range, m. Zero for no check.",
+                         DoubleValue (0),
+                         MakeDoubleAccessor (&ConvergenceMonitor::m_oracleRange),
+                         MakeDoubleChecker<double> (0))
+          .AddTraceSource ("Converged",
+                           "The tables have been quiet for QuietIntervals checks.",
+                           MakeTraceSourceAccessor (&ConvergenceMonitor::m_convergedTrace),
+                           "ns3::dvhop::ConvergenceMonitor::ConvergedTracedCallback");
+      return tid;
+    }
+
+    ConvergenceMonitor::ConvergenceMonitor () :
+      m_checkInterval (Seconds (1)),
+      m_quietIntervals (5),
+      m_stopOnConvergence (true),
+      m_oracleRange (0),
+      m_changes (0),
+      m_checkedChanges (0),
+      m_quiet (0),
+      m_converged (false),
+      m_mismatches (0)
+    {
+    }
+
+    void
+    ConvergenceMonitor::DoDispose (void)
+    {
+      m_checkEvent.Cancel ();
+      for (uint32_t i = 0; i < m_protocols.size (); ++i)
+        {
+          m_protocols[i]->TraceDisconnectWithoutContext ("TableUpdate", MakeBoundCallback (&ConvergenceMonitor::TableUpdated, this, i));
+        }
+      m_protocols.clear ();
+      m_nodes = NodeContainer ();
+      Object::DoDispose ();
+    }
+
+    void
+    ConvergenceMonitor::Install (NodeContainer nodes)
+    {
+      for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+        {
+          Ptr<Ipv4> ipv4 = (*n)->GetObject<Ipv4> ();
+          NS_ABORT_MSG_UNLESS (ipv4, "Ipv4 not installed on node " << (*n)->GetId ());
+          Ptr<RoutingProtocol> protocol = DynamicCast<RoutingProtocol> (ipv4->GetRoutingProtocol ());
+          NS_ABORT_MSG_UNLESS (protocol, "DV-Hop not installed on node " << (*n)->GetId ());
+          uint32_t i = m_protocols.size ();
+          protocol->TraceConnectWithoutContext ("TableUpdate", MakeBoundCallback (&ConvergenceMonitor::TableUpdated, this, i));
+          m_protocols.push_back (protocol);
+          m_nodes.Add (*n);
+          m_nodeLastChange.push_back (Seconds (0));
+        }
+      if (!m_checkEvent.IsRunning ())
+        {
+          m_checkEvent = Simulator::Schedule (m_checkInterval, &ConvergenceMonitor::Check, this);
+        }
+    }
+
+    void
+    ConvergenceMonitor::TableUpdated (ConvergenceMonitor *monitor, uint32_t node,
+                                      Ipv4Address, uint16_t, uint16_t)
+    {
+      monitor->m_nodeLastChange[node] = Simulator::Now ();
+      monitor->m_lastChange = Simulator::Now ();
+      ++monitor->m_changes;
+    }
+
+    void
+    ConvergenceMonitor::Check (void)
+    {
+      if (m_changes == 0 || m_changes != m_checkedChanges)
+        {
+          //Nothing learnt yet, or still learning
+          m_checkedChanges = m_changes;
+          m_quiet = 0;
+          m_checkEvent = Simulator::Schedule (m_checkInterval, &ConvergenceMonitor::Check, this);
+          return;
+        }
+      if (++m_quiet < m_quietIntervals)
+        {
+          m_checkEvent = Simulator::Schedule (m_checkInterval, &ConvergenceMonitor::Check, this);
+          return;
+        }
+
+      m_converged = true;
+      m_convergenceTime = m_lastChange;
+      m_detectionTime = Simulator::Now ();
+      NS_LOG_DEBUG ("Converged at " << m_convergenceTime.GetSeconds () << " s after " << m_changes
+                    << " table changes, detected at " << m_detectionTime.GetSeconds () << " s");
+      if (m_oracleRange > 0)
+        {
+          RunOracle ();
+        }
+      m_convergedTrace (m_convergenceTime);
+      if (m_stopOnConvergence)
+        {
+          Simulator::Stop ();
+        }
+    }
+
+    void
+    ConvergenceMonitor::RunOracle (void)
+    {
+      AnalyticalEngine engine;
+      engine.SetRange (m_oracleRange);
+      std::vector<Ipv4Address> addresses;
+      for (uint32_t i = 0; i < m_nodes.GetN (); ++i)
+        {
+          Ptr<Node> node = m_nodes.Get (i);
+          Ptr<MobilityModel> mobility = node->GetObject<MobilityModel> ();
+          NS_ABORT_MSG_UNLESS (mobility, "The oracle needs a MobilityModel on node " << node->GetId ());
+          Vector pos = mobility->GetPosition ();
+          engine.AddNode (pos.x, pos.y, m_protocols[i]->IsBeacon ());
+          addresses.push_back (node->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ());
+        }
+      engine.Run ();
+
+      m_mismatches = 0;
+      for (uint32_t i = 0; i < m_protocols.size (); ++i)
+        {
+          DistanceTable const &table = m_protocols[i]->GetDistanceTable ();
+          uint32_t reached = 0;
+          bool match = true;
+          for (uint32_t b = 0; b < engine.GetNBeacons (); ++b)
+            {
+              uint16_t hops = engine.GetHops (i, b);
+              reached += hops != 0 ? 1 : 0;
+              match = match && table.GetHopsTo (addresses[engine.GetBeaconNode (b)]) == hops;
+            }
+          if (!match || table.GetSize () != reached)
+            {
+              NS_LOG_DEBUG ("Table of node " << m_nodes.Get (i)->GetId () << " disagrees with the oracle");
+              ++m_mismatches;
+            }
+        }
+    }
+
+  }
+}
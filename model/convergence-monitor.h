@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef CONVERGENCEMONITOR_H
+#define CONVERGENCEMONITOR_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/node-container.h"
+#include "ns3/traced-callback.h"
+
+#include <vector>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    class RoutingProtocol;
+
+    /**
+     * @brief The ConvergenceMonitor class watches the DistanceTables of a set of nodes, through
+     *their TableUpdate trace sources, and declares the network converged once no table has
+     *changed for QuietIntervals checks in a row, CheckInterval apart. It then records the
+     *convergence time, the time of the last table change, and stops the simulation, so that
+     *a run lasts about as long as the protocol needs rather than a fixed horizon.
+     *
+     *The quiet period should cover a few HELLO intervals: a change is only propagated by the
+     *next HELLO of the node that made it. Nodes that are never reached by any beacon do not
+     *delay the convergence, and the monitor waits for a first table change before counting.
+     *
+     *With a positive OracleRange, the tables are checked at convergence against the hop
+     *counts of a breadth-first search over the unit disk of that range (AnalyticalEngine),
+     *which only holds when the radios reach exactly that far and every beacon is kept
+     *(MaxBeacons and MaxHopRadius 0).
+     */
+    class ConvergenceMonitor : public Object
+    {
+    public:
+      static TypeId GetTypeId (void);
+
+      /// Signature of the Converged trace source: the time of the last table change
+      typedef void (* ConvergedTracedCallback)(Time convergenceTime);
+
+      ConvergenceMonitor ();
+
+      /**
+       * @brief Install Follows the DV-Hop tables of these nodes, from now on, and starts checking
+       */
+      void Install (NodeContainer nodes);
+
+      bool     IsConverged () const             { return m_converged; }
+      /// Time of the last table change before the convergence was declared, zero until IsConverged
+      Time     GetConvergenceTime () const      { return m_convergenceTime; }
+      /// Time when the convergence was declared
+      Time     GetDetectionTime () const        { return m_detectionTime; }
+      /// Time of the last change in any table, which keeps moving after the convergence, zero for none
+      Time     GetLastChange () const           { return m_lastChange; }
+      /// Time of the last change in the table of the i-th installed node, zero for none
+      Time     GetLastChange (uint32_t i) const { return m_nodeLastChange.at (i); }
+      uint64_t GetNTableChanges () const        { return m_changes; }
+
+      /**
+       * @brief GetNOracleMismatches Nodes whose table disagrees with the oracle at convergence,
+       *zero as well when there is no oracle
+       */
+      uint32_t GetNOracleMismatches () const    { return m_mismatches; }
+
+    protected:
+      virtual void DoDispose (void);
+
+    private:
+      static void TableUpdated (ConvergenceMonitor *monitor, uint32_t node,
+                                Ipv4Address, uint16_t, uint16_t);
+      void Check (void);
+      void RunOracle (void);
+
+      Time     m_checkInterval;
+      uint32_t m_quietIntervals;
+      bool     m_stopOnConvergence;
+      double   m_oracleRange;
+
+      NodeContainer                   m_nodes;
+      std::vector<Ptr<RoutingProtocol> > m_protocols;
+      std::vector<Time>               m_nodeLastChange;
+      Time     m_lastChange;
+      uint64_t m_changes;
+      //Changes seen at the previous check, and checks since the last change
+      uint64_t m_checkedChanges;
+      uint32_t m_quiet;
+      bool     m_converged;
+      //Frozen when converged, later changes only move m_lastChange
+      Time     m_convergenceTime;
+      Time     m_detectionTime;
+      uint32_t m_mismatches;
+      EventId  m_checkEvent;
+
+      TracedCallback<Time> m_convergedTrace;
+    };
+
+  }
+}
+
+#endif // CONVERGENCEMONITOR_H
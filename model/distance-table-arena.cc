@@ -0,0 +1,55 @@
+#include "distance-table-arena.h"
+#include <limits>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    uint32_t
+    DistanceTableArena::Intern (Ipv4Address beacon)
+    {
+      std::unordered_map<uint32_t, uint32_t>::const_iterator it = m_indices.find (beacon.Get ());
+      if (it != m_indices.end ())
+        {
+          return it->second;
+        }
+
+      uint32_t index = m_addresses.size ();
+      m_addresses.push_back (beacon.Get ());
+      m_latest.push_back (std::numeric_limits<uint32_t>::max ());
+      m_indices[beacon.Get ()] = index;
+      return index;
+    }
+
+    uint32_t
+    DistanceTableArena::InternPosition (uint32_t index, Position pos)
+    {
+      uint32_t &latest = m_latest[index];
+      if (latest == std::numeric_limits<uint32_t>::max () || m_positions[latest] != pos)
+        {
+          latest = m_positions.size ();
+          m_positions.push_back (pos);
+        }
+      return latest;
+    }
+
+    int32_t
+    DistanceTableArena::Lookup (Ipv4Address beacon) const
+    {
+      std::unordered_map<uint32_t, uint32_t>::const_iterator it = m_indices.find (beacon.Get ());
+      return it != m_indices.end () ? (int32_t) it->second : -1;
+    }
+
+    size_t
+    DistanceTableArena::GetMemoryUsage () const
+    {
+      return m_addresses.capacity () * sizeof (uint32_t)
+             + m_latest.capacity () * sizeof (uint32_t)
+             + m_positions.capacity () * sizeof (Position)
+             + m_indices.bucket_count () * sizeof (void *)
+             + m_indices.size () * (sizeof (std::pair<const uint32_t, uint32_t>) + sizeof (void *));
+    }
+
+  }
+}
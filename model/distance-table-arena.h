@@ -0,0 +1,69 @@
+#ifndef DISTANCETABLEARENA_H
+#define DISTANCETABLEARENA_H
+
+#include <vector>
+#include <unordered_map>
+#include "ns3/simple-ref-count.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    typedef std::pair<double, double> Position;
+
+    /**
+     * @brief The DistanceTableArena class is a storage backend shared by the
+     *DistanceTables of a whole simulation. Beacon addresses are interned to dense
+     *indices, and their positions to records shared by every table that saw the
+     *same position. The tables keep only the state of their own entries, keyed by
+     *interned index and referring to a position record, so a node pays for the
+     *beacons it knows rather than for every beacon of the simulation.
+     */
+    class DistanceTableArena : public SimpleRefCount<DistanceTableArena>
+    {
+    public:
+      /**
+       * @brief Intern Gets the dense index of a beacon, assigning the next one the first time
+       * @param beacon The beacon address
+       * @return The index
+       */
+      uint32_t Intern(Ipv4Address beacon);
+
+      /**
+       * @brief Lookup
+       * @return The dense index of the beacon, or -1 if it was never interned
+       */
+      int32_t  Lookup(Ipv4Address beacon) const;
+
+      uint32_t    GetNBeacons() const               { return m_addresses.size (); }
+      Ipv4Address GetAddress(uint32_t index) const  { return Ipv4Address (m_addresses[index]); }
+
+      /**
+       * @brief InternPosition Gets a record holding a position of a beacon: its latest record
+       *if it holds that position, otherwise a new one, which becomes the latest. Records are
+       *never freed, so each move of a beacon costs one record for the whole simulation
+       * @param index The dense index of the beacon
+       * @param pos The position
+       * @return The record
+       */
+      uint32_t InternPosition(uint32_t index, Position pos);
+      Position GetPosition(uint32_t record) const  { return m_positions[record]; }
+
+      /**
+       * @brief GetMemoryUsage Bytes reserved by the arena: addresses, positions and the intern index
+       */
+      size_t   GetMemoryUsage() const;
+
+    private:
+      std::vector<uint32_t>                  m_addresses;   //Beacon address of each index
+      std::vector<uint32_t>                  m_latest;      //Latest position record of each index
+      std::vector<Position>                  m_positions;   //Position records
+      std::unordered_map<uint32_t, uint32_t> m_indices;     //Beacon address -> index
+    };
+
+  }
+}
+
+#endif // DISTANCETABLEARENA_H
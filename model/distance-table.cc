@@ -1,5 +1,6 @@
 #include "distance-table.h"
 #include "ns3/simulator.h"
+#include "ns3/assert.h"
 #include <algorithm>
 
 namespace ns3
@@ -8,17 +9,81 @@ namespace ns3
   {
 
 
-    DistanceTable::DistanceTable()
+    DistanceTable::DistanceTable() :
+      m_size (0),
+      m_generation (0),
+      m_maxEntries (0),
+      m_maxHops (0),
+      m_currentTick (0)
     {
     }
 
+    void
+    DistanceTable::UseArena (Ptr<DistanceTableArena> arena)
+    {
+      NS_ASSERT_MSG (m_size == 0 && !m_arena, "The arena must be set on an empty table, once");
+      m_arena = arena;
+    }
+
+    size_t
+    DistanceTable::GetMemoryUsage () const
+    {
+      size_t wheel = m_wheel.capacity () * sizeof (std::vector<WheelRecord>) + m_dueRecords.capacity () * sizeof (WheelRecord);
+      for (size_t i = 0; i < m_wheel.size (); ++i)
+        {
+          wheel += m_wheel[i].capacity () * sizeof (WheelRecord);
+        }
+      //A std::set node holds its value and three pointers and a colour, rounded up by the allocator
+      size_t index = m_byHops.size () * (sizeof (HopIndex::value_type) + 4 * sizeof (void *));
+      return sizeof (*this)
+             + m_keys.capacity () * sizeof (uint32_t)
+             + m_cells.capacity () * sizeof (BeaconCell)
+             + m_positions.capacity () * sizeof (Position)
+             + m_positionRecords.capacity () * sizeof (uint32_t)
+             + index + wheel;
+    }
+
+    BeaconInfo
+    DistanceTable::MakeInfo (BeaconCell const &cell, Position pos)
+    {
+      BeaconInfo info;
+      info.SetHops (cell.hops);
+      info.SetPosition (pos);
+      info.SetTime (Time::From (cell.updatedAt));
+      info.SetSeqNo (cell.seqNo);
+      info.SetGeneration (cell.generation);
+      return info;
+    }
+
+    int32_t
+    DistanceTable::Find (Ipv4Address beacon) const
+    {
+      uint32_t key = beacon.Get ();
+      if (m_arena)
+        {
+          int32_t index = m_arena->Lookup (beacon);
+          if (index < 0)
+            {
+              return -1;
+            }
+          key = index;
+        }
+
+      std::vector<uint32_t>::const_iterator it = std::lower_bound (m_keys.begin (), m_keys.end (), key);
+      if (it != m_keys.end () && *it == key)
+        {
+          return it - m_keys.begin ();
+        }
+      return -1;
+    }
+
     uint16_t
     DistanceTable::GetHopsTo (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      int32_t slot = Find (beacon);
+      if (slot >= 0)
         {
-          return ((BeaconInfo)it->second).GetHops ();
+          return m_cells[slot].hops;
         }
 
       else return 0;
@@ -27,51 +92,288 @@ namespace ns3
     Position
     DistanceTable::GetBeaconPosition (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      int32_t slot = Find (beacon);
+      if (slot >= 0)
         {
-          return ((BeaconInfo)it->second).GetPosition ();
+          return GetSlotPosition (slot);
         }
 
       else return std::make_pair<double,double>(-1.0,-1.0);
     }
 
 
+    uint16_t
+    DistanceTable::GetSequenceNumber (Ipv4Address beacon) const
+    {
+      int32_t slot = Find (beacon);
+      if (slot >= 0)
+        {
+          return m_cells[slot].seqNo;
+        }
+
+      else return 0;
+    }
+
+
+    bool
+    DistanceTable::AddBeacon (Ipv4Address beacon, uint16_t hops, double xPos, double yPos, uint16_t seqNo)
+    {
+      int32_t slot = Find (beacon);
+      if (m_maxHops != 0 && hops > m_maxHops)
+        {
+          //Beyond the hop radius
+          if (slot >= 0)
+            {
+              RemoveBeacon (beacon);
+            }
+          return false;
+        }
+
+      if (slot >= 0)
+        {
+          //Known beacon: its position is kept
+          BeaconCell &cell = m_cells[slot];
+          if (hops != cell.hops)
+            {
+              if (m_maxEntries != 0)
+                {
+                  m_byHops.erase (std::make_pair (cell.hops, beacon));
+                  m_byHops.insert (std::make_pair (hops, beacon));
+                }
+              cell.generation = ++m_generation;
+            }
+          cell.hops = hops;
+          cell.updatedAt = Simulator::Now ().GetTimeStep ();
+          cell.seqNo = seqNo;
+          return true;
+        }
+
+      if (m_maxEntries != 0 && m_size >= m_maxEntries)
+        {
+          //Full: the new beacon only gets in by evicting a farther one
+          HopIndex::iterator farthest = --m_byHops.end ();
+          if (!(std::make_pair (hops, beacon) < *farthest))
+            {
+              return false;
+            }
+          RemoveBeacon (farthest->second);
+        }
+
+      Position pos = std::make_pair (xPos, yPos);
+      uint32_t key = m_arena ? m_arena->Intern (beacon) : beacon.Get ();
+      std::vector<uint32_t>::iterator it = std::lower_bound (m_keys.begin (), m_keys.end (), key);
+      slot = it - m_keys.begin ();
+      m_keys.insert (it, key);
+      m_cells.insert (m_cells.begin () + slot, BeaconCell ());
+      if (m_arena)
+        {
+          m_positionRecords.insert (m_positionRecords.begin () + slot, m_arena->InternPosition (key, pos));
+        }
+      else
+        {
+          m_positions.insert (m_positions.begin () + slot, pos);
+        }
+
+      BeaconCell &cell = m_cells[slot];
+      cell.hops = hops;
+      cell.updatedAt = Simulator::Now ().GetTimeStep ();
+      cell.seqNo = seqNo;
+      cell.generation = ++m_generation;
+      m_size++;
+      if (m_maxEntries != 0)
+        {
+          m_byHops.insert (std::make_pair (hops, beacon));
+        }
+      if (!m_wheel.empty ())
+        {
+          ScheduleExpiry (slot);
+        }
+      return true;
+    }
+
+
     void
-    DistanceTable::AddBeacon (Ipv4Address beacon, uint16_t hops, double xPos, double yPos)
+    DistanceTable::RemoveBeacon (Ipv4Address beacon)
     {
-      std::map<Ipv4Address, BeaconInfo>::iterator it = m_table.find (beacon);
-      BeaconInfo info;
-      if( it != m_table.end ())
+      int32_t slot = Find (beacon);
+      NS_ASSERT (slot >= 0);
+      uint16_t hops = m_cells[slot].hops;
+      Position pos = GetSlotPosition (slot);
+      if (m_maxEntries != 0)
+        {
+          m_byHops.erase (std::make_pair (m_cells[slot].hops, beacon));
+        }
+      if (m_arena)
+        {
+          m_positionRecords.erase (m_positionRecords.begin () + slot);
+        }
+      else
+        {
+          m_positions.erase (m_positions.begin () + slot);
+        }
+      m_keys.erase (m_keys.begin () + slot);
+      m_cells.erase (m_cells.begin () + slot);
+      m_size--;
+      if (!m_removed.IsNull ())
+        {
+          m_removed (beacon, hops, pos);
+        }
+    }
+
+
+    void
+    DistanceTable::SetHorizon (uint32_t maxEntries, uint16_t maxHops)
+    {
+      m_maxEntries = maxEntries;
+      m_maxHops = maxHops;
+
+      //The hop index is only needed to find the farthest entry of a full table
+      m_byHops.clear ();
+      std::vector<Ipv4Address> outside;
+      for (uint32_t i = 0; i < m_size; ++i)
         {
-          info.SetPosition (it->second.GetPosition ());
-          info.SetHops (hops);
-          info.SetTime (Simulator::Now ());
-          it->second = info;
+          BeaconCell const &cell = m_cells[i];
+          if (m_maxHops != 0 && cell.hops > m_maxHops)
+            {
+              outside.push_back (GetSlotAddress (i));
+            }
+          else if (m_maxEntries != 0)
+            {
+              m_byHops.insert (std::make_pair (cell.hops, GetSlotAddress (i)));
+            }
+        }
+      for (std::vector<Ipv4Address>::const_iterator it = outside.begin (); it != outside.end (); ++it)
+        {
+          RemoveBeacon (*it);
+        }
+
+      while (m_maxEntries != 0 && m_size > m_maxEntries)
+        {
+          RemoveBeacon ((--m_byHops.end ())->second);
+        }
+    }
+
+
+    void
+    DistanceTable::SetLifetime (Time lifetime)
+    {
+      m_lifetime = lifetime;
+      m_wheel.clear ();
+      if (!lifetime.IsStrictlyPositive ())
+        {
+          m_tick = Time ();
+          return;
+        }
+
+      m_tick = Time::From (std::max<int64_t> (1, lifetime.GetTimeStep () / TICKS_PER_LIFETIME));
+      m_currentTick = Simulator::Now ().GetTimeStep () / m_tick.GetTimeStep ();
+      m_wheel.resize (WHEEL_SLOTS);
+      for (uint32_t i = 0; i < m_size; ++i)
+        {
+          ScheduleExpiry (i);
+        }
+    }
+
+
+    void
+    DistanceTable::ScheduleExpiry (uint32_t slot)
+    {
+      //First tick at or after the expiry time, rounded up so the entry is due when checked
+      BeaconCell &cell = m_cells[slot];
+      int64_t expiresAt = cell.updatedAt + m_lifetime.GetTimeStep ();
+      uint64_t tick = (expiresAt + m_tick.GetTimeStep () - 1) / m_tick.GetTimeStep ();
+      tick = std::max (tick, m_currentTick + 1);
+
+      cell.expiryTick = tick;
+      WheelRecord record = { GetSlotAddress (slot).Get (), tick };
+      m_wheel[tick % WHEEL_SLOTS].push_back (record);
+    }
+
+
+    uint32_t
+    DistanceTable::Expire (Time now)
+    {
+      if (m_wheel.empty ())
+        {
+          return 0;
+        }
+
+      uint32_t expired = 0;
+      uint64_t target = now.GetTimeStep () / m_tick.GetTimeStep ();
+      while (m_currentTick < target)
+        {
+          m_currentTick++;
+          std::vector<WheelRecord> &wheelSlot = m_wheel[m_currentTick % WHEEL_SLOTS];
+          m_dueRecords.clear ();
+          m_dueRecords.swap (wheelSlot);
+          for (std::vector<WheelRecord>::const_iterator r = m_dueRecords.begin (); r != m_dueRecords.end (); ++r)
+            {
+              if (r->tick != m_currentTick)
+                {
+                  wheelSlot.push_back (*r);    //Due in a later turn of the wheel
+                  continue;
+                }
+              int32_t slot = Find (Ipv4Address (r->beacon));
+              if (slot < 0 || m_cells[slot].expiryTick != r->tick)
+                {
+                  continue;                    //Removed, or re-added and scheduled again
+                }
+              if (m_cells[slot].updatedAt + m_lifetime.GetTimeStep () <= now.GetTimeStep ())
+                {
+                  RemoveBeacon (Ipv4Address (r->beacon));
+                  expired++;
+                }
+              else
+                {
+                  ScheduleExpiry (slot);       //Refreshed since it was scheduled
+                }
+            }
+        }
+      return expired;
+    }
+
+
+    void
+    DistanceTable::RefreshBeacon (Ipv4Address beacon, uint16_t seqNo)
+    {
+      int32_t slot = Find (beacon);
+      if (slot >= 0)
+        {
+          m_cells[slot].seqNo = seqNo;
+          m_cells[slot].updatedAt = Simulator::Now ().GetTimeStep ();
+        }
+    }
+
+
+    bool
+    DistanceTable::MoveBeacon (Ipv4Address beacon, double xPos, double yPos)
+    {
+      int32_t slot = Find (beacon);
+      Position pos = std::make_pair (xPos, yPos);
+      if (slot < 0 || GetSlotPosition (slot) == pos)
+        {
+          return false;
+        }
+      if (m_arena)
+        {
+          m_positionRecords[slot] = m_arena->InternPosition (m_keys[slot], pos);
         }
       else
         {
-	  Position temp;
-	  temp.first = xPos;
-  	  temp.second = yPos;
-          info.SetHops (hops);
-          info.SetPosition (temp);
-          info.SetTime (Simulator::Now ());
-	  std::pair<Ipv4Address, BeaconInfo> temp2;
-	  temp2.first = beacon;
-	  temp2.second = info;
-          m_table.insert (temp2);
+          m_positions[slot] = pos;
         }
+      m_cells[slot].generation = ++m_generation;
+      return true;
     }
 
 
     Time
     DistanceTable::LastUpdatedAt (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      int32_t slot = Find (beacon);
+      if (slot >= 0)
         {
-          return ((BeaconInfo)it->second).GetTime ();
+          return Time::From (m_cells[slot].updatedAt);
         }
 
       else return Time::Max ();
@@ -81,9 +383,55 @@ namespace ns3
     DistanceTable::GetKnownBeacons() const
     {
       std::vector<Ipv4Address> theBeacons;
-      for(std::map<Ipv4Address, BeaconInfo>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+      theBeacons.reserve (m_size);
+      for (uint32_t i = 0; i < m_size; ++i)
+        {
+          theBeacons.push_back (GetSlotAddress (i));
+        }
+      return theBeacons;
+    }
+
+    std::vector<Ipv4Address>
+    DistanceTable::GetNearestBeacons (uint32_t k) const
+    {
+      std::vector<Ipv4Address> theBeacons;
+      if (m_maxEntries != 0)
         {
-          theBeacons.push_back (j->first);
+          theBeacons.reserve (std::min<size_t> (k, m_byHops.size ()));
+          for (HopIndex::const_iterator j = m_byHops.begin (); j != m_byHops.end () && theBeacons.size () < k; ++j)
+            {
+              theBeacons.push_back (j->second);
+            }
+          return theBeacons;
+        }
+
+      //No index: order only the k nearest entries
+      std::vector<std::pair<uint16_t, Ipv4Address> > entries;
+      entries.reserve (m_size);
+      for (uint32_t i = 0; i < m_size; ++i)
+        {
+          entries.push_back (std::make_pair (m_cells[i].hops, GetSlotAddress (i)));
+        }
+      k = std::min<size_t> (k, entries.size ());
+      std::partial_sort (entries.begin (), entries.begin () + k, entries.end ());
+      theBeacons.reserve (k);
+      for (uint32_t j = 0; j < k; ++j)
+        {
+          theBeacons.push_back (entries[j].second);
+        }
+      return theBeacons;
+    }
+
+    std::vector<Ipv4Address>
+    DistanceTable::GetChangedBeacons (uint32_t since) const
+    {
+      std::vector<Ipv4Address> theBeacons;
+      for (uint32_t i = 0; i < m_size; ++i)
+        {
+          if (m_cells[i].generation > since)
+            {
+              theBeacons.push_back (GetSlotAddress (i));
+            }
         }
       return theBeacons;
     }
@@ -91,12 +439,13 @@ namespace ns3
     void
     DistanceTable::Print (Ptr<OutputStreamWrapper> os) const
     {
-      *os->GetStream () << m_table.size () << " entries\n";
-      for(std::map<Ipv4Address,BeaconInfo>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+      std::ostream &stream = *os->GetStream ();
+      stream << m_size << " entries\n";
+      ForEach ([&stream] (Ipv4Address beacon, BeaconInfo const &info)
         {
-          //                    BeaconAddr           BeaconInfo
-          *os->GetStream () <<  j->first << "\t" << j->second;
-        }
+          //        BeaconAddr         BeaconInfo
+          stream << beacon << "\t" << info;
+        });
     }
 
 
@@ -110,5 +459,3 @@ namespace ns3
 
   }
 }
-
-
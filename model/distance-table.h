@@ -1,11 +1,13 @@
 #ifndef DISTANCETABLE_H
 #define DISTANCETABLE_H
 
-#include <map>
+#include <set>
 #include <vector>
 #include "ns3/ipv4.h"
 #include "ns3/nstime.h"
 #include "ns3/output-stream-wrapper.h"
+#include "ns3/callback.h"
+#include "distance-table-arena.h"
 
 namespace ns3
 {
@@ -13,23 +15,43 @@ namespace ns3
   {
 
 
-    typedef std::pair<double, double> Position;
+    /**
+     * @brief The BeaconCell struct is the state a DistanceTable keeps for one beacon entry,
+     *everything but the beacon address and position
+     */
+    struct BeaconCell
+    {
+      int64_t  updatedAt;    //!< Time step of the last update
+      uint64_t expiryTick;   //!< Timer wheel tick at which the entry is checked next
+      uint32_t generation;   //!< Table generation of the last change of hops or position
+      uint16_t hops;
+      uint16_t seqNo;
+    };
 
+    /**
+     * @brief The BeaconInfo class is the information a DistanceTable keeps about one beacon
+     */
     class BeaconInfo
     {
     public:
       uint16_t  GetHops()     const   { return m_hops;     }
       Position  GetPosition() const   { return m_pos;      }
       Time      GetTime()     const   { return m_updatedAt;}
+      uint16_t  GetSeqNo()    const   { return m_seqNo;    }
+      uint32_t  GetGeneration() const { return m_generation; }
 
       void SetHops    (uint16_t hops) { m_hops = hops;  }
       void SetPosition(Position p)    { m_pos  = p;     }
       void SetTime    ( Time t )      { m_updatedAt = t;}
+      void SetSeqNo   (uint16_t sn)   { m_seqNo = sn;   }
+      void SetGeneration (uint32_t g) { m_generation = g; }
 
     private:
       uint16_t m_hops;
       Position m_pos;
       Time     m_updatedAt;
+      uint16_t m_seqNo;
+      uint32_t m_generation;   //Table generation of the last change of hops or position
     };
 
     std::ostream & operator<< (std::ostream & os, BeaconInfo const &);
@@ -40,6 +62,16 @@ namespace ns3
     /**
      * @brief The DistanceTable class stores local
      *information about the beacons known to the node.
+     *
+     *Entries live in flat arrays sorted by the 32-bit beacon address, so lookups
+     *are a binary search over contiguous keys and ForEach walks the table in
+     *address order without allocating.
+     *
+     *With UseArena the beacon addresses and positions are interned in a
+     *DistanceTableArena shared by every table of the simulation. The table then
+     *keys its entries by the sorted interned indices instead of the addresses,
+     *and refers to the position records of the arena instead of holding the
+     *positions: 32 bytes per entry rather than 44.
      */
     class DistanceTable
     {
@@ -50,7 +82,33 @@ namespace ns3
        * @brief GetSize The number of entries stored in this table
        * @return The size
        */
-      size_t  GetSize() const  { return m_table.size (); }
+      size_t  GetSize() const  { return m_size; }
+
+      /**
+       * @brief UseArena Interns the beacons of this table in a shared arena.
+       *It must be called while the table is empty
+       * @param arena The arena
+       */
+      void UseArena(Ptr<DistanceTableArena> arena);
+
+      /**
+       * @brief GetMemoryUsage Bytes reserved by this table, not counting a shared arena
+       */
+      size_t GetMemoryUsage() const;
+
+      /**
+       * @brief ForEach Calls visitor (Ipv4Address beacon, BeaconInfo const &info) for every
+       *entry, in address order (in interning order with an arena). The table must not
+       *be modified from the visitor
+       */
+      template <typename Visitor>
+      void ForEach(Visitor visitor) const
+      {
+        for (uint32_t slot = 0; slot < m_size; ++slot)
+          {
+            visitor (GetSlotAddress (slot), MakeInfo (m_cells[slot], GetSlotPosition (slot)));
+          }
+      }
 
 
       /**
@@ -67,6 +125,13 @@ namespace ns3
        */
       Position    GetBeaconPosition(Ipv4Address beacon) const;
 
+      /**
+       * @brief GetSequenceNumber Gets the latest sequence number originated by a certain beacon
+       * @param beacon The beacon address
+       * @return The sequence number, or 0 if there is no such information
+       */
+      uint16_t    GetSequenceNumber(Ipv4Address beacon) const;
+
       /**
        * @brief LastUpdatedAt Gets the time in which the information for the beacon was updated for the last time
        * @param beacon The address of the beacon
@@ -80,6 +145,64 @@ namespace ns3
        */
       std::vector<Ipv4Address> GetKnownBeacons() const;
 
+      /**
+       * @brief GetNearestBeacons Walks the hop index kept under a MaxEntries horizon, and
+       *otherwise selects the k nearest with a partial sort, without sorting the whole table
+       * @param k Maximum number of beacons to return
+       * @return The k beacons with the lowest hop count, nearest first
+       */
+      std::vector<Ipv4Address> GetNearestBeacons(uint32_t k) const;
+
+      /**
+       * @brief SetHorizon Bounds the table to the beacons nearest to the node. Entries
+       *falling out of the horizon are evicted right away
+       * @param maxEntries Keep at most this many beacons, the ones with the lowest hop count. 0 means no limit
+       * @param maxHops Keep only the beacons at most this many hops away. 0 means no limit
+       */
+      void SetHorizon(uint32_t maxEntries, uint16_t maxHops);
+
+      /**
+       * @brief SetLifetime Entries not added or refreshed for this long are removed by Expire.
+       *They are tracked by a hashed timer wheel whose tick is a fraction of the lifetime
+       * @param lifetime The lifetime, zero keeps the entries forever
+       */
+      void SetLifetime(Time lifetime);
+      Time GetLifetime() const     { return m_lifetime; }
+
+      /**
+       * @brief GetExpiryTick The period at which Expire should be called
+       */
+      Time GetExpiryTick() const   { return m_tick; }
+
+      /**
+       * @brief Expire Advances the timer wheel up to now and removes the expired entries.
+       *An entry refreshed since it was scheduled is only moved to the slot of its new expiry
+       * @param now The current time
+       * @return The number of removed entries
+       */
+      uint32_t Expire(Time now);
+
+      /**
+       * @brief SetRemovalCallback Sets the callback invoked with (beacon, hops, position) every
+       *time an entry leaves the table: evicted by the horizon, or expired. The entry is
+       *already gone when it runs
+       */
+      void SetRemovalCallback(Callback<void, Ipv4Address, uint16_t, Position> cb) { m_removed = cb; }
+
+      /**
+       * @brief GetGeneration The change counter of the table, it grows every time
+       *the hops or the position of an entry change
+       * @return The current generation
+       */
+      uint32_t GetGeneration() const   { return m_generation; }
+
+      /**
+       * @brief GetChangedBeacons
+       * @param since A generation previously returned by GetGeneration
+       * @return A vector containing the beacons whose hops or position changed after that generation
+       */
+      std::vector<Ipv4Address> GetChangedBeacons(uint32_t since) const;
+
       /**
        * @brief Print Print this DistanceTable to the output stream provided
        * @param os The stream
@@ -92,10 +215,79 @@ namespace ns3
        * @param hops Hops to the beacon
        * @param xPos X coordinate
        * @param yPos Y coordinate
+       * @param seqNo Sequence number of the advertisement, as originated by the beacon
+       * @return false if the beacon falls out of the horizon, and so it is not in the table
+       */
+      bool AddBeacon(Ipv4Address beacon, uint16_t hops, double xPos, double yPos, uint16_t seqNo = 0);
+
+      /**
+       * @brief RefreshBeacon Records a newer advertisement of a known beacon that did not change its hops
+       * @param beacon The beacon address
+       * @param seqNo Sequence number of the advertisement
+       */
+      void RefreshBeacon(Ipv4Address beacon, uint16_t seqNo);
+
+      /**
+       * @brief MoveBeacon Records a new position advertised by a known beacon
+       * @param beacon The beacon address
+       * @param xPos X coordinate
+       * @param yPos Y coordinate
+       * @return true if the position of the entry changed
        */
-      void AddBeacon(Ipv4Address beacon, uint16_t hops, double xPos, double yPos);
+      bool MoveBeacon(Ipv4Address beacon, double xPos, double yPos);
     private:
-      std::map<Ipv4Address, BeaconInfo>  m_table;
+      typedef std::set<std::pair<uint16_t, Ipv4Address> > HopIndex;
+
+      void RemoveBeacon(Ipv4Address beacon);
+
+      /**
+       * @brief Find Gets the slot of a beacon: its index in the arrays of the table, found
+       *by binary search over the addresses, or over the interned indices with an arena
+       * @return The slot, or -1 if the beacon is not in the table
+       */
+      int32_t Find(Ipv4Address beacon) const;
+
+      //Slot accessors, the only code aware of the two key layouts
+      //{
+      Ipv4Address        GetSlotAddress(uint32_t slot) const
+      { return m_arena ? m_arena->GetAddress (m_keys[slot]) : Ipv4Address (m_keys[slot]); }
+      Position           GetSlotPosition(uint32_t slot) const
+      { return m_arena ? m_arena->GetPosition (m_positionRecords[slot]) : m_positions[slot]; }
+      //}
+
+      static BeaconInfo MakeInfo(BeaconCell const &cell, Position pos);
+
+      /**
+       * @brief ScheduleExpiry Puts the entry in the wheel slot of its expiry
+       */
+      void ScheduleExpiry(uint32_t slot);
+
+      /// Timer wheel geometry: ticks per lifetime, and slots (a power of two)
+      static const uint32_t TICKS_PER_LIFETIME = 16;
+      static const uint32_t WHEEL_SLOTS = 32;
+
+      struct WheelRecord
+      {
+        uint32_t beacon;
+        uint64_t tick;
+      };
+
+      std::vector<uint32_t>              m_keys;         //Sorted beacon addresses, or interned indices with an arena
+      std::vector<BeaconCell>            m_cells;        //Parallel to m_keys
+      std::vector<Position>              m_positions;    //Parallel to m_keys, without an arena
+      std::vector<uint32_t>              m_positionRecords; //Parallel to m_keys, the position records of the arena
+      Ptr<DistanceTableArena>            m_arena;
+      size_t                             m_size;
+      uint32_t                           m_generation;
+      HopIndex                           m_byHops;       //(hops, beacon) of every entry, only under a MaxEntries horizon
+      uint32_t                           m_maxEntries;
+      uint16_t                           m_maxHops;
+      Time                               m_lifetime;
+      Time                               m_tick;
+      uint64_t                           m_currentTick;  //Last wheel tick processed
+      std::vector<std::vector<WheelRecord> > m_wheel;
+      std::vector<WheelRecord>           m_dueRecords;   //Scratch buffer of Expire
+      Callback<void, Ipv4Address, uint16_t, Position> m_removed;
     };
 
 
@@ -0,0 +1,50 @@
+#include "duplicate-cache.h"
+#include "dvhop-packet.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    DuplicateCache::DuplicateCache()
+    {
+      Clear ();
+    }
+
+    bool
+    DuplicateCache::IsFresh (Ipv4Address beacon, uint16_t seqNo, uint16_t hops)
+    {
+      //Multiplicative hashing, the top bits pick one of the SIZE slots
+      uint32_t address = beacon.Get ();
+      Slot &slot = m_slots[(address * 2654435761u) >> (32 - SIZE_BITS)];
+
+      if (slot.valid && slot.beacon == address)
+        {
+          if (SeqNoIsNewer (slot.seqNo, seqNo))
+            {
+              return false;   //Older advertisement
+            }
+          if (slot.seqNo == seqNo && hops >= slot.hops)
+            {
+              return false;   //Same advertisement through a path that is not shorter
+            }
+        }
+
+      slot.beacon = address;
+      slot.seqNo  = seqNo;
+      slot.hops   = hops;
+      slot.valid  = true;
+      return true;
+    }
+
+    void
+    DuplicateCache::Clear ()
+    {
+      for (uint32_t i = 0; i < SIZE; ++i)
+        {
+          m_slots[i].valid = false;
+        }
+    }
+
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef DUPLICATECACHE_H
+#define DUPLICATECACHE_H
+
+#include "ns3/ipv4-address.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /**
+     * @brief The DuplicateCache class remembers the freshest (beacon, sequence number)
+     *pair seen by the node in a small fixed-size table, so repeated or stale
+     *advertisements can be dropped before touching the DistanceTable.
+     *
+     *Beacons are hashed to a slot, and a colliding beacon simply takes the slot
+     *over: a forgotten beacon lets one stale advertisement through, which the
+     *DistanceTable then ignores.
+     */
+    class DuplicateCache
+    {
+    public:
+      DuplicateCache();
+
+      /**
+       * @brief IsFresh Checks an advertisement against the cache, and remembers it when it is fresh
+       * @param beacon The beacon address
+       * @param seqNo Sequence number originated by the beacon
+       * @param hops Hop count carried by the advertisement
+       * @return true if the advertisement is newer than the last one seen for the beacon,
+       *or it has the same sequence number but fewer hops
+       */
+      bool IsFresh(Ipv4Address beacon, uint16_t seqNo, uint16_t hops);
+
+      /**
+       * @brief Clear Forgets every advertisement
+       */
+      void Clear();
+
+      /// Number of slots of the cache, a power of two
+      static const uint32_t SIZE_BITS = 6;
+      static const uint32_t SIZE = 1 << SIZE_BITS;
+
+    private:
+      struct Slot
+      {
+        uint32_t beacon;
+        uint16_t seqNo;
+        uint16_t hops;
+        bool     valid;
+      };
+
+      Slot m_slots[SIZE];
+    };
+
+  }
+}
+
+#endif // DUPLICATECACHE_H
@@ -0,0 +1,142 @@
+#include "dvhop-localization.h"
+
+#include <cmath>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    namespace
+    {
+      //Gauss-Newton terms of the range residuals at one position
+      template <typename Real>
+      struct RangeSystem
+      {
+        Real cost;                   //Sum of the squared residuals
+        Real jxx, jxy, jyy;          //J'J
+        Real gx, gy;                 //J'e
+      };
+
+      template <typename Real>
+      RangeSystem<Real>
+      EvaluateRanges(DistanceTable const &table, Real hopSize, Real x, Real y)
+      {
+        RangeSystem<Real> sys = { 0, 0, 0, 0, 0, 0 };
+        table.ForEach ([&sys, hopSize, x, y] (Ipv4Address, BeaconInfo const &info)
+          {
+            Real dx = x - static_cast<Real> (info.GetPosition ().first);
+            Real dy = y - static_cast<Real> (info.GetPosition ().second);
+            Real d = std::sqrt (dx * dx + dy * dy);
+            Real e = d - info.GetHops () * hopSize;
+            sys.cost += e * e;
+            if (d > 0)
+              {
+                //Gradient of the distance, the unit vector from the beacon
+                Real ux = dx / d;
+                Real uy = dy / d;
+                sys.jxx += ux * ux;
+                sys.jxy += ux * uy;
+                sys.jyy += uy * uy;
+                sys.gx += ux * e;
+                sys.gy += uy * e;
+              }
+          });
+        return sys;
+      }
+    }
+
+    template <typename Precision>
+    bool
+    BasicLocalization<Precision>::Solve(Terms const &terms, double hopSize, double &x, double &y)
+    {
+      if (terms.nBeacons < 3)
+        {
+          return false;
+        }
+
+      //Row of beacon i, centred: 2 (dxi - mean dx) u + 2 (dyi - mean dy) v = ci - mean c,
+      //with ci = qi - (hi s)^2 and (u, v) the position relative to the origin
+      Real n   = terms.nBeacons;
+      Real s2  = static_cast<Real> (hopSize) * static_cast<Real> (hopSize);
+      Real sx  = Precision::ToReal (terms.sx, 1);
+      Real sy  = Precision::ToReal (terms.sy, 1);
+      Real cxx = Precision::ToReal (terms.sxx, 2) - sx * sx / n;
+      Real cyy = Precision::ToReal (terms.syy, 2) - sy * sy / n;
+      Real cxy = Precision::ToReal (terms.sxy, 2) - sx * sy / n;
+      Real sc  = Precision::ToReal (terms.sq, 2) - s2 * Precision::ToReal (terms.sh, 2);
+      Real cxc = (Precision::ToReal (terms.sxq, 3) - s2 * Precision::ToReal (terms.sxh, 3)) - sx * sc / n;
+      Real cyc = (Precision::ToReal (terms.syq, 3) - s2 * Precision::ToReal (terms.syh, 3)) - sy * sc / n;
+
+      Real det = cxx * cyy - cxy * cxy;
+      Real trace = cxx + cyy;
+      if (trace <= 0 || det <= static_cast<Real> (COLLINEAR_RATIO) * trace * trace)
+        {
+          return false;
+        }
+      //2 C [u v]' = [cxc cyc]'
+      x = terms.originX + (cyy * cxc - cxy * cyc) / (2 * det);
+      y = terms.originY + (cxx * cyc - cxy * cxc) / (2 * det);
+      return true;
+    }
+
+    template <typename Precision>
+    Refinement
+    BasicLocalization<Precision>::Refine(DistanceTable const &table, double hopSize, uint32_t maxIterations, double tolerance,
+                                         double &x, double &y)
+    {
+      Real px = x;
+      Real py = y;
+      Real lambda = 1e-3;
+      Refinement result = { 0, Refinement::MAX_ITERATIONS, 0 };
+      RangeSystem<Real> sys = EvaluateRanges<Real> (table, hopSize, px, py);
+      while (result.iterations < maxIterations)
+        {
+          //(J'J + lambda diag (J'J)) step = -J'e
+          Real axx = sys.jxx * (1 + lambda);
+          Real ayy = sys.jyy * (1 + lambda);
+          Real det = axx * ayy - sys.jxy * sys.jxy;
+          if (det <= 0)
+            {
+              result.exit = Refinement::SINGULAR;
+              break;
+            }
+          result.iterations++;
+          Real sx = -(ayy * sys.gx - sys.jxy * sys.gy) / det;
+          Real sy = -(axx * sys.gy - sys.jxy * sys.gx) / det;
+
+          RangeSystem<Real> next = EvaluateRanges<Real> (table, hopSize, px + sx, py + sy);
+          if (next.cost < sys.cost)
+            {
+              //Better: take the step, and trust the Gauss-Newton model more
+              px += sx;
+              py += sy;
+              sys = next;
+              lambda *= Real (0.1);
+              result.exit = Refinement::MAX_ITERATIONS;
+              //Only a step actually taken says the position has settled
+              if (std::sqrt (sx * sx + sy * sy) < tolerance)
+                {
+                  result.exit = Refinement::CONVERGED;
+                  break;
+                }
+            }
+          else
+            {
+              //Worse: stay, and damp the next step more
+              lambda *= 10;
+              result.exit = Refinement::REJECTED;
+            }
+        }
+      x = px;
+      y = py;
+      result.cost = sys.cost;
+      return result;
+    }
+
+    template class BasicLocalization<DoublePrecision>;
+    template class BasicLocalization<FloatPrecision>;
+    template class BasicLocalization<FixedPrecision>;
+
+  }
+}
@@ -0,0 +1,395 @@
+#ifndef DVHOPLOCALIZATION_H
+#define DVHOPLOCALIZATION_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+
+#include "distance-table.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /**
+     * @brief Numeric policies of BasicLocalization. Each one gives:
+     *- Value: the coordinates, relative to the origin, and the hops
+     *- Sum: the sums of products of up to three values
+     *- Real: the arithmetic of the O(1) solve
+     *with the conversions between them. Sums of products of different orders may carry
+     *different scales, which ToReal takes away.
+     */
+    //{
+    /// IEEE double everywhere
+    struct DoublePrecision
+    {
+      typedef double Value;
+      typedef double Sum;
+      typedef double Real;
+      static Value FromDouble(double v)        { return v; }
+      static Sum   Widen(Value a)              { return a; }
+      static Sum   Mul2(Value a, Value b)      { return a * b; }
+      static Sum   Mul3(Value a, Sum bc)       { return a * bc; }
+      static Real  ToReal(Sum s, int order)    { return s; }
+      static bool  InRange(double extent, double hops, uint32_t n) { return true; }
+    };
+
+    /// IEEE float everywhere, solve included
+    struct FloatPrecision
+    {
+      typedef float Value;
+      typedef float Sum;
+      typedef float Real;
+      static Value FromDouble(double v)        { return static_cast<float> (v); }
+      static Sum   Widen(Value a)              { return a; }
+      static Sum   Mul2(Value a, Value b)      { return a * b; }
+      static Sum   Mul3(Value a, Sum bc)       { return a * bc; }
+      static Real  ToReal(Sum s, int order)    { return s; }
+      static bool  InRange(double extent, double hops, uint32_t n) { return true; }
+    };
+
+    /**
+     * Fixed point for targets without an FPU: values are int32 with FRACTION_BITS
+     *fractional bits (1/16 m), the sums exact int64. Only the O(1) solve, and the
+     *refinement, run in double.
+     *
+     *The largest sums are those of dx (dx^2 + dy^2) and dx h^2, at 1/16^3. With n beacons
+     *at most E m from the first one along each axis, and h hops at most, they stay below
+     *2^63 while n 2 (16 E)^3 and n (16 E) (16 h)^2 do: E < 104 km / cbrt (n), that is 48 km
+     *for 10 beacons and 22 km for 100. Beyond, the system stops summing and Solve fails
+     *until it is rebuilt from beacons that fit.
+     */
+    struct FixedPrecision
+    {
+      static const int FRACTION_BITS = 4;
+      typedef int32_t Value;
+      typedef int64_t Sum;
+      typedef double  Real;
+      static Value FromDouble(double v)        { return static_cast<Value> (std::floor (v * (1 << FRACTION_BITS) + 0.5)); }
+      static Sum   Widen(Value a)              { return a; }
+      static Sum   Mul2(Value a, Value b)      { return static_cast<Sum> (a) * b; }
+      static Sum   Mul3(Value a, Sum bc)       { return a * bc; }
+      static Real  ToReal(Sum s, int order)    { return std::ldexp (static_cast<double> (s), -FRACTION_BITS * order); }
+      //Whether n beacons within extent m of the origin along each axis, at most hops away, fit the sums
+      static bool  InRange(double extent, double hops, uint32_t n)
+      {
+        double e = std::ldexp (extent, FRACTION_BITS) + 1;
+        double h = std::ldexp (hops, FRACTION_BITS) + 1;
+        return n * e * std::max (2 * e * e, h * h) < std::ldexp (1.0, 63);
+      }
+    };
+    //}
+
+    //Below this ratio between the determinant and the squared trace of the normal
+    //matrix, the beacons are taken as collinear
+    static const double COLLINEAR_RATIO = 1e-9;
+
+    /**
+     * @brief The BasicLocalization class estimates the position of a node from the positions
+     *of N >= 3 beacons and their distances in hops, scaled by the hop size.
+     *
+     *Each circle (x - xi)^2 + (y - yi)^2 = (hi s)^2 is linear in x, y and x^2 + y^2;
+     *eliminating the last unknown centres the rows on the mean beacon, and leaves a 2x2
+     *least-squares system. Its normal equations are kept as sums over the beacons, with
+     *the hop size factored out, so that:
+     *- adding or removing one beacon is a rank-one update, O(1)
+     *- a new hop size needs no update at all
+     *- Solve is O(1), whatever the number of beacons
+     *
+     *The sums are taken relative to an origin set by the first beacon after a Reset, to
+     *keep the cancellations small; the owner should still rebuild them from scratch
+     *every now and then to bound the drift of the removals.
+     *
+     *The arithmetic comes from the Precision policy, which must also accept the extent of
+     *the beacons (InRange), or the system has no solution until the next Reset; the
+     *estimator itself is the same for every policy. The updates
+     *are defined here to be inlined; the three policies above are instantiated once, in
+     *dvhop-localization.cc.
+     */
+    /**
+     * @brief The Refinement struct is the outcome of BasicLocalization::Refine
+     */
+    struct Refinement
+    {
+      /// Why the refinement stopped
+      enum Exit
+      {
+        CONVERGED,          //An accepted step shorter than the tolerance
+        REJECTED,           //Out of iterations on a rejected step: no lower cost found nearby
+        MAX_ITERATIONS,     //Out of iterations on an accepted step, still improving
+        SINGULAR            //The damped normal equations have no solution
+      };
+      uint32_t iterations;
+      Exit     exit;
+      double   cost;        //Sum of the squared range errors at the refined position
+    };
+
+    template <typename Precision>
+    class BasicLocalization
+    {
+    public:
+      typedef typename Precision::Value Value;
+      typedef typename Precision::Sum   Sum;
+      typedef typename Precision::Real  Real;
+
+      /**
+       * @brief The Terms struct is the whole state of the system: the beacon count, the
+       *origin, and the sums over the beacons relative to it
+       */
+      struct Terms
+      {
+        uint32_t nBeacons;
+        double   originX;
+        double   originY;
+        //Sums of dx, dy, dx^2, dy^2, dx dy, and of q = dx^2 + dy^2 and h^2 weighted by 1, dx and dy
+        Sum      sx, sy, sxx, syy, sxy;
+        Sum      sq, sxq, syq;
+        Sum      sh, sxh, syh;
+      };
+
+      BasicLocalization() { Reset (); }
+
+      /**
+       * @brief Reset Forgets every beacon, to start a new estimate
+       */
+      void Reset()
+      {
+        m_terms.nBeacons = 0;
+        m_terms.originX = m_terms.originY = 0;
+        m_terms.sx = m_terms.sy = m_terms.sxx = m_terms.syy = m_terms.sxy = 0;
+        m_terms.sq = m_terms.sxq = m_terms.syq = 0;
+        m_terms.sh = m_terms.sxh = m_terms.syh = 0;
+        m_extent = 0;
+        m_maxHops = 0;
+        m_inRange = true;
+      }
+
+      /**
+       * @brief AddBeacon Adds the equation of one beacon to the system
+       * @param x X position of the beacon
+       * @param y Y position of the beacon
+       * @param hops Distance to the beacon, in hops (or in any unit, the one scaled by Solve)
+       */
+      void AddBeacon(double x, double y, double hops)
+      {
+        if (m_terms.nBeacons == 0)
+          {
+            m_terms.originX = x;
+            m_terms.originY = y;
+          }
+        m_terms.nBeacons++;
+        //Kept since the last Reset, removals included: a rebuild recomputes them
+        m_extent = std::max (m_extent, std::max (std::fabs (x - m_terms.originX), std::fabs (y - m_terms.originY)));
+        m_maxHops = std::max (m_maxHops, hops);
+        m_inRange = m_inRange && Precision::InRange (m_extent, m_maxHops, m_terms.nBeacons);
+        if (m_inRange)
+          {
+            Accumulate (x, y, hops, 1);
+          }
+      }
+
+      /**
+       * @brief RemoveBeacon Removes the equation of a beacon, added before with the same values
+       */
+      void RemoveBeacon(double x, double y, double hops)
+      {
+        if (--m_terms.nBeacons == 0)
+          {
+            //Nothing left, drop the rounding errors too
+            Reset ();
+            return;
+          }
+        if (m_inRange)
+          {
+            Accumulate (x, y, hops, -1);
+          }
+      }
+
+      /**
+       * @brief GetNBeacons Number of beacons in the system
+       */
+      uint32_t GetNBeacons() const { return m_terms.nBeacons; }
+
+      /**
+       * @brief IsInRange Whether every beacon added since the last Reset fitted the sums
+       *of the precision. Once one does not, Solve fails until the system is rebuilt
+       */
+      bool     IsInRange() const   { return m_inRange; }
+
+      /**
+       * @brief GetTerms The normal equations, for code that sums them its own way
+       */
+      Terms const & GetTerms() const { return m_terms; }
+
+      /**
+       * @brief Solve Solves the least-squares system
+       * @param hopSize Length of one hop
+       * @param x Estimated X position, untouched when there is no solution
+       * @param y Estimated Y position, untouched when there is no solution
+       * @return false with less than 3 beacons, when they are (nearly) collinear, or out of range
+       */
+      bool Solve(double hopSize, double &x, double &y) const { return m_inRange && Solve (m_terms, hopSize, x, y); }
+
+      /**
+       * @brief Solve Solves a system given by its terms, summed over the same beacons
+       *and origin that AddBeacon would have used
+       */
+      static bool Solve(Terms const &terms, double hopSize, double &x, double &y);
+
+      /**
+       * @brief Refine Levenberg-Marquardt refinement of a position, minimizing the squared
+       *differences between the distances to the beacons of the table and their ranges
+       *(hop count times hop size). Each iteration is one pass over the table
+       * @param table The beacons
+       * @param hopSize Length of one hop
+       * @param maxIterations Iterations allowed
+       * @param tolerance Stop once an accepted step is shorter than this
+       * @param x Starting X position, refined in place
+       * @param y Starting Y position, refined in place
+       * @return The iterations used, why they stopped, and the final cost
+       */
+      static Refinement Refine(DistanceTable const &table, double hopSize, uint32_t maxIterations, double tolerance,
+                               double &x, double &y);
+
+    private:
+      void Accumulate(double x, double y, double hops, Sum sign)
+      {
+        Value dx = Precision::FromDouble (x - m_terms.originX);
+        Value dy = Precision::FromDouble (y - m_terms.originY);
+        Value h  = Precision::FromDouble (hops);
+        Sum q  = Precision::Mul2 (dx, dx) + Precision::Mul2 (dy, dy);
+        Sum h2 = Precision::Mul2 (h, h);
+        m_terms.sx  += sign * Precision::Widen (dx);
+        m_terms.sy  += sign * Precision::Widen (dy);
+        m_terms.sxx += sign * Precision::Mul2 (dx, dx);
+        m_terms.syy += sign * Precision::Mul2 (dy, dy);
+        m_terms.sxy += sign * Precision::Mul2 (dx, dy);
+        m_terms.sq  += sign * q;
+        m_terms.sxq += sign * Precision::Mul3 (dx, q);
+        m_terms.syq += sign * Precision::Mul3 (dy, q);
+        m_terms.sh  += sign * h2;
+        m_terms.sxh += sign * Precision::Mul3 (dx, h2);
+        m_terms.syh += sign * Precision::Mul3 (dy, h2);
+      }
+
+      Terms  m_terms;
+      //Largest |dx| or |dy| and hop count added since the last Reset
+      double m_extent;
+      double m_maxHops;
+      bool   m_inRange;
+    };
+
+    extern template class BasicLocalization<DoublePrecision>;
+    extern template class BasicLocalization<FloatPrecision>;
+    extern template class BasicLocalization<FixedPrecision>;
+
+    typedef BasicLocalization<DoublePrecision> Localization;
+
+    /**
+     * @brief The LocalizationSolver class is a BasicLocalization whose precision is chosen
+     *at run time. Every call is a switch to the inlined code of one of the instantiated
+     *policies: there is no virtual dispatch, and the two unused systems stay empty.
+     */
+    class LocalizationSolver
+    {
+    public:
+      /// Numeric policy of the system
+      enum Precision
+      {
+        DOUBLE,   //!< DoublePrecision
+        FLOAT,    //!< FloatPrecision
+        FIXED,    //!< FixedPrecision
+      };
+
+      LocalizationSolver() : m_precision (DOUBLE) {}
+
+      /**
+       * @brief SetPrecision Picks the numeric policy, and forgets every beacon
+       */
+      void SetPrecision(Precision precision)
+      {
+        m_precision = precision;
+        Reset ();
+      }
+      Precision GetPrecision() const { return m_precision; }
+
+      void Reset()
+      {
+        m_double.Reset ();
+        m_float.Reset ();
+        m_fixed.Reset ();
+      }
+
+      void AddBeacon(double x, double y, double hops)
+      {
+        switch (m_precision)
+          {
+          case DOUBLE: m_double.AddBeacon (x, y, hops); break;
+          case FLOAT:  m_float.AddBeacon (x, y, hops);  break;
+          case FIXED:  m_fixed.AddBeacon (x, y, hops);  break;
+          }
+      }
+
+      void RemoveBeacon(double x, double y, double hops)
+      {
+        switch (m_precision)
+          {
+          case DOUBLE: m_double.RemoveBeacon (x, y, hops); break;
+          case FLOAT:  m_float.RemoveBeacon (x, y, hops);  break;
+          case FIXED:  m_fixed.RemoveBeacon (x, y, hops);  break;
+          }
+      }
+
+      uint32_t GetNBeacons() const
+      {
+        switch (m_precision)
+          {
+          case FLOAT: return m_float.GetNBeacons ();
+          case FIXED: return m_fixed.GetNBeacons ();
+          default:    return m_double.GetNBeacons ();
+          }
+      }
+
+      bool IsInRange() const
+      {
+        switch (m_precision)
+          {
+          case FLOAT: return m_float.IsInRange ();
+          case FIXED: return m_fixed.IsInRange ();
+          default:    return m_double.IsInRange ();
+          }
+      }
+
+      bool Solve(double hopSize, double &x, double &y) const
+      {
+        switch (m_precision)
+          {
+          case FLOAT: return m_float.Solve (hopSize, x, y);
+          case FIXED: return m_fixed.Solve (hopSize, x, y);
+          default:    return m_double.Solve (hopSize, x, y);
+          }
+      }
+
+      Refinement Refine(DistanceTable const &table, double hopSize, uint32_t maxIterations, double tolerance,
+                        double &x, double &y) const
+      {
+        switch (m_precision)
+          {
+          case FLOAT: return BasicLocalization<FloatPrecision>::Refine (table, hopSize, maxIterations, tolerance, x, y);
+          case FIXED: return BasicLocalization<FixedPrecision>::Refine (table, hopSize, maxIterations, tolerance, x, y);
+          default:    return BasicLocalization<DoublePrecision>::Refine (table, hopSize, maxIterations, tolerance, x, y);
+          }
+      }
+
+    private:
+      Precision                           m_precision;
+      BasicLocalization<DoublePrecision>  m_double;
+      BasicLocalization<FloatPrecision>   m_float;
+      BasicLocalization<FixedPrecision>   m_fixed;
+    };
+
+  }
+}
+
+#endif // DVHOPLOCALIZATION_H
@@ -1,15 +1,212 @@
 #include "dvhop-packet.h"
 #include "ns3/packet.h"
 #include "ns3/address-utils.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace ns3
 {
   namespace dvhop
   {
 
+    namespace
+    {
+      //Helpers of the compact encoding
+      //{
+      uint32_t
+      VarintSize (uint32_t value)
+      {
+        uint32_t size = 1;
+        while (value >= 0x80)
+          {
+            value >>= 7;
+            ++size;
+          }
+        return size;
+      }
+
+      void
+      WriteVarint (Buffer::Iterator &i, uint32_t value)
+      {
+        while (value >= 0x80)
+          {
+            i.WriteU8 ((uint8_t)(value | 0x80));
+            value >>= 7;
+          }
+        i.WriteU8 ((uint8_t) value);
+      }
+
+      uint32_t
+      ReadVarint (Buffer::Iterator &i)
+      {
+        uint32_t value = 0;
+        for (uint32_t shift = 0; shift < 35; shift += 7)
+          {
+            uint8_t byte = i.ReadU8 ();
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+              {
+                break;
+              }
+          }
+        return value;
+      }
+
+      //Maps small negative and positive differences to small unsigned numbers
+      uint32_t
+      ZigZag (int32_t value)
+      {
+        return ((uint32_t) value << 1) ^ (uint32_t)(value >> 31);
+      }
+
+      int32_t
+      UnZigZag (uint32_t value)
+      {
+        return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+      }
+
+      //Positions travel as signed multiples of 'resolution' millimetres
+      int32_t
+      Quantize (double value, uint16_t resolution)
+      {
+        double q = std::floor (value * 1000.0 / resolution + 0.5);
+        q = std::max (q, (double) std::numeric_limits<int32_t>::min ());
+        q = std::min (q, (double) std::numeric_limits<int32_t>::max ());
+        return (int32_t) q;
+      }
+
+      double
+      Dequantize (int32_t value, uint16_t resolution)
+      {
+        return (double) value * resolution / 1000.0;
+      }
+
+      //Bytes of one compact advertisement entry that follows an entry for 'previous'
+      uint32_t
+      CompactEntrySize (FloodingHeader const &entry, Ipv4Address previous)
+      {
+        return 4 + 4 + VarintSize (entry.GetSequenceNumber ()) + VarintSize (entry.GetHopCount ())
+               + VarintSize (ZigZag ((int32_t)(entry.GetBeaconAddress ().Get () - previous.Get ())));
+      }
+      //}
+    }
+
+    NS_OBJECT_ENSURE_REGISTERED (TypeHeader);
+
+    TypeHeader::TypeHeader (MessageType t) :
+      m_type (t),
+      m_valid (true)
+    {
+    }
+
+    TypeId
+    TypeHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::TypeHeader")
+          .SetParent<Header> ()
+          .AddConstructor<TypeHeader> ();
+      return tid;
+    }
+
+    TypeId
+    TypeHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    uint32_t
+    TypeHeader::GetSerializedSize () const
+    {
+      return 1;
+    }
+
+    void
+    TypeHeader::Serialize (Buffer::Iterator start) const
+    {
+      start.WriteU8 ((uint8_t) m_type);
+    }
+
+    uint32_t
+    TypeHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      uint8_t type = i.ReadU8 ();
+      m_valid = true;
+      switch (type)
+        {
+        case DVHOPTYPE_FLOODING:
+        case DVHOPTYPE_ADVERTISEMENT:
+        case DVHOPTYPE_COMPACT_FLOODING:
+        case DVHOPTYPE_COMPACT_ADVERTISEMENT:
+        case DVHOPTYPE_NEIGHBOR_HELLO:
+        case DVHOPTYPE_HOP_SIZE:
+          {
+            m_type = (MessageType) type;
+            break;
+          }
+        default:
+          m_valid = false;
+        }
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize ());
+      return dist;
+    }
+
+    void
+    TypeHeader::Print (std::ostream &os) const
+    {
+      switch (m_type)
+        {
+        case DVHOPTYPE_FLOODING:
+          {
+            os << "FLOODING";
+            break;
+          }
+        case DVHOPTYPE_ADVERTISEMENT:
+          {
+            os << "ADVERTISEMENT";
+            break;
+          }
+        case DVHOPTYPE_COMPACT_FLOODING:
+          {
+            os << "COMPACT_FLOODING";
+            break;
+          }
+        case DVHOPTYPE_COMPACT_ADVERTISEMENT:
+          {
+            os << "COMPACT_ADVERTISEMENT";
+            break;
+          }
+        case DVHOPTYPE_NEIGHBOR_HELLO:
+          {
+            os << "NEIGHBOR_HELLO";
+            break;
+          }
+        case DVHOPTYPE_HOP_SIZE:
+          {
+            os << "HOP_SIZE";
+            break;
+          }
+        default:
+          os << "UNKNOWN_TYPE";
+        }
+    }
+
+    std::ostream &
+    operator<< (std::ostream &os, TypeHeader const &h)
+    {
+      h.Print (os);
+      return os;
+    }
+
+
+
     NS_OBJECT_ENSURE_REGISTERED (FloodingHeader);
 
-    FloodingHeader::FloodingHeader()
+    FloodingHeader::FloodingHeader() :
+      m_compact (false),
+      m_resolution (DEFAULT_POSITION_RESOLUTION)
     {
     }
 
@@ -20,6 +217,15 @@ namespace ns3
       m_seqNo    = seqNo;
       m_hopCount = hopCount;
       m_beaconId = beacon;
+      m_compact  = false;
+      m_resolution = DEFAULT_POSITION_RESOLUTION;
+    }
+
+    void
+    FloodingHeader::SetResolution (uint16_t millimetres)
+    {
+      NS_ASSERT (millimetres > 0);
+      m_resolution = millimetres;
     }
 
     TypeId
@@ -40,12 +246,28 @@ namespace ns3
     uint32_t
     FloodingHeader::GetSerializedSize () const
     {
+      if (m_compact)
+        {
+          //Resolution, quantized positions, varints and beacon address
+          return 2 + 4 + 4 + VarintSize (m_seqNo) + VarintSize (m_hopCount) + 4;
+        }
       return 24; //Total number of bytes when serialized
     }
 
     void
     FloodingHeader::Serialize (Buffer::Iterator start) const
     {
+      if (m_compact)
+        {
+          start.WriteHtonU16 (m_resolution);
+          start.WriteHtonU32 ((uint32_t) Quantize (m_xPos, m_resolution));
+          start.WriteHtonU32 ((uint32_t) Quantize (m_yPos, m_resolution));
+          WriteVarint (start, m_seqNo);
+          WriteVarint (start, m_hopCount);
+          WriteTo (start, m_beaconId);
+          return;
+        }
+
       //The position info are serialized as uint64_t, though they're doubles
       //We convert the double to a unsigned long and then serialize that number
       double x = m_xPos;
@@ -69,6 +291,20 @@ namespace ns3
     {
       Buffer::Iterator i = start;
 
+      if (m_compact)
+        {
+          m_resolution = i.ReadNtohU16 ();
+          NS_ASSERT (m_resolution > 0);
+          m_xPos = Dequantize ((int32_t) i.ReadNtohU32 (), m_resolution);
+          m_yPos = Dequantize ((int32_t) i.ReadNtohU32 (), m_resolution);
+          m_seqNo = ReadVarint (i);
+          m_hopCount = ReadVarint (i);
+          ReadFrom (i, m_beaconId);
+
+          uint32_t dist = i.GetDistanceFrom (start);
+          NS_ASSERT (dist == GetSerializedSize () );
+          return dist;
+        }
 
       uint64_t midX = i.ReadNtohU64 ();
       char *const p = reinterpret_cast<char*>(&midX);
@@ -79,8 +315,6 @@ namespace ns3
       std::copy(p2, p2 + sizeof(double), reinterpret_cast<char*>(&m_yPos));
 
 
-      std::cout << "Deserializing coordinates ("<<m_xPos <<","<<m_yPos<<")"<<std::endl;
-
       m_seqNo = i.ReadU16 ();
       m_hopCount = i.ReadU16 ();
       ReadFrom (i, m_beaconId);
@@ -107,5 +341,352 @@ namespace ns3
 
 
 
+    NS_OBJECT_ENSURE_REGISTERED (AdvertisementHeader);
+
+    AdvertisementHeader::AdvertisementHeader() :
+      m_compact (false),
+      m_resolution (DEFAULT_POSITION_RESOLUTION),
+      m_entryBytes (0)
+    {
+    }
+
+    TypeId
+    AdvertisementHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId("ns3::dvhop::AdvertisementHeader")
+          .SetParent<Header> ()
+          .AddConstructor<AdvertisementHeader>();
+      return tid;
+    }
+
+    TypeId
+    AdvertisementHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    void
+    AdvertisementHeader::SetCompact (bool compact)
+    {
+      NS_ASSERT (m_entries.empty ());
+      m_compact = compact;
+    }
+
+    void
+    AdvertisementHeader::SetResolution (uint16_t millimetres)
+    {
+      NS_ASSERT (millimetres > 0);
+      m_resolution = millimetres;
+    }
+
+    void
+    AdvertisementHeader::AddEntry (FloodingHeader const &entry)
+    {
+      NS_ASSERT (m_entries.size () < 0xffff);
+      if (m_compact)
+        {
+          Ipv4Address previous = m_entries.empty () ? Ipv4Address ((uint32_t) 0) : m_entries.back ().GetBeaconAddress ();
+          m_entryBytes += CompactEntrySize (entry, previous);
+        }
+      else
+        {
+          m_entryBytes += FloodingHeader ().GetSerializedSize ();
+        }
+      //The encoding of the entries is decided by this message
+      m_entries.push_back (entry);
+      m_entries.back ().SetCompact (false);
+    }
+
+    uint32_t
+    AdvertisementHeader::GetEntrySerializedSize (FloodingHeader const &entry) const
+    {
+      if (!m_compact)
+        {
+          return FloodingHeader ().GetSerializedSize ();
+        }
+      Ipv4Address previous = m_entries.empty () ? Ipv4Address ((uint32_t) 0) : m_entries.back ().GetBeaconAddress ();
+      //The entry itself plus the growth of the entry count varint
+      return CompactEntrySize (entry, previous)
+             + VarintSize (m_entries.size () + 1) - VarintSize (m_entries.size ());
+    }
+
+    void
+    AdvertisementHeader::Clear ()
+    {
+      m_entries.clear ();
+      m_entryBytes = 0;
+    }
+
+    uint32_t
+    AdvertisementHeader::GetSerializedSize () const
+    {
+      if (m_compact)
+        {
+          //Resolution + entry count varint + entries
+          return 2 + VarintSize (m_entries.size ()) + m_entryBytes;
+        }
+      //Entry count + every entry laid out as a FloodingHeader
+      return 2 + m_entryBytes;
+    }
+
+    void
+    AdvertisementHeader::Serialize (Buffer::Iterator start) const
+    {
+      Buffer::Iterator i = start;
+      if (m_compact)
+        {
+          i.WriteHtonU16 (m_resolution);
+          WriteVarint (i, m_entries.size ());
+          uint32_t previous = 0;
+          for (std::vector<FloodingHeader>::const_iterator e = m_entries.begin (); e != m_entries.end (); ++e)
+            {
+              uint32_t address = e->GetBeaconAddress ().Get ();
+              i.WriteHtonU32 ((uint32_t) Quantize (e->GetXPosition (), m_resolution));
+              i.WriteHtonU32 ((uint32_t) Quantize (e->GetYPosition (), m_resolution));
+              WriteVarint (i, e->GetSequenceNumber ());
+              WriteVarint (i, e->GetHopCount ());
+              WriteVarint (i, ZigZag ((int32_t)(address - previous)));
+              previous = address;
+            }
+          return;
+        }
+
+      i.WriteHtonU16 (m_entries.size ());
+      for (std::vector<FloodingHeader>::const_iterator e = m_entries.begin (); e != m_entries.end (); ++e)
+        {
+          e->Serialize (i);
+          i.Next (e->GetSerializedSize ());
+        }
+    }
+
+    uint32_t
+    AdvertisementHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      Clear ();
+
+      if (m_compact)
+        {
+          m_resolution = i.ReadNtohU16 ();
+          NS_ASSERT (m_resolution > 0);
+          uint32_t count = ReadVarint (i);
+          m_entries.reserve (count);
+          uint32_t previous = 0;
+          for (uint32_t n = 0; n < count; ++n)
+            {
+              double x = Dequantize ((int32_t) i.ReadNtohU32 (), m_resolution);
+              double y = Dequantize ((int32_t) i.ReadNtohU32 (), m_resolution);
+              uint16_t seqNo = ReadVarint (i);
+              uint16_t hops = ReadVarint (i);
+              previous += (uint32_t) UnZigZag (ReadVarint (i));
+              AddEntry (FloodingHeader (x, y, seqNo, hops, Ipv4Address (previous)));
+            }
+        }
+      else
+        {
+          uint16_t count = i.ReadNtohU16 ();
+          m_entries.reserve (count);
+          for (uint16_t n = 0; n < count; ++n)
+            {
+              FloodingHeader entry;
+              i.Next (entry.Deserialize (i));
+              AddEntry (entry);
+            }
+        }
+
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize () );
+      return dist;
+    }
+
+    void
+    AdvertisementHeader::Print (std::ostream &os) const
+    {
+      os << m_entries.size () << " entries\n";
+      for (std::vector<FloodingHeader>::const_iterator e = m_entries.begin (); e != m_entries.end (); ++e)
+        {
+          e->Print (os);
+        }
+    }
+
+    std::ostream &
+    operator<< (std::ostream &os, AdvertisementHeader const &h)
+    {
+      h.Print (os);
+      return os;
+    }
+
+
+
+
+    NS_OBJECT_ENSURE_REGISTERED (NeighborHelloHeader);
+
+    NeighborHelloHeader::NeighborHelloHeader()
+    {
+    }
+
+    TypeId
+    NeighborHelloHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId("ns3::dvhop::NeighborHelloHeader")
+          .SetParent<Header> ()
+          .AddConstructor<NeighborHelloHeader>();
+      return tid;
+    }
+
+    TypeId
+    NeighborHelloHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    void
+    NeighborHelloHeader::AddNeighbor (Ipv4Address neighbor, bool isMpr)
+    {
+      NS_ASSERT (m_neighbors.size () < 0xffff);
+      m_neighbors.push_back (neighbor);
+      m_mpr.push_back (isMpr);
+    }
+
+    uint32_t
+    NeighborHelloHeader::GetSerializedSize () const
+    {
+      return 2 + 5 * m_neighbors.size ();
+    }
+
+    void
+    NeighborHelloHeader::Serialize (Buffer::Iterator start) const
+    {
+      Buffer::Iterator i = start;
+      i.WriteHtonU16 (m_neighbors.size ());
+      for (uint16_t n = 0; n < m_neighbors.size (); ++n)
+        {
+          WriteTo (i, m_neighbors[n]);
+          i.WriteU8 (m_mpr[n] ? 1 : 0);
+        }
+    }
+
+    uint32_t
+    NeighborHelloHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      m_neighbors.clear ();
+      m_mpr.clear ();
+      uint16_t count = i.ReadNtohU16 ();
+      for (uint16_t n = 0; n < count; ++n)
+        {
+          Ipv4Address neighbor;
+          ReadFrom (i, neighbor);
+          AddNeighbor (neighbor, i.ReadU8 () & 1);
+        }
+
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize () );
+      return dist;
+    }
+
+    void
+    NeighborHelloHeader::Print (std::ostream &os) const
+    {
+      os << m_neighbors.size () << " neighbours:";
+      for (uint16_t n = 0; n < m_neighbors.size (); ++n)
+        {
+          os << " " << m_neighbors[n] << (m_mpr[n] ? "(MPR)" : "");
+        }
+      os << "\n";
+    }
+
+    std::ostream &
+    operator<< (std::ostream &os, NeighborHelloHeader const &h)
+    {
+      h.Print (os);
+      return os;
+    }
+
+
+    NS_OBJECT_ENSURE_REGISTERED (HopSizeHeader);
+
+    HopSizeHeader::HopSizeHeader() :
+      m_seqNo (0),
+      m_hopCount (0),
+      m_hopSize (0)
+    {
+    }
+
+    HopSizeHeader::HopSizeHeader(Ipv4Address beacon, uint16_t seqNo, uint16_t hopCount, double hopSize) :
+      m_beaconId (beacon),
+      m_seqNo (seqNo),
+      m_hopCount (hopCount),
+      m_hopSize (hopSize)
+    {
+    }
+
+    TypeId
+    HopSizeHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId("ns3::dvhop::HopSizeHeader")
+          .SetParent<Header> ()
+          .AddConstructor<HopSizeHeader>();
+      return tid;
+    }
+
+    TypeId
+    HopSizeHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    uint32_t
+    HopSizeHeader::GetSerializedSize () const
+    {
+      return 16;
+    }
+
+    void
+    HopSizeHeader::Serialize (Buffer::Iterator start) const
+    {
+      WriteTo (start, m_beaconId);
+      start.WriteHtonU16 (m_seqNo);
+      start.WriteHtonU16 (m_hopCount);
+
+      //Serialized as uint64_t, like the positions of the FloodingHeader
+      double hopSize = m_hopSize;
+      uint64_t dst;
+      char *const p = reinterpret_cast<char*>(&hopSize);
+      std::copy(p, p+sizeof(uint64_t), reinterpret_cast<char*>(&dst));
+      start.WriteHtonU64 (dst);
+    }
+
+    uint32_t
+    HopSizeHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      ReadFrom (i, m_beaconId);
+      m_seqNo = i.ReadNtohU16 ();
+      m_hopCount = i.ReadNtohU16 ();
+
+      uint64_t src = i.ReadNtohU64 ();
+      char *const p = reinterpret_cast<char*>(&src);
+      std::copy(p, p+sizeof(double), reinterpret_cast<char*>(&m_hopSize));
+
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize () );
+      return dist;
+    }
+
+    void
+    HopSizeHeader::Print (std::ostream &os) const
+    {
+      os << "Beacon: " << m_beaconId << ", SeqNo: " << m_seqNo << ", HopCount: " << m_hopCount
+         << ", HopSize: " << m_hopSize << "\n";
+    }
+
+    std::ostream &
+    operator<< (std::ostream &os, HopSizeHeader const &h)
+    {
+      h.Print (os);
+      return os;
+    }
+
   }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define DVHOP_PACKET_H
 
 #include <iostream>
+#include <vector>
 #include "ns3/header.h"
 #include "ns3/enum.h"
 #include "ns3/ipv4-address.h"
@@ -11,6 +12,59 @@ namespace ns3
 {
   namespace dvhop
   {
+    enum MessageType
+    {
+      DVHOPTYPE_FLOODING              = 1,   //!< One beacon per packet, FloodingHeader
+      DVHOPTYPE_ADVERTISEMENT         = 2,   //!< Several beacons per packet, AdvertisementHeader
+      DVHOPTYPE_COMPACT_FLOODING      = 3,   //!< FloodingHeader in the compact encoding
+      DVHOPTYPE_COMPACT_ADVERTISEMENT = 4,   //!< AdvertisementHeader in the compact encoding
+      DVHOPTYPE_NEIGHBOR_HELLO        = 5,   //!< 1-hop neighbour list, NeighborHelloHeader
+      DVHOPTYPE_HOP_SIZE              = 6,   //!< Hop size correction of a beacon, HopSizeHeader
+    };
+
+    /// Default quantization step of the compact encoding, in millimetres
+    const uint16_t DEFAULT_POSITION_RESOLUTION = 10;
+
+    /**
+     * @brief SeqNoIsNewer Compares two beacon sequence numbers with serial number
+     *arithmetic (RFC 1982), so the result stays right when the counter wraps around
+     * @return true if a is newer than b
+     */
+    inline bool
+    SeqNoIsNewer (uint16_t a, uint16_t b)
+    {
+      return (int16_t)(uint16_t)(a - b) > 0;
+    }
+
+    /**
+     * @brief The TypeHeader class is the first header of every DV-Hop
+     *packet and tells the receiver which message follows it.
+     */
+    class TypeHeader : public Header
+    {
+    public:
+      TypeHeader (MessageType t = DVHOPTYPE_FLOODING);
+
+      //Serializing and deserializing
+      //{
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+      //}
+
+      MessageType Get ()     const { return m_type;  }
+      bool        IsValid () const { return m_valid; }
+
+    private:
+      MessageType m_type;
+      bool        m_valid;
+    };
+
+    std::ostream & operator<< (std::ostream & os, TypeHeader const &);
+
     /*
     0                   1                   2                   3
     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -28,6 +82,21 @@ namespace ns3
     |                        Beacon IP address                      |
     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 
+    Compact encoding (DVHOPTYPE_COMPACT_FLOODING): positions are quantized to
+    signed multiples of the resolution, sequence number and hops are varints.
+
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |    Resolution (millimetres)   |                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+                               +
+    |                   Quantized X, Quantized Y                    |
+    +                               +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                               | Seq no (1-3)  | Hops (1-3)    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                        Beacon IP address                      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
     */
     class FloodingHeader: public Header
     {
@@ -53,11 +122,25 @@ namespace ns3
       void SetSequenceNumber(uint16_t sn)  { m_seqNo = sn;   }
       void SetBeaconAddress(Ipv4Address a) { m_beaconId = a; }
 
-      double    GetXPosition()        {   return m_xPos;     }
-      double    GetYPosition()        {   return m_yPos;     }
-      uint16_t GetHopCount()         {   return m_hopCount; }
-      uint16_t GetSequenceNumber()   {   return m_seqNo;    }
-      Ipv4Address GetBeaconAddress() {   return m_beaconId; }
+      double      GetXPosition()      const {   return m_xPos;     }
+      double      GetYPosition()      const {   return m_yPos;     }
+      uint16_t    GetHopCount()       const {   return m_hopCount; }
+      uint16_t    GetSequenceNumber() const {   return m_seqNo;    }
+      Ipv4Address GetBeaconAddress()  const {   return m_beaconId; }
+
+      /**
+       * @brief SetCompact Selects the compact encoding. It must match the
+       *message type of the TypeHeader in front of this header.
+       */
+      void     SetCompact(bool compact)       { m_compact = compact;   }
+      bool     IsCompact()            const   { return m_compact;      }
+
+      /**
+       * @brief SetResolution Quantization step of the positions in the compact encoding
+       * @param millimetres The step, at least one millimetre
+       */
+      void     SetResolution(uint16_t millimetres);
+      uint16_t GetResolution()        const   { return m_resolution;   }
 
 
     private:
@@ -66,11 +149,193 @@ namespace ns3
       uint16_t     m_seqNo;
       uint16_t     m_hopCount;
       Ipv4Address  m_beaconId;
+      bool         m_compact;
+      uint16_t     m_resolution;
     };
 
     std::ostream & operator<< (std::ostream & os, FloodingHeader const &);
 
 
+    /*
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |        Entry count            |                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+                               +
+    |             Entries, laid out as a FloodingHeader             |
+    +                                                               +
+    |                              ...                              |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    */
+    /**
+     * @brief The AdvertisementHeader class carries the information of several
+     *beacons in a single packet, so a node can advertise its whole DistanceTable
+     *with one frame (or a few, when it does not fit in the MTU).
+     */
+    class AdvertisementHeader: public Header
+    {
+    public:
+
+      AdvertisementHeader();
+
+      //Serializing and deserializing
+      //{
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+      //}
+
+      /**
+       * @brief AddEntry Appends the information of one beacon to the message
+       * @param entry The beacon information
+       */
+      void AddEntry (FloodingHeader const &entry);
+
+      /**
+       * @brief GetEntrySerializedSize The number of bytes that AddEntry would add to this message
+       * @param entry The beacon information
+       * @return The size in bytes
+       */
+      uint32_t GetEntrySerializedSize (FloodingHeader const &entry) const;
+
+      /**
+       * @brief Clear Removes every entry
+       */
+      void Clear ();
+
+      uint16_t              GetNEntries () const           { return m_entries.size (); }
+      FloodingHeader const& GetEntry (uint16_t i) const    { return m_entries[i]; }
+
+      /**
+       * @brief SetCompact Selects the compact encoding, only allowed while the message is empty
+       */
+      void     SetCompact (bool compact);
+      bool     IsCompact () const                          { return m_compact; }
+
+      /**
+       * @brief SetResolution Quantization step of the positions in the compact encoding
+       * @param millimetres The step, at least one millimetre
+       */
+      void     SetResolution (uint16_t millimetres);
+      uint16_t GetResolution () const                      { return m_resolution; }
+
+    private:
+      std::vector<FloodingHeader> m_entries;
+      bool                        m_compact;
+      uint16_t                    m_resolution;
+      uint32_t                    m_entryBytes;   //!< Serialized size of the entries added so far
+    };
+
+    std::ostream & operator<< (std::ostream & os, AdvertisementHeader const &);
+
+
+    /*
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |       Neighbour count         |     Neighbour IP address      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |  (continued)                  |     Flags     |      ...      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    */
+    /**
+     * @brief The NeighborHelloHeader class lists the 1-hop neighbours of the
+     *sender, flagging the ones it selected as multipoint relays. Receivers
+     *learn their 2-hop neighbourhood and whether they have to relay.
+     */
+    class NeighborHelloHeader: public Header
+    {
+    public:
+
+      NeighborHelloHeader();
+
+      //Serializing and deserializing
+      //{
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+      //}
+
+      /**
+       * @brief AddNeighbor Appends a 1-hop neighbour of the sender
+       * @param neighbor Its address
+       * @param isMpr true if the sender selected it as multipoint relay
+       */
+      void AddNeighbor (Ipv4Address neighbor, bool isMpr);
+
+      uint16_t    GetNNeighbors () const           { return m_neighbors.size (); }
+      Ipv4Address GetNeighbor (uint16_t i) const   { return m_neighbors[i]; }
+      bool        IsMpr (uint16_t i) const         { return m_mpr[i]; }
+
+    private:
+      std::vector<Ipv4Address> m_neighbors;
+      std::vector<bool>        m_mpr;
+    };
+
+    std::ostream & operator<< (std::ostream & os, NeighborHelloHeader const &);
+
+
+    /*
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                        Beacon IP address                      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |       Sequence number         |           Hops                |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                           Hop size (1)                        |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                           Hop size (2)                        |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    */
+    /**
+     * @brief The HopSizeHeader class is the correction message of DV-Hop: the
+     *average distance covered by one hop, as measured by a beacon from the
+     *positions and hop counts of the other beacons it knows.
+     */
+    class HopSizeHeader: public Header
+    {
+    public:
+
+      HopSizeHeader();
+      HopSizeHeader(Ipv4Address beacon, uint16_t seqNo, uint16_t hopCount, double hopSize);
+
+      //Serializing and deserializing
+      //{
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+      //}
+
+      void SetHopCount(uint16_t count)     { m_hopCount = count; }
+
+      Ipv4Address GetBeaconAddress()  const {   return m_beaconId; }
+      uint16_t    GetSequenceNumber() const {   return m_seqNo;    }
+      uint16_t    GetHopCount()       const {   return m_hopCount; }
+      double      GetHopSize()        const {   return m_hopSize;  }
+
+    private:
+      Ipv4Address  m_beaconId;
+      uint16_t     m_seqNo;
+      uint16_t     m_hopCount;
+      double       m_hopSize;
+    };
+
+    std::ostream & operator<< (std::ostream & os, HopSizeHeader const &);
+
+
   }
 }
 
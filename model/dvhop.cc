@@ -4,7 +4,11 @@
 #include "dvhop-packet.h"
 #include "ns3/vector.h"
 #include "ns3/log.h"
+#include "ns3/abort.h"
 #include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/trace-source-accessor.h"
@@ -13,6 +17,8 @@
 #include "ns3/adhoc-wifi-mac.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/mobility-model.h"
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE ("DVHopRoutingProtocol");
 
@@ -34,11 +40,177 @@ namespace ns3 {
                          TimeValue (Seconds (1)),                              // default value
                          MakeTimeAccessor (&RoutingProtocol::HelloInterval),   // accessed through
                          MakeTimeChecker ())
+          .AddAttribute ("HelloFormat",
+                         "Wire format of the HELLO messages: one packet per beacon, or "
+                         "several beacons aggregated in each packet up to the interface MTU.",
+                         EnumValue (LEGACY_HELLO),
+                         MakeEnumAccessor (&RoutingProtocol::m_helloFormat),
+                         MakeEnumChecker (LEGACY_HELLO, "Legacy",
+                                          AGGREGATED_HELLO, "Aggregated"))
+          .AddAttribute ("DeltaHello",
+                         "Advertise only the DistanceTable entries whose hops or position changed since the last HELLO.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_deltaHello),
+                         MakeBooleanChecker ())
+          .AddAttribute ("FullRefreshInterval",
+                         "In delta mode, number of HELLO intervals between two advertisements of the whole table.",
+                         UintegerValue (10),
+                         MakeUintegerAccessor (&RoutingProtocol::m_fullRefreshInterval),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("Precision",
+                         "Arithmetic of the localization: double, float, or fixed point for targets without an FPU. "
+                         "A node whose beacons span more than about 104 km / cbrt (beacons) is not localized in fixed point.",
+                         EnumValue (LocalizationSolver::DOUBLE),
+                         MakeEnumAccessor (&RoutingProtocol::m_precision),
+                         MakeEnumChecker (LocalizationSolver::DOUBLE, "Double",
+                                          LocalizationSolver::FLOAT, "Float",
+                                          LocalizationSolver::FIXED, "Fixed"))
+          .AddAttribute ("Refinement",
+                         "Refine the least-squares estimate against the ranges with Levenberg-Marquardt, "
+                         "starting from the previous estimate once the node is localized.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_refinement),
+                         MakeBooleanChecker ())
+          .AddAttribute ("RefinementIterations",
+                         "Most iterations of one refinement.",
+                         UintegerValue (5),
+                         MakeUintegerAccessor (&RoutingProtocol::m_refinementIterations),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("RefinementTolerance",
+                         "The refinement stops once a step is shorter than this, in meters.",
+                         DoubleValue (0.01),
+                         MakeDoubleAccessor (&RoutingProtocol::m_refinementTolerance),
+                         MakeDoubleChecker<double> (0))
+          .AddAttribute ("EstimateInterval",
+                         "Delay after a table change before the position is estimated again, so that "
+                         "the changes in between are solved once. Zero only estimates on demand, "
+                         "when the position is read.",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&RoutingProtocol::m_estimateInterval),
+                         MakeTimeChecker ())
+          .AddAttribute ("EstimateHysteresis",
+                         "Hop count changes, summed over the beacons, below which a localized node keeps "
+                         "its estimate. Beacons entering or leaving the table, and a new hop size, always "
+                         "give a new estimate.",
+                         UintegerValue (0),
+                         MakeUintegerAccessor (&RoutingProtocol::m_estimateHysteresis),
+                         MakeUintegerChecker<uint32_t> ())
+          .AddAttribute ("CompactEncoding",
+                         "Send HELLO messages with quantized positions and varint hops and sequence numbers.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_compactEncoding),
+                         MakeBooleanChecker ())
+          .AddAttribute ("PositionResolution",
+                         "Quantization step of the beacon positions in the compact encoding, in millimetres.",
+                         UintegerValue (DEFAULT_POSITION_RESOLUTION),
+                         MakeUintegerAccessor (&RoutingProtocol::m_positionResolution),
+                         MakeUintegerChecker<uint16_t> (1))
+          .AddAttribute ("TriggeredUpdates",
+                         "Advertise a shorter path as soon as it is found instead of waiting for the next HELLO.",
+                         BooleanValue (true),
+                         MakeBooleanAccessor (&RoutingProtocol::m_triggeredUpdates),
+                         MakeBooleanChecker ())
+          .AddAttribute ("TriggeredUpdateJitter",
+                         "Maximum random delay before a triggered update is sent.",
+                         TimeValue (MilliSeconds (5)),
+                         MakeTimeAccessor (&RoutingProtocol::m_triggeredUpdateJitter),
+                         MakeTimeChecker ())
+          .AddAttribute ("TriggeredUpdateHoldDown",
+                         "Minimum time between two triggered updates of the same node.",
+                         TimeValue (MilliSeconds (10)),
+                         MakeTimeAccessor (&RoutingProtocol::m_triggeredUpdateHoldDown),
+                         MakeTimeChecker ())
+          .AddAttribute ("Trickle",
+                         "Drive the HELLOs with a Trickle timer instead of the fixed HelloInterval.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_trickle),
+                         MakeBooleanChecker ())
+          .AddAttribute ("TrickleImin",
+                         "Smallest Trickle interval, used right after an inconsistency.",
+                         TimeValue (MilliSeconds (100)),
+                         MakeTimeAccessor (&RoutingProtocol::m_trickleImin),
+                         MakeTimeChecker ())
+          .AddAttribute ("TrickleImax",
+                         "Largest Trickle interval, reached while the network stays consistent.",
+                         TimeValue (Seconds (60)),
+                         MakeTimeAccessor (&RoutingProtocol::m_trickleImax),
+                         MakeTimeChecker ())
+          .AddAttribute ("TrickleK",
+                         "Trickle redundancy constant: the HELLO of an interval is suppressed after hearing "
+                         "this many consistent advertisements. 0 never suppresses.",
+                         UintegerValue (2),
+                         MakeUintegerAccessor (&RoutingProtocol::m_trickleK),
+                         MakeUintegerChecker<uint32_t> ())
+          .AddAttribute ("MprEnabled",
+                         "Only re-advertise beacons when selected as multipoint relay by a neighbour.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_mprEnabled),
+                         MakeBooleanChecker ())
+          .AddAttribute ("NeighborHelloInterval",
+                         "Interval between neighbour HELLOs, used when MprEnabled is set. "
+                         "Neighbours not heard for three intervals are forgotten.",
+                         TimeValue (Seconds (1)),
+                         MakeTimeAccessor (&RoutingProtocol::m_neighborHelloInterval),
+                         MakeTimeChecker ())
+          .AddAttribute ("MaxBeacons",
+                         "Keep and advertise only this many beacons, the ones with the lowest hop count. 0 means no limit.",
+                         UintegerValue (0),
+                         MakeUintegerAccessor (&RoutingProtocol::m_maxBeacons),
+                         MakeUintegerChecker<uint32_t> ())
+          .AddAttribute ("MaxHopRadius",
+                         "Keep and advertise only the beacons at most this many hops away. 0 means no limit.",
+                         UintegerValue (0),
+                         MakeUintegerAccessor (&RoutingProtocol::m_maxHopRadius),
+                         MakeUintegerChecker<uint16_t> ())
+          .AddAttribute ("BeaconLifetime",
+                         "Beacons not heard with a newer sequence number for this long are removed "
+                         "from the table, and so from the advertisements. Zero keeps them forever. "
+                         "Beacons refresh their sequence number once per full refresh, so it must exceed "
+                         "HelloInterval (TrickleImax with Trickle) times FullRefreshInterval with DeltaHello; "
+                         "a few times that tolerates lost HELLOs, multi-hop delays and Trickle suppression.",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&RoutingProtocol::m_beaconLifetime),
+                         MakeTimeChecker ())
+          .AddAttribute ("LocalizationRefresh",
+                         "Incremental updates of the localization normal equations between two "
+                         "rebuilds from the distance table, which bound the rounding drift.",
+                         UintegerValue (256),
+                         MakeUintegerAccessor (&RoutingProtocol::m_localizationRefresh),
+                         MakeUintegerChecker<uint32_t> (1))
           .AddAttribute ("UniformRv",
                          "Access to the underlying UniformRandomVariable",
                          StringValue ("ns3::UniformRandomVariable"),
                          MakePointerAccessor (&RoutingProtocol::m_URandom),
-                         MakePointerChecker<UniformRandomVariable> ());                                  // the checker is used to set bounds in values
+                         MakePointerChecker<UniformRandomVariable> ())                                   // the checker is used to set bounds in values
+          .AddTraceSource ("HelloTx",
+                           "A DV-Hop packet is sent on an interface: a HELLO, legacy or aggregated, "
+                           "a neighbour HELLO or a hop size correction.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_helloTxTrace),
+                           "ns3::dvhop::RoutingProtocol::PacketTracedCallback")
+          .AddTraceSource ("AdvertisementRx",
+                           "A HELLO packet, legacy or aggregated, is received from a neighbour.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_advertisementRxTrace),
+                           "ns3::dvhop::RoutingProtocol::PacketTracedCallback")
+          .AddTraceSource ("TableUpdate",
+                           "A beacon is added to the distance table, gets a shorter path, moves, or is removed.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_tableUpdateTrace),
+                           "ns3::dvhop::RoutingProtocol::TableUpdateTracedCallback")
+          .AddTraceSource ("EstimateUpdate",
+                           "The position estimate is solved again.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_estimateUpdateTrace),
+                           "ns3::dvhop::RoutingProtocol::EstimateUpdateTracedCallback")
+          .AddTraceSource ("EarlyDrop",
+                           "A stale advertisement entry is dropped by the duplicate cache.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_earlyDropTrace),
+                           "ns3::dvhop::RoutingProtocol::EarlyDropTracedCallback")
+          .AddTraceSource ("TableSize",
+                           "Number of beacons in the distance table.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_tableSize),
+                           "ns3::TracedValueCallback::Uint32")
+          .AddTraceSource ("Estimate",
+                           "Estimated position of the node.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::estimatedPosition),
+                           "ns3::dvhop::RoutingProtocol::VectorTracedCallback");
       return tid;
     }
 
@@ -51,22 +223,103 @@ namespace ns3 {
     RoutingProtocol::RoutingProtocol () :
       HelloInterval (Seconds (1)),         //Send HELLO each second
       m_htimer (Timer::CANCEL_ON_DESTROY), //Set timer for HELLO
+      m_helloFormat (LEGACY_HELLO),
+      m_deltaHello (false),
+      m_fullRefreshInterval (10),
+      m_helloRound (0),
+      m_advertisedGeneration (0),
+      m_triggeredUpdates (true),
+      m_triggeredUpdateJitter (MilliSeconds (5)),
+      m_triggeredUpdateHoldDown (MilliSeconds (10)),
+      m_triggerTimer (Timer::CANCEL_ON_DESTROY),
+      m_lastTriggeredUpdate (Seconds (0)),
+      m_trickle (false),
+      m_trickleImin (MilliSeconds (100)),
+      m_trickleImax (Seconds (60)),
+      m_trickleK (2),
+      m_trickleInterval (MilliSeconds (100)),
+      m_trickleCounter (0),
+      m_trickleTimer (Timer::CANCEL_ON_DESTROY),
+      m_trickleSuppressed (0),
+      m_controlPackets (0),
+      m_controlBytes (0),
+      m_mprEnabled (false),
+      m_neighborHelloInterval (Seconds (1)),
+      m_neighborTimer (Timer::CANCEL_ON_DESTROY),
+      m_compactEncoding (false),
+      m_positionResolution (DEFAULT_POSITION_RESOLUTION),
+      m_maxBeacons (0),
+      m_maxHopRadius (0),
+      m_beaconLifetime (Seconds (0)),
+      m_expiryTimer (Timer::CANCEL_ON_DESTROY),
+      m_earlyDroppedEntries (0),
+      m_earlyDroppedPackets (0),
       m_isBeacon(false),
       m_xPosition(12.56),
       m_yPosition(468.5),
-      m_seqNo (0)
+      m_seqNo (0),
+      m_hopSizeDistance (0),
+      m_hopSizeHops (0),
+      m_advertisedHopSize (0),
+      m_hopSize (0),
+      m_hopSizeSourceHops (0xffff),
+      m_hopSizeSeqNo (0),
+      m_localized (false),
+      m_precision (LocalizationSolver::DOUBLE),
+      m_localizationRefresh (256),
+      m_localizationUpdates (0),
+      m_estimateInterval (Seconds (0)),
+      m_estimateTimer (Timer::CANCEL_ON_DESTROY),
+      m_estimateHysteresis (0),
+      m_estimateStale (false),
+      m_pendingHopChange (0),
+      m_refinement (false),
+      m_refinementIterations (5),
+      m_refinementTolerance (0.01),
+      m_lastRefinementIterations (0),
+      m_refinementIterationsTotal (0),
+      m_refinements (0),
+      m_refinedCost (0)
     {
+      m_disTable.SetRemovalCallback (MakeCallback (&RoutingProtocol::BeaconRemoved, this));
     }
         
-    Vector RoutingProtocol::GetRealPosition() const {
-    // Assuming the real position is stored in the private member variable realPosition
-    return Vector(realPosition.x, realPosition.y, 0.0); // Assuming 2D positions, add 0.0 for the z-coordinate
-  }
+    Vector
+    RoutingProtocol::GetRealPosition () const
+    {
+      if (m_ipv4)
+        {
+          Ptr<MobilityModel> mobility = m_ipv4->GetObject<MobilityModel> ();
+          if (mobility)
+            {
+              return mobility->GetPosition ();
+            }
+        }
+      return Vector (m_xPosition, m_yPosition, 0.0);
+    }
 
-  Vector RoutingProtocol::GetPosition() const {
-    // Assuming the estimated position is stored in the private member variable estimatedPosition
-    return Vector(estimatedPosition.x, estimatedPosition.y, 0.0); // Assuming 2D positions, add 0.0 for the z-coordinate
-  }
+    Vector
+    RoutingProtocol::GetPosition () const
+    {
+      if (m_isBeacon)
+        {
+          return Vector (m_xPosition, m_yPosition, 0.0);
+        }
+      //The estimate is a cache, solved on demand
+      UpdateEstimate ();
+      return estimatedPosition;
+    }
+
+    bool
+    RoutingProtocol::IsLocalized () const
+    {
+      if (m_isBeacon)
+        {
+          return true;
+        }
+      UpdateEstimate ();
+      return m_localized;
+    }
 
 
     RoutingProtocol::~RoutingProtocol ()
@@ -231,6 +484,11 @@ namespace ns3 {
 
       m_htimer.SetFunction (&RoutingProtocol::HelloTimerExpire, this);
       m_htimer.Schedule (RoutingProtocol::HelloInterval);
+      m_triggerTimer.SetFunction (&RoutingProtocol::SendTriggeredUpdate, this);
+      m_trickleTimer.SetFunction (&RoutingProtocol::TrickleTimerExpire, this);
+      m_neighborTimer.SetFunction (&RoutingProtocol::NeighborHelloTimerExpire, this);
+      m_expiryTimer.SetFunction (&RoutingProtocol::ExpiryTimerExpire, this);
+      m_estimateTimer.SetFunction (&RoutingProtocol::UpdateEstimate, this);
 
       m_ipv4 = ipv4;
 
@@ -359,12 +617,12 @@ RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit
 {
   *stream->GetStream () << "Routing table for Node " << m_ipv4->GetObject<Node>()->GetId() << ":\n";
 
-  std::vector<Ipv4Address> knownBeacons = m_disTable.GetKnownBeacons ();
-  for (const auto& beacon : knownBeacons) {
-    *stream->GetStream () << "Beacon: " << beacon << " - Hops: " << m_disTable.GetHopsTo(beacon)
-                          << " - Position: (" << m_disTable.GetBeaconPosition(beacon).first
-                          << ", " << m_disTable.GetBeaconPosition(beacon).second << ")\n";
-  }
+  std::ostream &os = *stream->GetStream ();
+  m_disTable.ForEach ([&os] (Ipv4Address beacon, BeaconInfo const &info) {
+    os << "Beacon: " << beacon << " - Hops: " << info.GetHops ()
+       << " - Position: (" << info.GetPosition ().first
+       << ", " << info.GetPosition ().second << ")\n";
+  });
 }
 
     void
@@ -397,6 +655,30 @@ RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit
     {
       NS_LOG_FUNCTION (this);
       //Initialize timers and extra behaviour not initialized in the constructor
+      m_disTable.SetHorizon (m_maxBeacons, m_maxHopRadius);
+      m_localization.SetPrecision (m_precision);
+      RebuildLocalization ();
+      if (m_beaconLifetime.IsStrictlyPositive ())
+        {
+          //Beacons originate a new sequence number once per full refresh, at most a Trickle interval apart
+          Time refresh = (m_trickle ? m_trickleImax : HelloInterval) * (m_deltaHello ? m_fullRefreshInterval : 1);
+          NS_ABORT_MSG_IF (m_beaconLifetime <= refresh, "BeaconLifetime " << m_beaconLifetime.GetSeconds ()
+                           << " s would expire live beacons, which are only refreshed every "
+                           << refresh.GetSeconds () << " s");
+          m_disTable.SetLifetime (m_beaconLifetime);
+          m_expiryTimer.Schedule (m_disTable.GetExpiryTick ());
+        }
+      if (m_trickle)
+        {
+          NS_ASSERT (m_trickleImin.IsStrictlyPositive () && m_trickleImin <= m_trickleImax);
+          m_trickleInterval = m_trickleImin;
+          StartTrickleInterval ();
+        }
+      if (m_mprEnabled)
+        {
+          //Discover the neighbourhood before the first advertisements
+          m_neighborTimer.Schedule (MilliSeconds (m_URandom->GetInteger (0, 10)));
+        }
     }
 
 
@@ -405,12 +687,69 @@ RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit
     {
       NS_LOG_DEBUG ("HelloTimer expired");
 
+      if (m_trickle)
+        {
+          //End of the Trickle interval: the network stayed consistent, double it
+          m_trickleInterval = std::min (m_trickleInterval * 2, m_trickleImax);
+          StartTrickleInterval ();
+          return;
+        }
+
       SendHello ();
 
       m_htimer.Cancel ();
       m_htimer.Schedule (RoutingProtocol::HelloInterval);
     }
 
+    void
+    RoutingProtocol::ExpiryTimerExpire ()
+    {
+      uint32_t expired = m_disTable.Expire (Simulator::Now ());
+      if (expired > 0)
+        {
+          NS_LOG_DEBUG (expired << " beacons expired, " << m_disTable.GetSize () << " left");
+          m_tableSize = m_disTable.GetSize ();
+        }
+      m_expiryTimer.Schedule (m_disTable.GetExpiryTick ());
+    }
+
+    void
+    RoutingProtocol::StartTrickleInterval ()
+    {
+      m_trickleCounter = 0;
+      Time t = Seconds (m_URandom->GetValue (m_trickleInterval.GetSeconds () / 2, m_trickleInterval.GetSeconds ()));
+      NS_LOG_DEBUG ("Trickle interval " << m_trickleInterval.GetSeconds () << " s, transmission in " << t.GetSeconds () << " s");
+
+      m_trickleTimer.Cancel ();
+      m_trickleTimer.Schedule (t);
+      m_htimer.Cancel ();
+      m_htimer.Schedule (m_trickleInterval);
+    }
+
+    void
+    RoutingProtocol::TrickleTimerExpire ()
+    {
+      if (m_trickleK != 0 && m_trickleCounter >= m_trickleK)
+        {
+          NS_LOG_DEBUG ("HELLO suppressed, heard " << m_trickleCounter << " consistent advertisements");
+          m_trickleSuppressed++;
+          return;
+        }
+      SendHello ();
+    }
+
+    void
+    RoutingProtocol::ResetTrickle ()
+    {
+      //An inconsistency shrinks the interval back to Imin, unless it already is there
+      if (!m_trickle || m_trickleInterval <= m_trickleImin)
+        {
+          return;
+        }
+      m_trickleInterval = m_trickleImin;
+      StartTrickleInterval ();
+    }
+
     bool
     RoutingProtocol::Forwarding(Ptr<const Packet> p, const Ipv4Header &header, Ipv4RoutingProtocol::UnicastForwardCallback ufcb, Ipv4RoutingProtocol::ErrorCallback errcb)
     {
@@ -429,76 +768,258 @@ RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit
    *   Hop Count                      0
    */
 
-      for(std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin(); j != m_socketAddresses.end (); ++j)
+      //In delta mode only the entries that changed since the last HELLO are
+      //advertised, and the whole table is refreshed every m_fullRefreshInterval rounds
+      bool fullRefresh = !m_deltaHello || (m_helloRound % m_fullRefreshInterval) == 0;
+      bool refreshHopSize = (m_helloRound % m_fullRefreshInterval) == 0;
+      m_helloRound++;
+
+      //Beacons flood their hop size when it changes, and refresh it every m_fullRefreshInterval rounds
+      double hopSize = GetHopSize ();
+      if (m_isBeacon && hopSize > 0 && (hopSize != m_advertisedHopSize || refreshHopSize))
         {
-          Ptr<Socket> socket = j->first;
-          Ipv4InterfaceAddress iface = j->second;
-          /*TODO: Remove the hardcoded position*/
+          m_advertisedHopSize = hopSize;
+          m_hopSizeSeqNo++;
+          NS_LOG_DEBUG ("Hop size " << hopSize);
+          //The originator address is filled per interface
+          SendHopSize (HopSizeHeader (Ipv4Address::GetAny (), m_hopSizeSeqNo, 0, hopSize));
+        }
+
+      //Entries start at generation 1, so a full refresh is every change since 0
+      uint32_t since = fullRefresh ? 0 : m_advertisedGeneration;
+      m_advertisedGeneration = m_disTable.GetGeneration ();
+      NS_LOG_DEBUG ("HELLO round " << m_helloRound << (fullRefresh ? " (full)" : " (delta)"));
+
+      SendEntries (since, m_isBeacon && fullRefresh);
+
+      //Beacons originate a new sequence number every time they advertise themselves
+      if (m_isBeacon && fullRefresh)
+        {
+          m_seqNo++;
+        }
+    }
+
+    void
+    RoutingProtocol::ScheduleTriggeredUpdate ()
+    {
+      if (!m_triggeredUpdates || m_triggerTimer.IsRunning ())
+        {
+          return;   //Disabled, or the pending update will carry this change too
+        }
+
+      //Jittered to desynchronize the neighbours, and never within the hold-down of the last one
+      Time delay = Seconds (m_URandom->GetValue (0, m_triggeredUpdateJitter.GetSeconds ()));
+      Time earliest = m_lastTriggeredUpdate + m_triggeredUpdateHoldDown;
+      if (Simulator::Now () + delay < earliest)
+        {
+          delay = earliest - Simulator::Now ();
+        }
+      NS_LOG_DEBUG ("Triggered update in " << delay.GetMilliSeconds () << " ms");
+      m_triggerTimer.Schedule (delay);
+    }
 
-          std::vector<Ipv4Address> knownBeacons = m_disTable.GetKnownBeacons ();
-          std::vector<Ipv4Address>::const_iterator addr;
-          for (addr = knownBeacons.begin (); addr != knownBeacons.end (); ++addr)
+    void
+    RoutingProtocol::SendTriggeredUpdate ()
+    {
+      uint32_t since = m_advertisedGeneration;
+      m_advertisedGeneration = m_disTable.GetGeneration ();
+      m_lastTriggeredUpdate = Simulator::Now ();
+      NS_LOG_DEBUG ("Triggered update");
+      SendEntries (since, false);
+    }
+
+    void
+    RoutingProtocol::SendEntries (uint32_t since, bool includeSelf)
+    {
+      //Collect the information of each beacon changed after 'since'. The buffer keeps
+      //its capacity between calls; the packets themselves are still allocated per send
+      m_entryBuffer.clear ();
+      if (IsMprRelay ())
+        {
+          m_disTable.ForEach ([this, since] (Ipv4Address beacon, BeaconInfo const &info)
             {
-              //Create a HELLO Packet for each known Beacon to this node
-              Position beaconPos = m_disTable.GetBeaconPosition (*addr);
-              FloodingHeader helloHeader(beaconPos.first,              //X Position
-                                         beaconPos.second,             //Y Position
-                                         m_seqNo++,                    //Sequence Numbr
-                                         m_disTable.GetHopsTo (*addr), //Hop Count
-                                         *addr);                       //Beacon Address
-              NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello...");
-              Ptr<Packet> packet = Create<Packet>();
-              packet->AddHeader (helloHeader);
-              // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-              Ipv4Address destination;
-              if (iface.GetMask () == Ipv4Mask::GetOnes ())
+              if (info.GetGeneration () > since)
                 {
-                  destination = Ipv4Address ("255.255.255.255");
+                  m_entryBuffer.push_back (FloodingHeader (info.GetPosition ().first,   //X Position
+                                                           info.GetPosition ().second,  //Y Position
+                                                           info.GetSeqNo (),            //Sequence Number, set by the beacon
+                                                           info.GetHops (),             //Hop Count
+                                                           beacon));                    //Beacon Address
                 }
-              else
-                {
-                  destination = iface.GetBroadcast ();
-                }
-              Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
-              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
-            }
+            });
+        }
+      NS_LOG_DEBUG (m_entryBuffer.size () << " entries to advertise");
+
+      for(std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin(); j != m_socketAddresses.end (); ++j)
+        {
+          Ptr<Socket> socket = j->first;
+          Ipv4InterfaceAddress iface = j->second;
 
           /*If this node is a beacon, it should broadcast its position always*/
           NS_LOG_DEBUG ("Node "<< iface.GetLocal () << " isBeacon? " << m_isBeacon);
-          if (m_isBeacon){
-              //Create a HELLO Packet for each known Beacon to this node
+          if (includeSelf){
               FloodingHeader helloHeader(m_xPosition,                 //X Position
                                          m_yPosition,                 //Y Position
-                                         m_seqNo++,                   //Sequence Numbr
+                                         m_seqNo,                     //Sequence Number
                                          0,                           //Hop Count
                                          iface.GetLocal ());          //Beacon Address
-              std::cout <<__FILE__<< __LINE__ << helloHeader << std::endl;
+              NS_LOG_LOGIC ("Advertising own position " << helloHeader);
+              m_entryBuffer.push_back (helloHeader);
+            }
 
-              NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello...");
-              Ptr<Packet> packet = Create<Packet>();
-              packet->AddHeader (helloHeader);
-              // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-              Ipv4Address destination;
-              if (iface.GetMask () == Ipv4Mask::GetOnes ())
-                {
-                  destination = Ipv4Address ("255.255.255.255");
-                }
-              else
+          if (m_entryBuffer.empty ())
+            {
+              continue;
+            }
+
+          NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello...");
+          if (m_helloFormat == AGGREGATED_HELLO)
+            {
+              SendAdvertisements (socket, iface, m_entryBuffer);
+            }
+          else
+            {
+              //Legacy format: create a HELLO Packet for each entry
+              for (std::vector<FloodingHeader>::iterator e = m_entryBuffer.begin (); e != m_entryBuffer.end (); ++e)
                 {
-                  destination = iface.GetBroadcast ();
+                  e->SetCompact (m_compactEncoding);
+                  e->SetResolution (m_positionResolution);
+                  Ptr<Packet> packet = Create<Packet>();
+                  packet->AddHeader (*e);
+                  if (m_compactEncoding)
+                    {
+                      packet->AddHeader (TypeHeader (DVHOPTYPE_COMPACT_FLOODING));
+                    }
+                  //else: a bare FloodingHeader, byte-identical to the original wire format
+                  m_helloTxTrace (packet, iface.GetLocal ());
+                  BroadcastWithJitter (socket, packet, iface);
                 }
-              Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
-              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+            }
 
+          if (includeSelf)
+            {
+              m_entryBuffer.pop_back ();
+            }
+        }
+    }
 
+    void
+    RoutingProtocol::SendAdvertisements (Ptr<Socket> socket, Ipv4InterfaceAddress iface, std::vector<FloodingHeader> const &entries)
+    {
+      //Room left in the frame once the IPv4 (20 bytes), UDP (8 bytes) and type headers are in place
+      int32_t interface = m_ipv4->GetInterfaceForAddress (iface.GetLocal ());
+      NS_ASSERT (interface >= 0);
+      uint32_t budget = m_ipv4->GetMtu (interface) - 20 - 8 - TypeHeader ().GetSerializedSize ();
+
+      MessageType type = m_compactEncoding ? DVHOPTYPE_COMPACT_ADVERTISEMENT : DVHOPTYPE_ADVERTISEMENT;
+      AdvertisementHeader advHeader;
+      advHeader.SetCompact (m_compactEncoding);
+      advHeader.SetResolution (m_positionResolution);
+      for (std::vector<FloodingHeader>::const_iterator e = entries.begin (); e != entries.end (); ++e)
+        {
+          if (advHeader.GetNEntries () > 0 &&
+              advHeader.GetSerializedSize () + advHeader.GetEntrySerializedSize (*e) > budget)
+            {
+              //This frame is full, send it and start the next one
+              Ptr<Packet> packet = Create<Packet>();
+              packet->AddHeader (advHeader);
+              packet->AddHeader (TypeHeader (type));
+              m_helloTxTrace (packet, iface.GetLocal ());
+              BroadcastWithJitter (socket, packet, iface);
+              advHeader.Clear ();
             }
+          advHeader.AddEntry (*e);
+        }
+
+      if (advHeader.GetNEntries () > 0)
+        {
+          Ptr<Packet> packet = Create<Packet>();
+          packet->AddHeader (advHeader);
+          packet->AddHeader (TypeHeader (type));
+          m_helloTxTrace (packet, iface.GetLocal ());
+          BroadcastWithJitter (socket, packet, iface);
         }
     }
 
+    void
+    RoutingProtocol::BroadcastWithJitter (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4InterfaceAddress iface)
+    {
+      // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
+      Ipv4Address destination;
+      if (iface.GetMask () == Ipv4Mask::GetOnes ())
+        {
+          destination = Ipv4Address ("255.255.255.255");
+        }
+      else
+        {
+          destination = iface.GetBroadcast ();
+        }
+      Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
+      Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+    }
+
+    bool
+    RoutingProtocol::IsMprRelay () const
+    {
+      //Until the neighbourhood is known, keep flooding
+      return !m_mprEnabled || m_neighbors.IsEmpty () || m_neighbors.HasMprSelectors ();
+    }
+
+    void
+    RoutingProtocol::NeighborHelloTimerExpire ()
+    {
+      SendNeighborHello ();
+      m_neighborTimer.Schedule (m_neighborHelloInterval);
+    }
+
+    void
+    RoutingProtocol::SendNeighborHello ()
+    {
+      m_neighbors.Purge (Simulator::Now ());
+      m_mprSet = m_neighbors.ComputeMprSet ();
+
+      std::vector<Ipv4Address> neighbors = m_neighbors.GetNeighbors ();
+      NeighborHelloHeader nHeader;
+      for (std::vector<Ipv4Address>::const_iterator n = neighbors.begin (); n != neighbors.end (); ++n)
+        {
+          nHeader.AddNeighbor (*n, m_mprSet.count (*n) != 0);
+        }
+
+      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+        {
+          Ptr<Packet> packet = Create<Packet> ();
+          packet->AddHeader (nHeader);
+          packet->AddHeader (TypeHeader (DVHOPTYPE_NEIGHBOR_HELLO));
+          m_helloTxTrace (packet, j->second.GetLocal ());
+          BroadcastWithJitter (j->first, packet, j->second);
+        }
+    }
+
+    void
+    RoutingProtocol::ProcessNeighborHello (Ipv4Address sender, NeighborHelloHeader const &nHeader)
+    {
+      std::vector<Ipv4Address> twoHop;
+      bool selectedUs = false;
+      for (uint16_t i = 0; i < nHeader.GetNNeighbors (); ++i)
+        {
+          Ipv4Address neighbor = nHeader.GetNeighbor (i);
+          if (m_ipv4->GetInterfaceForAddress (neighbor) >= 0)
+            {
+              selectedUs = selectedUs || nHeader.IsMpr (i);
+              continue;
+            }
+          twoHop.push_back (neighbor);
+        }
+      NS_LOG_LOGIC ("Neighbour HELLO from " << sender << ", selected as MPR? " << selectedUs);
+      m_neighbors.Update (sender, twoHop, selectedUs, Simulator::Now () + m_neighborHelloInterval * 3);
+    }
+
 
     void
     RoutingProtocol::SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination)
     {
+      m_controlPackets++;
+      m_controlBytes += packet->GetSize ();
       socket->SendTo (packet, 0, InetSocketAddress (destination, DVHOP_PORT));
     }
 
@@ -515,90 +1036,305 @@ RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit
       Ipv4Address sender = inetSourceAddr.GetIpv4 ();
       Ipv4Address receiver = m_socketAddresses[socket].GetLocal ();
 
-      std::cout << "sender:           " << sender;
-      std::cout << "receiver:         " << receiver;
-
-      FloodingHeader fHeader;
-      packet->RemoveHeader (fHeader);
-      UpdateHopsTo (fHeader.GetBeaconAddress (), fHeader.GetHopCount () + 1, fHeader.GetXPosition (), fHeader.GetYPosition ());
-      std::cout << "---Beacon Position--- IP: " << fHeader.GetBeaconAddress() << " | HopCount: " << fHeader.GetHopCount() + 1 << " | XPos: " << fHeader.GetXPosition() << " | YPos: " << fHeader.GetYPosition() << std::endl;
-      
-      uint32_t diff;
-      uint32_t newx = 0; 
-      uint32_t newy = 0;
-      
-
-      if(fHeader.GetBeaconAddress().Get() > receiver.Get()){
-        diff = fHeader.GetBeaconAddress().Get() - receiver.Get(); //Left and Up
-        newy = fHeader.GetYPosition() - (50 * std::floor(diff / 10));
-        std::cout << "DEBUG--- Y decrease " << (50 * std::floor(diff / 10)) << std::endl;
-        if((fHeader.GetBeaconAddress().Get() % 10) <= (diff % 10)){
-          newy -= 50;
-          newx = fHeader.GetXPosition() + (50 * (((receiver.Get()) % 10) - ((fHeader.GetBeaconAddress().Get()) % 10)));
-          std::cout << "DEBUG--- Y decrease 50, X increase " << (int) (50 * (((receiver.Get()) % 10) - ((fHeader.GetBeaconAddress().Get()) % 10))) << std::endl;
-        } else {
-          newx = fHeader.GetXPosition() - (50 * (diff % 10));
-          std::cout << "DEBUG--- X decrease " << 50 * (diff % 10)<< std::endl;
-        }
-      }else{
-        diff = receiver.Get() - fHeader.GetBeaconAddress().Get(); //Right and Down
-        newy = fHeader.GetYPosition() + (50 * std::floor(diff / 10));
-        if((fHeader.GetBeaconAddress().Get() % 10) <= (diff % 10)){
-          newy += 50;
-          newx = fHeader.GetXPosition() - (50 * (((receiver.Get()) % 10) + ((fHeader.GetBeaconAddress().Get()) % 10)));
-          std::cout << "DEBUG--- Y increase 50, X decrease " << (int) (50 * (((receiver.Get()) % 10) + ((fHeader.GetBeaconAddress().Get()) % 10))) << std::endl;
-        } else {
-          newx = fHeader.GetXPosition() + (50 * (diff % 10));
-          std::cout << "DEBUG--- X increase " << 50 * (diff % 10)<< std::endl;
-        }
-      }
-
-      Ptr<Node> thisNode = socket ->GetNode();
-      uint32_t nodeId = thisNode->GetId();
-      std::cout << "Difference: " << diff << std::endl;
-      std::cout << "Node ID: "<< nodeId << std::endl;
-      std::cout << "---Node's position--- XPos: " << newx << " | YPos: " << newy << std::endl;
-
-      
-
-      point approx;
-      point p1 = {250,400};
-      point p2 = {150,200};
-      point p3 = {350,150};
-      double r1, r2, r3;
-      r1 = 350;
-      r2 = 200;
-      r3 = 350;
-
-      approx = trilateration(p1, p2, p3, r1, r2, r3);
-      std::cout << "TRILATERATION TEST: (" << approx.x << ", " << approx.y << ")" << std::endl; 
-      std::cout << "------------------------------------" << std::endl;
-    }
-    //TRILATERATION
-
-      float RoutingProtocol::norm(point p){
-        return pow(pow(p.x,2)+pow(p.y,2),.5);
-      }
-
-      point RoutingProtocol::trilateration(point p1, point p2, point p3, double r1, double r2, double r3){
-        point result;
-        double p2p = pow(pow(p2.x-p1.x,2) + pow(p2.y-p1.y,2),0.5);
-        point ex = {(p2.x-p1.x)/p2p, (p2.y-p1.y)/p2p};
-        point aux = {p3.x-p1.x,p3.y-p1.y};
-        double i = ex.x * aux.x + ex.y * aux.y;
-        point aux2 = {p3.x-p1.x-i*ex.x, p3.y-p1.y-i*ex.y};
-        point ey = {aux2.x / norm(aux2), aux2.y / norm(aux2)};
-
-        double j = ey.x * aux.x + ey.y * aux.y;
-        double x = (pow(r1,2) - pow(r2,2) + pow(p2p,2)) / (2 * p2p);
-        double y = (pow(r1,2) - pow(r3,2) + pow(i,2) + pow(j,2)) / (2*j) - i*x/j;
-
-        double finX = p1.x + x*ex.x + y*ey.x;
-        double finY = p1.y + x*ex.y + y*ey.y;
-        result.x = finX;
-        result.y = finY;
-        return result;
-      }
+      NS_LOG_DEBUG ("DV-Hop packet " << packet->GetUid () << " from " << sender << " to " << receiver);
+
+      //An advertisement that changes nothing in the table is consistent for Trickle
+      uint32_t generation = m_disTable.GetGeneration ();
+
+      TypeHeader tHeader;
+      packet->PeekHeader (tHeader);
+      //Legacy HELLOs are a bare FloodingHeader: its first byte is the top of the
+      //x coordinate, which is never a valid message type for real-world coordinates
+      bool legacy = !tHeader.IsValid () && packet->GetSize () == FloodingHeader ().GetSerializedSize ();
+      if (!tHeader.IsValid () && !legacy)
+        {
+          NS_LOG_DEBUG ("DV-Hop message " << packet->GetUid () << " with unknown type received. Drop");
+          return;
+        }
+      MessageType type = legacy ? DVHOPTYPE_FLOODING : tHeader.Get ();
+      if (type != DVHOPTYPE_NEIGHBOR_HELLO && type != DVHOPTYPE_HOP_SIZE)
+        {
+          m_advertisementRxTrace (packet, sender);
+        }
+      if (!legacy)
+        {
+          packet->RemoveHeader (tHeader);
+        }
+
+      switch (type)
+        {
+        case DVHOPTYPE_FLOODING:
+        case DVHOPTYPE_COMPACT_FLOODING:
+          {
+            FloodingHeader fHeader;
+            fHeader.SetCompact (type == DVHOPTYPE_COMPACT_FLOODING);
+            packet->RemoveHeader (fHeader);
+            if (!m_dupCache.IsFresh (fHeader.GetBeaconAddress (), fHeader.GetSequenceNumber (), fHeader.GetHopCount ()))
+              {
+                NS_LOG_LOGIC ("Stale advertisement of " << fHeader.GetBeaconAddress () << ", seqNo " << fHeader.GetSequenceNumber ());
+                m_earlyDropTrace (fHeader.GetBeaconAddress (), fHeader.GetSequenceNumber (), fHeader.GetHopCount ());
+                m_earlyDroppedEntries++;
+                m_earlyDroppedPackets++;
+                m_trickleCounter++;
+                return;
+              }
+            ProcessFlooding (fHeader);
+            break;
+          }
+        case DVHOPTYPE_ADVERTISEMENT:
+        case DVHOPTYPE_COMPACT_ADVERTISEMENT:
+          {
+            AdvertisementHeader advHeader;
+            advHeader.SetCompact (type == DVHOPTYPE_COMPACT_ADVERTISEMENT);
+            packet->RemoveHeader (advHeader);
+            uint16_t fresh = 0;
+            for (uint16_t i = 0; i < advHeader.GetNEntries (); ++i)
+              {
+                FloodingHeader const &entry = advHeader.GetEntry (i);
+                if (!m_dupCache.IsFresh (entry.GetBeaconAddress (), entry.GetSequenceNumber (), entry.GetHopCount ()))
+                  {
+                    m_earlyDropTrace (entry.GetBeaconAddress (), entry.GetSequenceNumber (), entry.GetHopCount ());
+                    m_earlyDroppedEntries++;
+                    continue;
+                  }
+                fresh++;
+                ProcessFlooding (entry);
+              }
+            if (fresh == 0)
+              {
+                NS_LOG_LOGIC ("Every entry of the advertisement is stale");
+                m_earlyDroppedPackets++;
+                m_trickleCounter++;
+                return;
+              }
+            break;
+          }
+        case DVHOPTYPE_NEIGHBOR_HELLO:
+          {
+            NeighborHelloHeader nHeader;
+            packet->RemoveHeader (nHeader);
+            ProcessNeighborHello (sender, nHeader);
+            return;
+          }
+        case DVHOPTYPE_HOP_SIZE:
+          {
+            HopSizeHeader hHeader;
+            packet->RemoveHeader (hHeader);
+            ProcessHopSize (hHeader);
+            return;
+          }
+        }
+
+      if (m_disTable.GetGeneration () == generation)
+        {
+          m_trickleCounter++;
+        }
+
+    }
+
+    void
+    RoutingProtocol::ProcessFlooding (FloodingHeader const &fHeader)
+    {
+      NS_LOG_LOGIC ("Beacon " << fHeader.GetBeaconAddress () << " at (" << fHeader.GetXPosition () << ", " << fHeader.GetYPosition ()
+                    << "), " << fHeader.GetHopCount () + 1 << " hops");
+      UpdateHopsTo (fHeader.GetBeaconAddress (), fHeader.GetHopCount () + 1, fHeader.GetXPosition (), fHeader.GetYPosition (), fHeader.GetSequenceNumber ());
+    }
+
+    double
+    RoutingProtocol::GetHopSize () const
+    {
+      if (m_isBeacon)
+        {
+          return m_hopSizeHops > 0 ? m_hopSizeDistance / m_hopSizeHops : 0;
+        }
+      return m_hopSize;
+    }
+
+    void
+    RoutingProtocol::BeaconRemoved (Ipv4Address beacon, uint16_t hops, Position pos)
+    {
+      m_tableUpdateTrace (beacon, hops, 0);
+      m_tableSize = m_disTable.GetSize ();
+      if (m_isBeacon)
+        {
+          m_hopSizeDistance -= std::hypot (pos.first - m_xPosition, pos.second - m_yPosition);
+          m_hopSizeHops -= hops;
+        }
+      else
+        {
+          m_localization.RemoveBeacon (pos.first, pos.second, hops);
+          m_localizationUpdates++;
+          InvalidateEstimate (0);
+        }
+      if (beacon == m_hopSizeSource)
+        {
+          //The source of the hop size is gone, the next correction is taken from whoever sends it
+          m_hopSizeSourceHops = 0xffff;
+        }
+    }
+
+    void
+    RoutingProtocol::SendHopSize (HopSizeHeader const &hHeader)
+    {
+      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+        {
+          HopSizeHeader header = hHeader;
+          if (hHeader.GetBeaconAddress () == Ipv4Address::GetAny ())
+            {
+              header = HopSizeHeader (j->second.GetLocal (), hHeader.GetSequenceNumber (), hHeader.GetHopCount (), hHeader.GetHopSize ());
+            }
+          Ptr<Packet> packet = Create<Packet> ();
+          packet->AddHeader (header);
+          packet->AddHeader (TypeHeader (DVHOPTYPE_HOP_SIZE));
+          m_helloTxTrace (packet, j->second.GetLocal ());
+          BroadcastWithJitter (j->first, packet, j->second);
+        }
+    }
+
+    void
+    RoutingProtocol::ProcessHopSize (HopSizeHeader const &hHeader)
+    {
+      //Beacons use their own hop size, so the flood of a correction stops at them
+      if (m_isBeacon || m_ipv4->GetInterfaceForAddress (hHeader.GetBeaconAddress ()) >= 0)
+        {
+          return;
+        }
+
+      //Take, and relay, only the corrections of the nearest beacon heard so far
+      uint16_t hops = hHeader.GetHopCount () + 1;
+      bool accept;
+      if (hHeader.GetBeaconAddress () == m_hopSizeSource)
+        {
+          accept = SeqNoIsNewer (hHeader.GetSequenceNumber (), m_hopSizeSeqNo)
+                   || (hHeader.GetSequenceNumber () == m_hopSizeSeqNo && hops < m_hopSizeSourceHops);
+        }
+      else
+        {
+          accept = hops < m_hopSizeSourceHops;
+        }
+      if (!accept)
+        {
+          NS_LOG_LOGIC ("Hop size of " << hHeader.GetBeaconAddress () << " dropped, " << m_hopSizeSource << " is nearer");
+          return;
+        }
+
+      bool changed = m_hopSize != hHeader.GetHopSize ();
+      m_hopSize = hHeader.GetHopSize ();
+      m_hopSizeSource = hHeader.GetBeaconAddress ();
+      m_hopSizeSourceHops = hops;
+      m_hopSizeSeqNo = hHeader.GetSequenceNumber ();
+      NS_LOG_DEBUG ("Hop size " << m_hopSize << " from " << m_hopSizeSource << ", " << hops << " hops away");
+
+      if (changed)
+        {
+          InvalidateEstimate (0);
+        }
+
+      HopSizeHeader relayed = hHeader;
+      relayed.SetHopCount (hops);
+      SendHopSize (relayed);
+    }
+
+    void
+    RoutingProtocol::InvalidateEstimate (uint32_t hopChange)
+    {
+      //0 when the beacon set or the hop size changed, which always gives a new estimate
+      if (hopChange == 0)
+        {
+          m_estimateStale = true;
+        }
+      else
+        {
+          m_pendingHopChange += hopChange;
+        }
+      if (!m_estimateInterval.IsZero () && !m_estimateTimer.IsRunning ())
+        {
+          m_estimateTimer.Schedule (m_estimateInterval);
+        }
+    }
+
+    void
+    RoutingProtocol::UpdateEstimate () const
+    {
+      if (!m_estimateStale && (m_pendingHopChange == 0 || (m_localized && m_pendingHopChange < m_estimateHysteresis)))
+        {
+          return;
+        }
+      bool reseed = m_estimateStale;
+      m_estimateStale = false;
+      m_pendingHopChange = 0;
+      EstimatePosition (reseed);
+    }
+
+    void
+    RoutingProtocol::EstimatePosition (bool reseed) const
+    {
+      double hopSize = GetHopSize ();
+      if (m_isBeacon || hopSize <= 0)
+        {
+          return;
+        }
+
+      //Out of the range of the precision, the system has no solution until it is rebuilt,
+      //which may fit again once a far beacon is gone
+      if (m_localizationUpdates >= m_localizationRefresh || (!m_localization.IsInRange () && m_localizationUpdates > 0))
+        {
+          RebuildLocalization ();
+        }
+
+      //Warm start only when the ranges alone changed: the previous estimate is then usually a
+      //step or two away. A new beacon set or hop size can move the optimum anywhere
+      double x, y;
+      bool warm = m_refinement && m_localized && !reseed && m_localization.GetNBeacons () >= 3;
+      if (warm)
+        {
+          x = estimatedPosition.Get ().x;
+          y = estimatedPosition.Get ().y;
+        }
+      else if (!m_localization.Solve (hopSize, x, y))
+        {
+          return;
+        }
+
+      if (m_refinement)
+        {
+          Refinement refinement = m_localization.Refine (m_disTable, hopSize, m_refinementIterations, m_refinementTolerance, x, y);
+          m_lastRefinementIterations = refinement.iterations;
+          double sx, sy;
+          if (warm && refinement.cost > m_refinedCost && m_localization.Solve (hopSize, sx, sy))
+            {
+              //Worse than the last estimate: start again from the linear solution, keep the better
+              Refinement cold = m_localization.Refine (m_disTable, hopSize, m_refinementIterations, m_refinementTolerance, sx, sy);
+              m_lastRefinementIterations += cold.iterations;
+              if (cold.cost < refinement.cost)
+                {
+                  x = sx;
+                  y = sy;
+                  refinement = cold;
+                }
+            }
+          m_refinedCost = refinement.cost;
+          m_refinementIterationsTotal += m_lastRefinementIterations;
+          m_refinements++;
+        }
+      Vector estimate (x, y, 0.0);
+      estimatedPosition = estimate;
+      m_localized = true;
+      NS_LOG_DEBUG ("Position estimated from " << m_localization.GetNBeacons () << " beacons: " << estimate);
+      m_estimateUpdateTrace (estimate, m_localization.GetNBeacons ());
+    }
+
+    void
+    RoutingProtocol::RebuildLocalization () const
+    {
+      m_localization.Reset ();
+      m_disTable.ForEach ([this] (Ipv4Address beacon, BeaconInfo const &info)
+        {
+          m_localization.AddBeacon (info.GetPosition ().first, info.GetPosition ().second, info.GetHops ());
+        });
+      m_localizationUpdates = 0;
+    }
+
     Ptr<Socket>
     RoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr) const
     {
@@ -616,7 +1352,7 @@ RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit
     }
 
     void
-    RoutingProtocol::UpdateHopsTo (Ipv4Address beacon, uint16_t newHops, double x, double y)
+    RoutingProtocol::UpdateHopsTo (Ipv4Address beacon, uint16_t newHops, double x, double y, uint16_t seqNo)
     {
       uint16_t oldHops = m_disTable.GetHopsTo (beacon);
       if (m_ipv4->GetInterfaceForAddress (beacon) >= 0){
@@ -624,10 +1360,72 @@ RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit
           return;
         }
 
+      uint16_t oldSeqNo = m_disTable.GetSequenceNumber (beacon);
+      Position oldPos = m_disTable.GetBeaconPosition (beacon);
+      bool newer = oldHops != 0 && SeqNoIsNewer (seqNo, oldSeqNo);
       if( oldHops > newHops || oldHops == 0){ //Update only when a shortest path is found'
-        std::cout << "-----DEBUG: NEW SHORTEST PATH-----" << std::endl;
-        m_disTable.AddBeacon (beacon, newHops, x, y);
+        NS_LOG_LOGIC ("Shorter path to " << beacon << ": " << newHops << " hops, was " << oldHops);
+        if (oldHops != 0 && !newer)
+          {
+            seqNo = oldSeqNo;   //Never go back to an older sequence number
+          }
+        if (!m_disTable.AddBeacon (beacon, newHops, x, y, seqNo))
+          {
+            NS_LOG_LOGIC ("Beacon " << beacon << " is out of the horizon");
+            return;
+          }
+        if (newer)
+          {
+            m_disTable.MoveBeacon (beacon, x, y);
+          }
+        m_tableUpdateTrace (beacon, oldHops, newHops);
+        m_tableSize = m_disTable.GetSize ();
+        BeaconChanged (oldHops, oldPos, newHops, m_disTable.GetBeaconPosition (beacon));
+        ScheduleTriggeredUpdate ();
+        ResetTrickle ();
 	}
+      else if (newer)
+        {
+          m_disTable.RefreshBeacon (beacon, seqNo);
+          if (m_disTable.MoveBeacon (beacon, x, y))
+            {
+              NS_LOG_LOGIC ("Beacon " << beacon << " moved to (" << x << ", " << y << ")");
+              m_tableUpdateTrace (beacon, oldHops, oldHops);
+              BeaconChanged (oldHops, oldPos, oldHops, m_disTable.GetBeaconPosition (beacon));
+              ScheduleTriggeredUpdate ();
+              ResetTrickle ();
+            }
+        }
+    }
+
+    void
+    RoutingProtocol::BeaconChanged (uint16_t oldHops, Position oldPos, uint16_t newHops, Position newPos)
+    {
+      bool moved = oldHops != 0 && newPos != oldPos;
+      if (m_isBeacon)
+        {
+          //Keep the hop size sums up to date: the distance only changes for a new or moved beacon
+          if (oldHops == 0 || moved)
+            {
+              if (moved)
+                {
+                  m_hopSizeDistance -= std::hypot (oldPos.first - m_xPosition, oldPos.second - m_yPosition);
+                }
+              m_hopSizeDistance += std::hypot (newPos.first - m_xPosition, newPos.second - m_yPosition);
+            }
+          m_hopSizeHops += newHops - oldHops;
+        }
+      else
+        {
+          //Rank-one updates of the localization system: out with the old entry, in with the new
+          if (oldHops != 0)
+            {
+              m_localization.RemoveBeacon (oldPos.first, oldPos.second, oldHops);
+            }
+          m_localization.AddBeacon (newPos.first, newPos.second, newHops);
+          m_localizationUpdates++;
+          InvalidateEstimate (oldHops != 0 && !moved ? oldHops - newHops : 0);
+        }
     }
 
 }
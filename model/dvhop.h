@@ -13,25 +13,56 @@
 #include "ns3/timer.h"
 #include "ns3/packet.h"
 #include "ns3/ipv4-header.h"
+#include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
 
 #include "distance-table.h"
+#include "dvhop-packet.h"
+#include "duplicate-cache.h"
+#include "neighbor-table.h"
+#include "dvhop-localization.h"
 
 #include <map>
+#include <set>
 #include <cmath>
 
-struct point{
-  double x, y;
-};
-
 namespace ns3 {
   namespace dvhop{
 
     class RoutingProtocol : public Ipv4RoutingProtocol{
     public:
+      /// Wire format used to advertise the DistanceTable
+      enum HelloFormat
+      {
+        LEGACY_HELLO,      //!< One bare FloodingHeader packet per known beacon, the original format
+        AGGREGATED_HELLO,  //!< AdvertisementHeader packets filled up to the interface MTU
+      };
+
       static const uint32_t DVHOP_PORT;
       static TypeId GetTypeId (void);
+
+      /**
+       * @brief Signatures of the trace sources
+       */
+      //{
+      /// HelloTx and AdvertisementRx: the DV-Hop packet, and the local address or the sender
+      typedef void (* PacketTracedCallback)(Ptr<const Packet> packet, Ipv4Address address);
+      /// TableUpdate: oldHops is 0 for a new beacon, newHops 0 for a removed one, both equal for a moved one
+      typedef void (* TableUpdateTracedCallback)(Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+      /// EstimateUpdate: the new estimate and the number of beacons behind it
+      typedef void (* EstimateUpdateTracedCallback)(Vector position, uint32_t nBeacons);
+      /// EarlyDrop: the stale entry dropped by the duplicate cache
+      typedef void (* EarlyDropTracedCallback)(Ipv4Address beacon, uint16_t seqNo, uint16_t hops);
+      /// Estimate TracedValue
+      typedef void (* VectorTracedCallback)(Vector oldValue, Vector newValue);
+      //}
+
+      //Position given by the mobility model of the node
       Vector GetRealPosition() const;
-       Vector GetPosition() const;
+      //Estimated position: the beacon position for beacons, the least-squares estimate otherwise
+      Vector GetPosition() const;
+      //false until a non-beacon node has ranges to 3 beacons that are not collinear
+      bool   IsLocalized() const;
 
       RoutingProtocol();
       virtual ~RoutingProtocol();
@@ -67,10 +98,40 @@ namespace ns3 {
 
       void  PrintDistances(Ptr<OutputStreamWrapper> stream, Ptr<Node> node) const;
 
+      //Interns the beacons of the DistanceTable in an arena shared with other nodes, before the protocol starts
+      void  SetTableArena(Ptr<DistanceTableArena> arena) { m_disTable.UseArena (arena); }
+      DistanceTable const & GetDistanceTable() const     { return m_disTable; }
+
+      //Average distance covered by one hop: computed by beacons, learnt from the nearest beacon
+      //by the other nodes. 0 while unknown
+      double GetHopSize () const;
+
+      //DV-Hop packets and bytes (DV-Hop headers only) sent by this node
+      uint32_t GetControlPacketsSent () const { return m_controlPackets; }
+      uint64_t GetControlBytesSent () const   { return m_controlBytes; }
+
+      //true if this node re-advertises the beacons learnt from others: always with plain
+      //flooding, only when some neighbour selected it as multipoint relay otherwise
+      bool     IsMprRelay () const;
+      uint32_t GetMprSetSize () const         { return m_mprSet.size (); }
+
+      //Iterations of the last refinement of the estimate, a restart from the linear solution
+      //included, and of all of them
+      uint32_t GetLastRefinementIterations () const { return m_lastRefinementIterations; }
+      uint64_t GetRefinementIterations () const     { return m_refinementIterationsTotal; }
+      uint32_t GetRefinements () const              { return m_refinements; }
+
+      //Advertisement entries, and whole packets, dropped by the duplicate cache before any table work
+      uint32_t GetEarlyDroppedEntries () const { return m_earlyDroppedEntries; }
+      uint32_t GetEarlyDroppedPackets () const { return m_earlyDroppedPackets; }
+
+      //Current Trickle interval, and HELLOs suppressed by TrickleK so far
+      Time     GetTrickleInterval () const     { return m_trickleInterval; }
+      uint32_t GetSuppressedHellos () const    { return m_trickleSuppressed; }
+
     private:
       //Start protocol operation
-      Vector realPosition;
-      Vector estimatedPosition;
+      mutable TracedValue<Vector> estimatedPosition;
       void        Start    ();
       void        SendTo   (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
       void        RecvDvhop(Ptr<Socket> socket);
@@ -79,18 +140,80 @@ namespace ns3 {
       bool        Forwarding(Ptr<const Packet> p, const Ipv4Header &header, UnicastForwardCallback ufcb, ErrorCallback errcb);
       void        SendUnicastTo(Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
 
-      float norm(point p);
-      point trilateration(point b1, point b2, point b3, double r1, double r2, double r3);
-
       //HELLO intervals and timers
       Time   HelloInterval;
       Timer  m_htimer;
       void   SendHello();
       void   HelloTimerExpire();
+      //Format of the HELLO messages
+      HelloFormat m_helloFormat;
+      //Delta HELLOs: only changed entries, the whole table every m_fullRefreshInterval rounds
+      bool        m_deltaHello;
+      uint32_t    m_fullRefreshInterval;
+      uint32_t    m_helloRound;
+      uint32_t    m_advertisedGeneration;   //DistanceTable generation already advertised
+
+      //Triggered updates: shorter paths are advertised right away, at most once per hold-down
+      bool   m_triggeredUpdates;
+      Time   m_triggeredUpdateJitter;
+      Time   m_triggeredUpdateHoldDown;
+      Timer  m_triggerTimer;
+      Time   m_lastTriggeredUpdate;
+      void   ScheduleTriggeredUpdate ();
+      void   SendTriggeredUpdate ();
+
+      //Trickle timer (RFC 6206) driving the HELLOs instead of the fixed HelloInterval
+      bool     m_trickle;
+      Time     m_trickleImin;
+      Time     m_trickleImax;
+      uint32_t m_trickleK;
+      Time     m_trickleInterval;      //Current interval I
+      uint32_t m_trickleCounter;       //Consistent advertisements heard in this interval
+      Timer    m_trickleTimer;         //Fires at t, somewhere in [I/2, I)
+      uint32_t m_trickleSuppressed;
+      void     StartTrickleInterval ();
+      void     TrickleTimerExpire ();
+      void     ResetTrickle ();
+
+      //Control traffic counters
+      uint32_t m_controlPackets;
+      uint64_t m_controlBytes;
+
+      //Multipoint relays: neighbour HELLOs discover the 2-hop neighbourhood, and only
+      //the neighbours selected as MPR by someone re-advertise the beacons
+      bool                  m_mprEnabled;
+      Time                  m_neighborHelloInterval;
+      Timer                 m_neighborTimer;
+      NeighborTable         m_neighbors;
+      std::set<Ipv4Address> m_mprSet;
+      void   NeighborHelloTimerExpire ();
+      void   SendNeighborHello ();
+      void   ProcessNeighborHello (Ipv4Address sender, NeighborHelloHeader const &nHeader);
+
+      bool        m_compactEncoding;
+      uint16_t    m_positionResolution;
+      std::vector<FloodingHeader> m_entryBuffer;   //Reused by SendEntries
+      void   SendEntries (uint32_t since, bool includeSelf);
+      void   SendAdvertisements (Ptr<Socket> socket, Ipv4InterfaceAddress iface, std::vector<FloodingHeader> const &entries);
+      void   BroadcastWithJitter (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4InterfaceAddress iface);
+      void   ProcessFlooding (FloodingHeader const &fHeader);
 
       //Table to store the hopCount to each beacon
       DistanceTable  m_disTable;
-      void UpdateHopsTo (Ipv4Address beacon, uint16_t hops, double x, double y);
+      uint32_t       m_maxBeacons;      //Horizon of the table, 0 for no limit
+      uint16_t       m_maxHopRadius;
+      //Entries not refreshed for m_beaconLifetime are expired by one periodic timer
+      Time           m_beaconLifetime;
+      Timer          m_expiryTimer;
+      void ExpiryTimerExpire ();
+      void UpdateHopsTo (Ipv4Address beacon, uint16_t hops, double x, double y, uint16_t seqNo);
+      //Moves a beacon entry of the hop size sums, or of the localization system, to its new hops and position
+      void BeaconChanged (uint16_t oldHops, Position oldPos, uint16_t newHops, Position newPos);
+
+      //Freshest advertisement seen for each beacon, to drop duplicates early
+      DuplicateCache m_dupCache;
+      uint32_t       m_earlyDroppedEntries;
+      uint32_t       m_earlyDroppedPackets;
 
 
       //Boolean to identify if this node acts as a Beacon
@@ -105,7 +228,60 @@ namespace ns3 {
       // Raw socket per each IP interface, map socket -> iface address (IP + mask)
       std::map< Ptr<Socket>, Ipv4InterfaceAddress > m_socketAddresses;
 
-      uint32_t    m_seqNo;
+      //Sequence number of the advertisements originated by this node, when it is a beacon
+      uint16_t    m_seqNo;
+
+      //Hop size. Beacons keep the sums of the distances and hops to the other beacons in
+      //the table, updated with each entry; other nodes take the value flooded by the
+      //nearest beacon, and only relay the corrections they accept
+      double      m_hopSizeDistance;
+      uint32_t    m_hopSizeHops;
+      double      m_advertisedHopSize;
+      double      m_hopSize;
+      Ipv4Address m_hopSizeSource;
+      uint16_t    m_hopSizeSourceHops;
+      uint16_t    m_hopSizeSeqNo;
+      void   BeaconRemoved (Ipv4Address beacon, uint16_t hops, Position pos);
+      void   SendHopSize (HopSizeHeader const &hHeader);
+      void   ProcessHopSize (HopSizeHeader const &hHeader);
+
+      //Least-squares position estimate from every beacon in the table. The normal equations
+      //follow the table one entry at a time, and are rebuilt every m_localizationRefresh updates.
+      //The estimate is a cache solved from the const getters, hence the mutable state
+      mutable LocalizationSolver m_localization;
+      mutable bool m_localized;
+      LocalizationSolver::Precision m_precision;
+      uint32_t     m_localizationRefresh;
+      mutable uint32_t m_localizationUpdates;
+      //The estimate itself is lazy: table changes only mark it out of date, and it is solved
+      //when read, or m_estimateInterval after the first change. Hop changes summing up to
+      //less than m_estimateHysteresis keep the current estimate
+      Time         m_estimateInterval;
+      Timer        m_estimateTimer;
+      uint32_t     m_estimateHysteresis;
+      mutable bool m_estimateStale;               //The beacon set or the hop size changed
+      mutable uint32_t m_pendingHopChange;        //Hop changes since the last estimate
+      //Levenberg-Marquardt refinement of the estimate
+      bool         m_refinement;
+      uint32_t     m_refinementIterations;
+      double       m_refinementTolerance;
+      mutable uint32_t m_lastRefinementIterations;
+      mutable uint64_t m_refinementIterationsTotal;
+      mutable uint32_t m_refinements;
+      mutable double m_refinedCost;               //Cost of the last refined estimate
+      void         InvalidateEstimate (uint32_t hopChange);
+      void         UpdateEstimate () const;
+      //Solves from scratch with reseed, else refines the last estimate when there is one
+      void         EstimatePosition (bool reseed) const;
+      void         RebuildLocalization () const;
+
+      //Trace sources, costless while nothing is connected
+      TracedCallback<Ptr<const Packet>, Ipv4Address>  m_helloTxTrace;
+      TracedCallback<Ptr<const Packet>, Ipv4Address>  m_advertisementRxTrace;
+      TracedCallback<Ipv4Address, uint16_t, uint16_t> m_tableUpdateTrace;
+      TracedCallback<Vector, uint32_t>                m_estimateUpdateTrace;
+      TracedCallback<Ipv4Address, uint16_t, uint16_t> m_earlyDropTrace;
+      TracedValue<uint32_t>                           m_tableSize;
 
 
 
@@ -0,0 +1,295 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "grid-spectrum-channel.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/net-device.h"
+#include "ns3/antenna-model.h"
+#include "ns3/angles.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/spectrum-propagation-loss-model.h"
+
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("DVHopGridSpectrumChannel");
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    NS_OBJECT_ENSURE_REGISTERED (GridSpectrumChannel);
+
+    TypeId
+    GridSpectrumChannel::GetTypeId (void)
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::GridSpectrumChannel")
+          .SetParent<SpectrumChannel> ()
+          .AddConstructor<GridSpectrumChannel> ()
+          .AddAttribute ("Cutoff",
+                         "Receivers farther than this from the transmitter are never reached. "
+                         "Zero visits every PHY, as SingleModelSpectrumChannel.",
+                         DoubleValue (0),
+                         MakeDoubleAccessor (&GridSpectrumChannel::SetCutoff, &GridSpectrumChannel::GetCutoff),
+                         MakeDoubleChecker<double> (0))
+          .AddAttribute ("CacheLosses",
+                         "Compute the path loss and delay of each transmitter-receiver pair once, "
+                         "until one of them moves. Disable for random loss models.",
+                         BooleanValue (true),
+                         MakeBooleanAccessor (&GridSpectrumChannel::m_cacheLosses),
+                         MakeBooleanChecker ());
+      return tid;
+    }
+
+    GridSpectrumChannel::GridSpectrumChannel () :
+      m_cutoff (0),
+      m_cacheLosses (true),
+      m_indexValid (false)
+    {
+    }
+
+    void
+    GridSpectrumChannel::DoDispose (void)
+    {
+      m_phyList.clear ();
+      m_phyIndex.clear ();
+      m_mobilities.clear ();
+      m_grid.Clear ();
+      m_unplaced.clear ();
+      m_links.clear ();
+      m_spectrumModel = 0;
+      SpectrumChannel::DoDispose ();
+    }
+
+    void
+    GridSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+    {
+      if (m_phyIndex.find (phy) != m_phyIndex.end ())
+        {
+          return;
+        }
+      m_phyIndex[phy] = m_phyList.size ();
+      m_phyList.push_back (phy);
+      m_mobilities.push_back (0);
+      m_indexValid = false;
+    }
+
+    std::size_t
+    GridSpectrumChannel::GetNDevices (void) const
+    {
+      return m_phyList.size ();
+    }
+
+    Ptr<NetDevice>
+    GridSpectrumChannel::GetDevice (std::size_t i) const
+    {
+      return m_phyList.at (i)->GetDevice ()->GetObject<NetDevice> ();
+    }
+
+    void
+    GridSpectrumChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+    {
+      m_indexValid = false;
+    }
+
+    void
+    GridSpectrumChannel::SetCutoff (double cutoff)
+    {
+      m_cutoff = cutoff;
+      m_indexValid = false;
+    }
+
+    double
+    GridSpectrumChannel::GetCutoff (void) const
+    {
+      return m_cutoff;
+    }
+
+    void
+    GridSpectrumChannel::BuildIndex (void)
+    {
+      m_grid.Clear ();
+      m_unplaced.clear ();
+      m_links.clear ();
+      for (uint32_t i = 0; i < m_phyList.size (); ++i)
+        {
+          Ptr<MobilityModel> mobility = m_phyList[i]->GetMobility ();
+          if (mobility != m_mobilities[i])
+            {
+              //Set after AddRx, or replaced: follow the new one
+              if (mobility)
+                {
+                  mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&GridSpectrumChannel::CourseChanged, this));
+                }
+              m_mobilities[i] = mobility;
+            }
+          if (!mobility || m_cutoff <= 0)
+            {
+              m_unplaced.push_back (i);
+              continue;
+            }
+          Vector pos = mobility->GetPosition ();
+          m_grid.Add (i, pos.x, pos.y);
+        }
+      if (m_cutoff > 0)
+        {
+          m_grid.Build (m_cutoff);
+        }
+      m_indexValid = true;
+      NS_LOG_DEBUG (m_phyList.size () << " PHYs in " << m_grid.GetNCells () << " cells");
+    }
+
+    void
+    GridSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> txParams)
+    {
+      NS_LOG_FUNCTION (this << txParams);
+      NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+      NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+
+      if (m_spectrumModel == 0)
+        {
+          m_spectrumModel = txParams->psd->GetSpectrumModel ();
+        }
+      else
+        {
+          NS_ASSERT (*(txParams->psd->GetSpectrumModel ()) == *m_spectrumModel);
+        }
+      if (!m_indexValid)
+        {
+          BuildIndex ();
+        }
+
+      std::map<Ptr<const SpectrumPhy>, uint32_t>::const_iterator sender = m_phyIndex.find (txParams->txPhy);
+      NS_ASSERT_MSG (sender != m_phyIndex.end (), "Transmitter not attached to the channel");
+      uint32_t tx = sender->second;
+
+      for (std::vector<uint32_t>::const_iterator rx = m_unplaced.begin (); rx != m_unplaced.end (); ++rx)
+        {
+          Deliver (txParams, tx, *rx);
+        }
+      Ptr<MobilityModel> senderMobility = m_mobilities[tx];
+      if (m_cutoff <= 0 || !senderMobility)
+        {
+          //Unplaced, everyone is a candidate
+          std::vector<uint32_t> const &placed = m_grid.GetItems ();
+          for (std::vector<uint32_t>::const_iterator rx = placed.begin (); rx != placed.end (); ++rx)
+            {
+              Deliver (txParams, tx, *rx);
+            }
+          return;
+        }
+
+      //Every receiver in range is in the cells around the transmitter
+      Vector pos = senderMobility->GetPosition ();
+      std::vector<uint32_t> near;
+      m_grid.GetNear (pos.x, pos.y, near);
+      for (std::vector<uint32_t>::const_iterator rx = near.begin (); rx != near.end (); ++rx)
+        {
+          Deliver (txParams, tx, *rx);
+        }
+    }
+
+    GridSpectrumChannel::Link
+    GridSpectrumChannel::ComputeLink (Ptr<SpectrumSignalParameters> txParams, uint32_t tx, uint32_t rx) const
+    {
+      //Same terms as SingleModelSpectrumChannel
+      Link link = { true, 1, Seconds (0) };
+      Ptr<MobilityModel> senderMobility = m_phyList[tx]->GetMobility ();
+      Ptr<MobilityModel> receiverMobility = m_phyList[rx]->GetMobility ();
+      if (!senderMobility || !receiverMobility)
+        {
+          return link;
+        }
+      if (m_cutoff > 0 && senderMobility->GetDistanceFrom (receiverMobility) > m_cutoff)
+        {
+          link.reachable = false;
+          return link;
+        }
+
+      double pathLossDb = 0;
+      if (txParams->txAntenna)
+        {
+          pathLossDb -= txParams->txAntenna->GetGainDb (Angles (receiverMobility->GetPosition (), senderMobility->GetPosition ()));
+        }
+      Ptr<AntennaModel> rxAntenna = m_phyList[rx]->GetRxAntenna ();
+      if (rxAntenna)
+        {
+          pathLossDb -= rxAntenna->GetGainDb (Angles (senderMobility->GetPosition (), receiverMobility->GetPosition ()));
+        }
+      if (m_propagationLoss)
+        {
+          pathLossDb -= m_propagationLoss->CalcRxPower (0, senderMobility, receiverMobility);
+        }
+      if (pathLossDb > m_maxLossDb)
+        {
+          link.reachable = false;
+          return link;
+        }
+      link.gain = std::pow (10.0, -pathLossDb / 10.0);
+      if (m_propagationDelay)
+        {
+          link.delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+        }
+      return link;
+    }
+
+    void
+    GridSpectrumChannel::Deliver (Ptr<SpectrumSignalParameters> txParams, uint32_t tx, uint32_t rx)
+    {
+      if (rx == tx)
+        {
+          return;
+        }
+
+      Link link;
+      if (m_cacheLosses)
+        {
+          uint64_t key = (static_cast<uint64_t> (tx) << 32) | rx;
+          std::unordered_map<uint64_t, Link>::const_iterator cached = m_links.find (key);
+          if (cached == m_links.end ())
+            {
+              cached = m_links.insert (std::make_pair (key, ComputeLink (txParams, tx, rx))).first;
+            }
+          link = cached->second;
+        }
+      else
+        {
+          link = ComputeLink (txParams, tx, rx);
+        }
+      if (!link.reachable)
+        {
+          return;
+        }
+
+      //Only now is the signal worth a copy
+      Ptr<SpectrumPhy> receiver = m_phyList[rx];
+      Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+      *(rxParams->psd) *= link.gain;
+      if (m_spectrumPropagationLoss)
+        {
+          rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, m_phyList[tx]->GetMobility (), receiver->GetMobility ());
+        }
+
+      Ptr<NetDevice> netDev = receiver->GetDevice ();
+      if (netDev)
+        {
+          Simulator::ScheduleWithContext (netDev->GetNode ()->GetId (), link.delay, &GridSpectrumChannel::StartRx, this, rxParams, receiver);
+        }
+      else
+        {
+          Simulator::Schedule (link.delay, &GridSpectrumChannel::StartRx, this, rxParams, receiver);
+        }
+    }
+
+    void
+    GridSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+    {
+      receiver->StartRx (params);
+    }
+
+  }
+}
@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef GRIDSPECTRUMCHANNEL_H
+#define GRIDSPECTRUMCHANNEL_H
+
+#include "ns3/spectrum-channel.h"
+#include "ns3/spectrum-phy.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/spectrum-model.h"
+#include "ns3/mobility-model.h"
+#include "ns3/nstime.h"
+#include "spatial-grid.h"
+
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /**
+     * @brief The GridSpectrumChannel class is a single-model SpectrumChannel that only looks at
+     *the receivers within a cutoff range of the transmitter.
+     *
+     *The stock channels evaluate the propagation to every PHY, and schedule a reception at
+     *every one of them, for each transmission. Here the PHYs are indexed in a SpatialGrid
+     *with cells no narrower than the cutoff, so a transmission only visits the 3x3 cells
+     *around the transmitter, and only receivers closer than the cutoff get a reception event. For
+     *nodes that do not move, the path loss and the delay of each pair are also computed
+     *once and cached; any course change of a PHY rebuilds the index and empties the cache.
+     *
+     *With a deterministic loss model and a cutoff no shorter than the distance where the
+     *signal falls below MaxLossDb (the range of a RangePropagationLossModel, for instance),
+     *the receivers are exactly those of SingleModelSpectrumChannel. The cache should be
+     *disabled for loss models drawing a new value at each transmission.
+     */
+    class GridSpectrumChannel : public SpectrumChannel
+    {
+    public:
+      static TypeId GetTypeId (void);
+
+      GridSpectrumChannel ();
+
+      //From SpectrumChannel
+      virtual void AddRx (Ptr<SpectrumPhy> phy);
+      virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+
+      //From Channel
+      virtual std::size_t    GetNDevices (void) const;
+      virtual Ptr<NetDevice> GetDevice (std::size_t i) const;
+
+      /**
+       * @brief GetNCachedLinks Number of transmitter-receiver pairs in the loss cache
+       */
+      std::size_t GetNCachedLinks (void) const { return m_links.size (); }
+
+    protected:
+      virtual void DoDispose (void);
+
+    private:
+      //Path loss and delay from one PHY to another
+      struct Link
+      {
+        bool   reachable;
+        double gain;        //Linear
+        Time   delay;
+      };
+
+      void BuildIndex (void);
+      void CourseChanged (Ptr<const MobilityModel> mobility);
+      void SetCutoff (double cutoff);
+      double GetCutoff (void) const;
+      void Deliver (Ptr<SpectrumSignalParameters> txParams, uint32_t tx, uint32_t rx);
+      Link ComputeLink (Ptr<SpectrumSignalParameters> txParams, uint32_t tx, uint32_t rx) const;
+      void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+      double m_cutoff;
+      bool   m_cacheLosses;
+      Ptr<const SpectrumModel> m_spectrumModel;
+
+      std::vector<Ptr<SpectrumPhy> >             m_phyList;
+      std::map<Ptr<const SpectrumPhy>, uint32_t> m_phyIndex;
+      //Mobility models whose course changes are followed, one per PHY
+      std::vector<Ptr<MobilityModel> >           m_mobilities;
+      //PHYs by position, and those without a position, visited by every transmission
+      bool                                            m_indexValid;
+      SpatialGrid                                     m_grid;
+      std::vector<uint32_t>                           m_unplaced;
+      //Links by (tx << 32 | rx)
+      std::unordered_map<uint64_t, Link>              m_links;
+    };
+
+  }
+}
+
+#endif // GRIDSPECTRUMCHANNEL_H
@@ -0,0 +1,136 @@
+#include "neighbor-table.h"
+#include "ns3/assert.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    NeighborTable::NeighborTable()
+    {
+    }
+
+    void
+    NeighborTable::Update (Ipv4Address neighbor, std::vector<Ipv4Address> const &twoHop, bool selectedUs, Time expiresAt)
+    {
+      NeighborEntry &entry = m_neighbors[neighbor];
+      entry.twoHop.clear ();
+      entry.twoHop.insert (twoHop.begin (), twoHop.end ());
+      entry.selectedUs = selectedUs;
+      entry.expiresAt = expiresAt;
+    }
+
+    void
+    NeighborTable::Purge (Time now)
+    {
+      std::map<Ipv4Address, NeighborEntry>::iterator it = m_neighbors.begin ();
+      while (it != m_neighbors.end ())
+        {
+          if (it->second.expiresAt <= now)
+            {
+              m_neighbors.erase (it++);
+            }
+          else
+            {
+              ++it;
+            }
+        }
+    }
+
+    std::vector<Ipv4Address>
+    NeighborTable::GetNeighbors () const
+    {
+      std::vector<Ipv4Address> neighbors;
+      neighbors.reserve (m_neighbors.size ());
+      for (std::map<Ipv4Address, NeighborEntry>::const_iterator it = m_neighbors.begin (); it != m_neighbors.end (); ++it)
+        {
+          neighbors.push_back (it->first);
+        }
+      return neighbors;
+    }
+
+    bool
+    NeighborTable::HasMprSelectors () const
+    {
+      for (std::map<Ipv4Address, NeighborEntry>::const_iterator it = m_neighbors.begin (); it != m_neighbors.end (); ++it)
+        {
+          if (it->second.selectedUs)
+            {
+              return true;
+            }
+        }
+      return false;
+    }
+
+    std::set<Ipv4Address>
+    NeighborTable::ComputeMprSet () const
+    {
+      typedef std::map<Ipv4Address, NeighborEntry>::const_iterator Iterator;
+      std::set<Ipv4Address> mprs;
+
+      //Strict 2-hop neighbours and how many neighbours reach each of them
+      std::map<Ipv4Address, uint32_t> uncovered;
+      for (Iterator n = m_neighbors.begin (); n != m_neighbors.end (); ++n)
+        {
+          for (std::set<Ipv4Address>::const_iterator t = n->second.twoHop.begin (); t != n->second.twoHop.end (); ++t)
+            {
+              if (m_neighbors.find (*t) == m_neighbors.end ())
+                {
+                  uncovered[*t]++;
+                }
+            }
+        }
+
+      //Neighbours that are the only way to reach some 2-hop neighbour
+      for (Iterator n = m_neighbors.begin (); n != m_neighbors.end (); ++n)
+        {
+          for (std::set<Ipv4Address>::const_iterator t = n->second.twoHop.begin (); t != n->second.twoHop.end (); ++t)
+            {
+              std::map<Ipv4Address, uint32_t>::const_iterator u = uncovered.find (*t);
+              if (u != uncovered.end () && u->second == 1)
+                {
+                  mprs.insert (n->first);
+                  break;
+                }
+            }
+        }
+      for (std::set<Ipv4Address>::const_iterator m = mprs.begin (); m != mprs.end (); ++m)
+        {
+          std::set<Ipv4Address> const &covered = m_neighbors.find (*m)->second.twoHop;
+          for (std::set<Ipv4Address>::const_iterator t = covered.begin (); t != covered.end (); ++t)
+            {
+              uncovered.erase (*t);
+            }
+        }
+
+      //Then the neighbour covering most of what is left, until everything is covered
+      while (!uncovered.empty ())
+        {
+          Iterator best = m_neighbors.end ();
+          uint32_t bestCoverage = 0;
+          for (Iterator n = m_neighbors.begin (); n != m_neighbors.end (); ++n)
+            {
+              uint32_t coverage = 0;
+              for (std::set<Ipv4Address>::const_iterator t = n->second.twoHop.begin (); t != n->second.twoHop.end (); ++t)
+                {
+                  coverage += uncovered.count (*t);
+                }
+              if (coverage > bestCoverage)
+                {
+                  best = n;
+                  bestCoverage = coverage;
+                }
+            }
+          NS_ASSERT (best != m_neighbors.end ());
+          mprs.insert (best->first);
+          for (std::set<Ipv4Address>::const_iterator t = best->second.twoHop.begin (); t != best->second.twoHop.end (); ++t)
+            {
+              uncovered.erase (*t);
+            }
+        }
+
+      return mprs;
+    }
+
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef NEIGHBORTABLE_H
+#define NEIGHBORTABLE_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /**
+     * @brief The NeighborTable class keeps the 1-hop neighbours heard through
+     *neighbour HELLOs, the 2-hop neighbours reachable through each of them, and
+     *whether they selected this node as a multipoint relay (MPR).
+     */
+    class NeighborTable
+    {
+    public:
+      NeighborTable();
+
+      /**
+       * @brief Update Stores the content of a neighbour HELLO
+       * @param neighbor The sender of the HELLO
+       * @param twoHop The 1-hop neighbours of the sender, this node excluded
+       * @param selectedUs true if the sender selected this node as MPR
+       * @param expiresAt Time after which the neighbour is forgotten if it is not heard again
+       */
+      void Update(Ipv4Address neighbor, std::vector<Ipv4Address> const &twoHop, bool selectedUs, Time expiresAt);
+
+      /**
+       * @brief Purge Forgets the neighbours that expired at or before now
+       */
+      void Purge(Time now);
+
+      bool IsEmpty() const { return m_neighbors.empty (); }
+      std::vector<Ipv4Address> GetNeighbors() const;
+
+      /**
+       * @brief HasMprSelectors
+       * @return true if some neighbour selected this node as MPR, so it has to relay
+       */
+      bool HasMprSelectors() const;
+
+      /**
+       * @brief ComputeMprSet Greedy MPR selection of OLSR (RFC 3626, section 8.3.1):
+       *neighbours that are the only way to reach some 2-hop neighbour first, then the
+       *neighbour covering most of the uncovered 2-hop neighbours, until all are covered
+       * @return The selected relays
+       */
+      std::set<Ipv4Address> ComputeMprSet() const;
+
+    private:
+      struct NeighborEntry
+      {
+        std::set<Ipv4Address> twoHop;
+        bool                  selectedUs;
+        Time                  expiresAt;
+      };
+
+      std::map<Ipv4Address, NeighborEntry> m_neighbors;
+    };
+
+  }
+}
+
+#endif // NEIGHBORTABLE_H
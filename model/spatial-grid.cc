@@ -0,0 +1,123 @@
+#include "spatial-grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    namespace
+    {
+      //Cells per point above which the grid grows coarser, to keep it about the size of the point set
+      const uint32_t MAX_CELLS_PER_POINT = 4;
+    }
+
+    SpatialGrid::SpatialGrid() :
+      m_minX (0),
+      m_minY (0),
+      m_cell (0),
+      m_cols (0),
+      m_rows (0),
+      m_start (1, 0)
+    {
+    }
+
+    void
+    SpatialGrid::Clear()
+    {
+      m_added.clear ();
+      m_x.clear ();
+      m_y.clear ();
+      m_cols = 0;
+      m_rows = 0;
+      m_start.assign (1, 0);
+      m_items.clear ();
+    }
+
+    void
+    SpatialGrid::Add(uint32_t item, double x, double y)
+    {
+      m_added.push_back (item);
+      m_x.push_back (x);
+      m_y.push_back (y);
+    }
+
+    void
+    SpatialGrid::Build(double range)
+    {
+      uint32_t points = m_added.size ();
+      m_cell = range;
+      m_items.clear ();
+      if (points == 0)
+        {
+          m_cols = 0;
+          m_rows = 0;
+          m_start.assign (1, 0);
+          return;
+        }
+
+      m_minX = *std::min_element (m_x.begin (), m_x.end ());
+      m_minY = *std::min_element (m_y.begin (), m_y.end ());
+      double maxX = *std::max_element (m_x.begin (), m_x.end ());
+      double maxY = *std::max_element (m_y.begin (), m_y.end ());
+      for (;;)
+        {
+          double cols = std::floor ((maxX - m_minX) / m_cell) + 1;
+          double rows = std::floor ((maxY - m_minY) / m_cell) + 1;
+          if (cols * rows <= static_cast<double> (points) * MAX_CELLS_PER_POINT)
+            {
+              m_cols = cols;
+              m_rows = rows;
+              break;
+            }
+          m_cell *= 2;
+        }
+
+      //Counting sort by cell, stable so that each cell keeps the order of Add
+      std::vector<uint32_t> cellOf (points);
+      m_start.assign (m_cols * m_rows + 1, 0);
+      for (uint32_t i = 0; i < points; ++i)
+        {
+          uint32_t cx = std::min<uint32_t> (m_cols - 1, (m_x[i] - m_minX) / m_cell);
+          uint32_t cy = std::min<uint32_t> (m_rows - 1, (m_y[i] - m_minY) / m_cell);
+          cellOf[i] = cy * m_cols + cx;
+          m_start[cellOf[i] + 1]++;
+        }
+      for (uint32_t c = 0; c < m_cols * m_rows; ++c)
+        {
+          m_start[c + 1] += m_start[c];
+        }
+      m_items.resize (points);
+      std::vector<uint32_t> fill (m_start.begin (), m_start.end () - 1);
+      for (uint32_t i = 0; i < points; ++i)
+        {
+          m_items[fill[cellOf[i]]++] = m_added[i];
+        }
+    }
+
+    void
+    SpatialGrid::GetNear(double x, double y, std::vector<uint32_t> &items) const
+    {
+      if (m_items.empty ())
+        {
+          return;
+        }
+      //Clamped just outside the grid: a farther position has no point in range anyway
+      double fx = std::max (-1.0, std::min<double> (m_cols, std::floor ((x - m_minX) / m_cell)));
+      double fy = std::max (-1.0, std::min<double> (m_rows, std::floor ((y - m_minY) / m_cell)));
+      int32_t cx = fx;
+      int32_t cy = fy;
+      for (int32_t gy = std::max (0, cy - 1); gy <= std::min<int32_t> (m_rows - 1, cy + 1); ++gy)
+        {
+          for (int32_t gx = std::max (0, cx - 1); gx <= std::min<int32_t> (m_cols - 1, cx + 1); ++gx)
+            {
+              uint32_t c = gy * m_cols + gx;
+              items.insert (items.end (), m_items.begin () + m_start[c], m_items.begin () + m_start[c + 1]);
+            }
+        }
+    }
+
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /**
+     * @brief The SpatialGrid class indexes points in a uniform grid of cells no narrower
+     *than a range, so that the points within the range of a position are all in the 3x3
+     *cells around it.
+     *
+     *The cells cover the bounding box of the points, and the points are stored sorted by
+     *cell, each cell in the order the points were added. When the box would hold many more
+     *cells than points, the cells are made wider, which keeps sparse layouts from paying
+     *for their empty space.
+     */
+    class SpatialGrid
+    {
+    public:
+      SpatialGrid();
+
+      /**
+       * @brief Clear Forgets every point
+       */
+      void Clear();
+
+      /**
+       * @brief Add Adds a point, indexed by the next Build
+       * @param item Identifier of the point, returned by the searches
+       */
+      void Add(uint32_t item, double x, double y);
+
+      /**
+       * @brief Build Indexes the points added since the last Clear
+       * @param range Width below which the cells are never made, strictly positive
+       */
+      void Build(double range);
+
+      /**
+       * @brief GetNear Appends the points of the 3x3 cells around a position, among which
+       *are all those within the range of the last Build
+       */
+      void GetNear(double x, double y, std::vector<uint32_t> &items) const;
+
+      /**
+       * @brief GetItems Every indexed point, sorted by cell
+       */
+      std::vector<uint32_t> const &GetItems() const { return m_items; }
+
+      uint32_t GetNItems() const                   { return m_items.size (); }
+      uint32_t GetNCells() const                   { return m_start.size () - 1; }
+      double   GetCellSize() const                 { return m_cell; }
+
+    private:
+      //Points added since the last Clear
+      std::vector<uint32_t> m_added;
+      std::vector<double>   m_x;
+      std::vector<double>   m_y;
+
+      double   m_minX;
+      double   m_minY;
+      double   m_cell;
+      uint32_t m_cols;
+      uint32_t m_rows;
+      //Points of cell c, row by row: m_items[m_start[c] .. m_start[c + 1])
+      std::vector<uint32_t> m_start;
+      std::vector<uint32_t> m_items;
+    };
+
+  }
+}
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,198 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "unit-disk-channel.h"
+#include "unit-disk-net-device.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+
+NS_LOG_COMPONENT_DEFINE ("DVHopUnitDiskChannel");
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    NS_OBJECT_ENSURE_REGISTERED (UnitDiskChannel);
+
+    TypeId
+    UnitDiskChannel::GetTypeId (void)
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::UnitDiskChannel")
+          .SetParent<Channel> ()
+          .AddConstructor<UnitDiskChannel> ()
+          .AddAttribute ("Range",
+                         "Devices at most this far from the sender receive its frames.",
+                         DoubleValue (100),
+                         MakeDoubleAccessor (&UnitDiskChannel::SetRange, &UnitDiskChannel::GetRange),
+                         MakeDoubleChecker<double> (0))
+          .AddAttribute ("LossProbability",
+                         "Probability that a frame is lost on one link, independently of the others.",
+                         DoubleValue (0),
+                         MakeDoubleAccessor (&UnitDiskChannel::m_lossProbability),
+                         MakeDoubleChecker<double> (0, 1))
+          .AddAttribute ("Delay",
+                         "Time from the send to the reception, for every frame.",
+                         TimeValue (MicroSeconds (100)),
+                         MakeTimeAccessor (&UnitDiskChannel::m_delay),
+                         MakeTimeChecker ());
+      return tid;
+    }
+
+    UnitDiskChannel::UnitDiskChannel () :
+      m_range (100),
+      m_lossProbability (0),
+      m_random (CreateObject<UniformRandomVariable> ()),
+      m_indexValid (false)
+    {
+    }
+
+    void
+    UnitDiskChannel::DoDispose (void)
+    {
+      m_devices.clear ();
+      m_deviceIndex.clear ();
+      m_mobilities.clear ();
+      m_grid.Clear ();
+      m_neighbors.clear ();
+      m_neighborsValid.clear ();
+      m_random = 0;
+      Channel::DoDispose ();
+    }
+
+    void
+    UnitDiskChannel::Add (Ptr<UnitDiskNetDevice> device)
+    {
+      if (m_deviceIndex.find (device) != m_deviceIndex.end ())
+        {
+          return;
+        }
+      m_deviceIndex[device] = m_devices.size ();
+      m_devices.push_back (device);
+      m_mobilities.push_back (0);
+      m_indexValid = false;
+    }
+
+    std::size_t
+    UnitDiskChannel::GetNDevices (void) const
+    {
+      return m_devices.size ();
+    }
+
+    Ptr<NetDevice>
+    UnitDiskChannel::GetDevice (std::size_t i) const
+    {
+      return m_devices.at (i);
+    }
+
+    int64_t
+    UnitDiskChannel::AssignStreams (int64_t stream)
+    {
+      m_random->SetStream (stream);
+      return 1;
+    }
+
+    void
+    UnitDiskChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+    {
+      m_indexValid = false;
+    }
+
+    void
+    UnitDiskChannel::SetRange (double range)
+    {
+      m_range = range;
+      m_indexValid = false;
+    }
+
+    double
+    UnitDiskChannel::GetRange (void) const
+    {
+      return m_range;
+    }
+
+    void
+    UnitDiskChannel::BuildIndex (void)
+    {
+      m_grid.Clear ();
+      m_neighbors.assign (m_devices.size (), std::vector<uint32_t> ());
+      m_neighborsValid.assign (m_devices.size (), 0);
+      for (uint32_t i = 0; i < m_devices.size (); ++i)
+        {
+          Ptr<MobilityModel> mobility = m_devices[i]->GetNode ()->GetObject<MobilityModel> ();
+          NS_ABORT_MSG_UNLESS (mobility, "UnitDiskChannel needs a MobilityModel on every node");
+          if (mobility != m_mobilities[i])
+            {
+              mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&UnitDiskChannel::CourseChanged, this));
+              m_mobilities[i] = mobility;
+            }
+          Vector pos = mobility->GetPosition ();
+          m_grid.Add (i, pos.x, pos.y);
+        }
+      m_grid.Build (m_range);
+      m_indexValid = true;
+      NS_LOG_DEBUG (m_devices.size () << " devices in " << m_grid.GetNCells () << " cells");
+    }
+
+    void
+    UnitDiskChannel::FindNeighbors (uint32_t device)
+    {
+      std::vector<uint32_t> &neighbors = m_neighbors[device];
+      neighbors.clear ();
+      Vector pos = m_mobilities[device]->GetPosition ();
+      std::vector<uint32_t> near;
+      m_grid.GetNear (pos.x, pos.y, near);
+      for (std::vector<uint32_t>::const_iterator j = near.begin (); j != near.end (); ++j)
+        {
+          if (*j != device && CalculateDistance (pos, m_mobilities[*j]->GetPosition ()) <= m_range)
+            {
+              neighbors.push_back (*j);
+            }
+        }
+      m_neighborsValid[device] = 1;
+    }
+
+    void
+    UnitDiskChannel::Send (Ptr<Packet> packet, uint16_t protocol, Mac48Address to, Mac48Address from,
+                           Ptr<UnitDiskNetDevice> sender)
+    {
+      NS_LOG_FUNCTION (this << packet << protocol << to << from << sender);
+      if (m_range <= 0)
+        {
+          return;
+        }
+      if (!m_indexValid)
+        {
+          BuildIndex ();
+        }
+      std::map<Ptr<UnitDiskNetDevice>, uint32_t>::const_iterator index = m_deviceIndex.find (sender);
+      NS_ASSERT_MSG (index != m_deviceIndex.end (), "Sender not attached to the channel");
+      uint32_t device = index->second;
+      if (!m_neighborsValid[device])
+        {
+          FindNeighbors (device);
+        }
+
+      bool unicast = !to.IsBroadcast () && !to.IsGroup ();
+      std::vector<uint32_t> const &neighbors = m_neighbors[device];
+      for (std::vector<uint32_t>::const_iterator j = neighbors.begin (); j != neighbors.end (); ++j)
+        {
+          Ptr<UnitDiskNetDevice> receiver = m_devices[*j];
+          if (unicast && Mac48Address::ConvertFrom (receiver->GetAddress ()) != to)
+            {
+              continue;
+            }
+          if (m_lossProbability > 0 && m_random->GetValue () < m_lossProbability)
+            {
+              receiver->NotifyLost (packet);
+              continue;
+            }
+          Simulator::ScheduleWithContext (receiver->GetNode ()->GetId (), m_delay, &UnitDiskNetDevice::Receive, receiver,
+                                          packet->Copy (), protocol, to, from);
+        }
+    }
+
+  }
+}
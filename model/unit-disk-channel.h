@@ -0,0 +1,90 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef UNITDISKCHANNEL_H
+#define UNITDISKCHANNEL_H
+
+#include "ns3/channel.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/mac48-address.h"
+#include "ns3/mobility-model.h"
+#include "ns3/random-variable-stream.h"
+#include "spatial-grid.h"
+
+#include <map>
+#include <vector>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    class UnitDiskNetDevice;
+
+    /**
+     * @brief The UnitDiskChannel class connects UnitDiskNetDevices over a unit disk: a frame
+     *reaches every device within Range of the sender, each independently lost with
+     *LossProbability, after a fixed Delay. There is no contention, no collision and no
+     *PHY model, just one reception event per receiver.
+     *
+     *The devices are indexed in a SpatialGrid, and the neighbours of each sender are found
+     *once, then kept until some device moves or the range changes.
+     */
+    class UnitDiskChannel : public Channel
+    {
+    public:
+      static TypeId GetTypeId (void);
+
+      UnitDiskChannel ();
+
+      /**
+       * @brief Add Attaches a device, whose node should carry a MobilityModel by the first send
+       */
+      void Add (Ptr<UnitDiskNetDevice> device);
+
+      /**
+       * @brief Send Delivers a frame to the neighbours of the sender, or only to the
+       *destination when it is a unicast address
+       */
+      void Send (Ptr<Packet> packet, uint16_t protocol, Mac48Address to, Mac48Address from,
+                 Ptr<UnitDiskNetDevice> sender);
+
+      /**
+       * @brief AssignStreams Fixes the stream of the loss random variable
+       * @return The number of streams used
+       */
+      int64_t AssignStreams (int64_t stream);
+
+      //From Channel
+      virtual std::size_t    GetNDevices (void) const;
+      virtual Ptr<NetDevice> GetDevice (std::size_t i) const;
+
+    protected:
+      virtual void DoDispose (void);
+
+    private:
+      void BuildIndex (void);
+      void FindNeighbors (uint32_t device);
+      void CourseChanged (Ptr<const MobilityModel> mobility);
+      void SetRange (double range);
+      double GetRange (void) const;
+
+      double m_range;
+      double m_lossProbability;
+      Time   m_delay;
+      Ptr<UniformRandomVariable> m_random;
+
+      std::vector<Ptr<UnitDiskNetDevice> > m_devices;
+      std::map<Ptr<UnitDiskNetDevice>, uint32_t> m_deviceIndex;
+      std::vector<Ptr<MobilityModel> >     m_mobilities;
+      //Devices by position, rebuilt after a course change or a new range
+      bool                                 m_indexValid;
+      SpatialGrid                          m_grid;
+      //Neighbours of each device, found on its first send after the index is built
+      std::vector<std::vector<uint32_t> >  m_neighbors;
+      std::vector<uint8_t>                 m_neighborsValid;
+    };
+
+  }
+}
+
+#endif // UNITDISKCHANNEL_H
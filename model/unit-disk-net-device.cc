@@ -0,0 +1,258 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "unit-disk-net-device.h"
+#include "unit-disk-channel.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
+
+NS_LOG_COMPONENT_DEFINE ("DVHopUnitDiskNetDevice");
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    NS_OBJECT_ENSURE_REGISTERED (UnitDiskNetDevice);
+
+    TypeId
+    UnitDiskNetDevice::GetTypeId (void)
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::UnitDiskNetDevice")
+          .SetParent<NetDevice> ()
+          .AddConstructor<UnitDiskNetDevice> ()
+          .AddAttribute ("Mtu",
+                         "The MAC-level Maximum Transmission Unit",
+                         UintegerValue (1500),
+                         MakeUintegerAccessor (&UnitDiskNetDevice::SetMtu,
+                                               &UnitDiskNetDevice::GetMtu),
+                         MakeUintegerChecker<uint16_t> ())
+          .AddTraceSource ("MacTx",
+                           "A packet handed to the channel",
+                           MakeTraceSourceAccessor (&UnitDiskNetDevice::m_macTxTrace),
+                           "ns3::Packet::TracedCallback")
+          .AddTraceSource ("MacRx",
+                           "A packet received from the channel and passed up",
+                           MakeTraceSourceAccessor (&UnitDiskNetDevice::m_macRxTrace),
+                           "ns3::Packet::TracedCallback")
+          .AddTraceSource ("Loss",
+                           "A packet to this device lost on its link",
+                           MakeTraceSourceAccessor (&UnitDiskNetDevice::m_lossTrace),
+                           "ns3::Packet::TracedCallback");
+      return tid;
+    }
+
+    UnitDiskNetDevice::UnitDiskNetDevice () :
+      m_ifIndex (0),
+      m_mtu (1500)
+    {
+    }
+
+    void
+    UnitDiskNetDevice::DoDispose (void)
+    {
+      m_channel = 0;
+      m_node = 0;
+      NetDevice::DoDispose ();
+    }
+
+    void
+    UnitDiskNetDevice::SetChannel (Ptr<UnitDiskChannel> channel)
+    {
+      m_channel = channel;
+      m_channel->Add (this);
+    }
+
+    void
+    UnitDiskNetDevice::Receive (Ptr<Packet> packet, uint16_t protocol, Mac48Address to, Mac48Address from)
+    {
+      NS_LOG_FUNCTION (this << packet << protocol << to << from);
+      PacketType type;
+      if (to == m_address)
+        {
+          type = PACKET_HOST;
+        }
+      else if (to.IsBroadcast ())
+        {
+          type = PACKET_BROADCAST;
+        }
+      else if (to.IsGroup ())
+        {
+          type = PACKET_MULTICAST;
+        }
+      else
+        {
+          type = PACKET_OTHERHOST;
+        }
+
+      if (!m_promiscCallback.IsNull ())
+        {
+          m_promiscCallback (this, packet, protocol, from, to, type);
+        }
+      if (type != PACKET_OTHERHOST)
+        {
+          m_macRxTrace (packet);
+          m_rxCallback (this, packet, protocol, from);
+        }
+    }
+
+    void
+    UnitDiskNetDevice::NotifyLost (Ptr<const Packet> packet)
+    {
+      m_lossTrace (packet);
+    }
+
+    void
+    UnitDiskNetDevice::SetIfIndex (const uint32_t index)
+    {
+      m_ifIndex = index;
+    }
+
+    uint32_t
+    UnitDiskNetDevice::GetIfIndex (void) const
+    {
+      return m_ifIndex;
+    }
+
+    Ptr<Channel>
+    UnitDiskNetDevice::GetChannel (void) const
+    {
+      return m_channel;
+    }
+
+    void
+    UnitDiskNetDevice::SetAddress (Address address)
+    {
+      m_address = Mac48Address::ConvertFrom (address);
+    }
+
+    Address
+    UnitDiskNetDevice::GetAddress (void) const
+    {
+      return m_address;
+    }
+
+    bool
+    UnitDiskNetDevice::SetMtu (const uint16_t mtu)
+    {
+      m_mtu = mtu;
+      return true;
+    }
+
+    uint16_t
+    UnitDiskNetDevice::GetMtu (void) const
+    {
+      return m_mtu;
+    }
+
+    bool
+    UnitDiskNetDevice::IsLinkUp (void) const
+    {
+      return m_channel != 0;
+    }
+
+    void
+    UnitDiskNetDevice::AddLinkChangeCallback (Callback<void> callback)
+    {
+      //The link never changes
+    }
+
+    bool
+    UnitDiskNetDevice::IsBroadcast (void) const
+    {
+      return true;
+    }
+
+    Address
+    UnitDiskNetDevice::GetBroadcast (void) const
+    {
+      return Mac48Address::GetBroadcast ();
+    }
+
+    bool
+    UnitDiskNetDevice::IsMulticast (void) const
+    {
+      return true;
+    }
+
+    Address
+    UnitDiskNetDevice::GetMulticast (Ipv4Address multicastGroup) const
+    {
+      return Mac48Address::GetMulticast (multicastGroup);
+    }
+
+    Address
+    UnitDiskNetDevice::GetMulticast (Ipv6Address addr) const
+    {
+      return Mac48Address::GetMulticast (addr);
+    }
+
+    bool
+    UnitDiskNetDevice::IsPointToPoint (void) const
+    {
+      return false;
+    }
+
+    bool
+    UnitDiskNetDevice::IsBridge (void) const
+    {
+      return false;
+    }
+
+    bool
+    UnitDiskNetDevice::Send (Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber)
+    {
+      return SendFrom (packet, m_address, dest, protocolNumber);
+    }
+
+    bool
+    UnitDiskNetDevice::SendFrom (Ptr<Packet> packet, const Address &source, const Address &dest, uint16_t protocolNumber)
+    {
+      NS_LOG_FUNCTION (this << packet << source << dest << protocolNumber);
+      if (!m_channel || packet->GetSize () > m_mtu)
+        {
+          return false;
+        }
+      m_macTxTrace (packet);
+      m_channel->Send (packet, protocolNumber, Mac48Address::ConvertFrom (dest), Mac48Address::ConvertFrom (source), this);
+      return true;
+    }
+
+    Ptr<Node>
+    UnitDiskNetDevice::GetNode (void) const
+    {
+      return m_node;
+    }
+
+    void
+    UnitDiskNetDevice::SetNode (Ptr<Node> node)
+    {
+      m_node = node;
+    }
+
+    bool
+    UnitDiskNetDevice::NeedsArp (void) const
+    {
+      return true;
+    }
+
+    void
+    UnitDiskNetDevice::SetReceiveCallback (NetDevice::ReceiveCallback cb)
+    {
+      m_rxCallback = cb;
+    }
+
+    void
+    UnitDiskNetDevice::SetPromiscReceiveCallback (NetDevice::PromiscReceiveCallback cb)
+    {
+      m_promiscCallback = cb;
+    }
+
+    bool
+    UnitDiskNetDevice::SupportsSendFrom (void) const
+    {
+      return true;
+    }
+
+  }
+}
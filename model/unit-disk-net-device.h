@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef UNITDISKNETDEVICE_H
+#define UNITDISKNETDEVICE_H
+
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/mac48-address.h"
+#include "ns3/traced-callback.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    class UnitDiskChannel;
+
+    /**
+     * @brief The UnitDiskNetDevice class is a minimal broadcast NetDevice for protocol-scale
+     *experiments: frames go straight to the UnitDiskChannel, with no queue, MAC header or
+     *PHY, and come out at the neighbours in range. It uses ARP like any broadcast medium,
+     *so InternetStackHelper and the routing helpers work unchanged.
+     */
+    class UnitDiskNetDevice : public NetDevice
+    {
+    public:
+      static TypeId GetTypeId (void);
+
+      UnitDiskNetDevice ();
+
+      void SetChannel (Ptr<UnitDiskChannel> channel);
+
+      /**
+       * @brief Receive Called by the channel when a frame arrives
+       */
+      void Receive (Ptr<Packet> packet, uint16_t protocol, Mac48Address to, Mac48Address from);
+
+      /**
+       * @brief NotifyLost Called by the channel when a frame to this device is lost
+       */
+      void NotifyLost (Ptr<const Packet> packet);
+
+      //From NetDevice
+      virtual void           SetIfIndex (const uint32_t index);
+      virtual uint32_t       GetIfIndex (void) const;
+      virtual Ptr<Channel>   GetChannel (void) const;
+      virtual void           SetAddress (Address address);
+      virtual Address        GetAddress (void) const;
+      virtual bool           SetMtu (const uint16_t mtu);
+      virtual uint16_t       GetMtu (void) const;
+      virtual bool           IsLinkUp (void) const;
+      virtual void           AddLinkChangeCallback (Callback<void> callback);
+      virtual bool           IsBroadcast (void) const;
+      virtual Address        GetBroadcast (void) const;
+      virtual bool           IsMulticast (void) const;
+      virtual Address        GetMulticast (Ipv4Address multicastGroup) const;
+      virtual Address        GetMulticast (Ipv6Address addr) const;
+      virtual bool           IsPointToPoint (void) const;
+      virtual bool           IsBridge (void) const;
+      virtual bool           Send (Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber);
+      virtual bool           SendFrom (Ptr<Packet> packet, const Address &source, const Address &dest, uint16_t protocolNumber);
+      virtual Ptr<Node>      GetNode (void) const;
+      virtual void           SetNode (Ptr<Node> node);
+      virtual bool           NeedsArp (void) const;
+      virtual void           SetReceiveCallback (NetDevice::ReceiveCallback cb);
+      virtual void           SetPromiscReceiveCallback (NetDevice::PromiscReceiveCallback cb);
+      virtual bool           SupportsSendFrom (void) const;
+
+    protected:
+      virtual void DoDispose (void);
+
+    private:
+      Ptr<UnitDiskChannel>             m_channel;
+      Ptr<Node>                        m_node;
+      Mac48Address                     m_address;
+      uint32_t                         m_ifIndex;
+      uint16_t                         m_mtu;
+      NetDevice::ReceiveCallback       m_rxCallback;
+      NetDevice::PromiscReceiveCallback m_promiscCallback;
+
+      TracedCallback<Ptr<const Packet> > m_macTxTrace;
+      TracedCallback<Ptr<const Packet> > m_macRxTrace;
+      TracedCallback<Ptr<const Packet> > m_lossTrace;
+    };
+
+  }
+}
+
+#endif // UNITDISKNETDEVICE_H
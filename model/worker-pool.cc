@@ -0,0 +1,42 @@
+#include "worker-pool.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    void
+    ParallelFor(uint32_t items, uint32_t threads, uint32_t minItems,
+                const std::function<void(uint32_t, uint32_t)> &work)
+    {
+      if (threads == 0)
+        {
+          threads = std::max (1u, std::thread::hardware_concurrency ());
+        }
+      threads = std::max (1u, std::min (threads, items / std::max (1u, minItems)));
+      if (threads == 1)
+        {
+          work (0, items);
+          return;
+        }
+
+      //Contiguous chunks, the calling thread takes the last one
+      std::vector<std::thread> workers;
+      uint32_t chunk = (items + threads - 1) / threads;
+      for (uint32_t t = 0; t + 1 < threads; ++t)
+        {
+          workers.push_back (std::thread (work, t * chunk, std::min (items, (t + 1) * chunk)));
+        }
+      work (std::min (items, (threads - 1) * chunk), items);
+      for (std::vector<std::thread>::iterator it = workers.begin (); it != workers.end (); ++it)
+        {
+          it->join ();
+        }
+    }
+
+  }
+}
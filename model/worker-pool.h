@@ -0,0 +1,31 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <stdint.h>
+#include <functional>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    //Nodes per worker thread for a localization, below which more threads cost
+    //more than they save
+    static const uint32_t MIN_NODES_PER_THREAD = 256;
+
+    /**
+     * @brief ParallelFor Runs work over [0, items) split into contiguous chunks, one per
+     *worker thread, and returns once every chunk is done. The calling thread takes the
+     *last chunk, so a single chunk runs without starting any thread.
+     * @param items Number of items
+     * @param threads Number of worker threads, 0 for one per core
+     * @param minItems Items per thread below which fewer threads are used
+     * @param work Called with the [begin, end) range of each chunk
+     */
+    void ParallelFor(uint32_t items, uint32_t threads, uint32_t minItems,
+                     const std::function<void(uint32_t, uint32_t)> &work);
+
+  }
+}
+
+#endif // WORKERPOOL_H
@@ -2,6 +2,31 @@
 
 // Include a header file from your module to test.
 #include "ns3/dvhop.h"
+#include "ns3/dvhop-packet.h"
+#include "ns3/duplicate-cache.h"
+#include "ns3/distance-table.h"
+#include "ns3/distance-table-arena.h"
+#include "ns3/neighbor-table.h"
+#include "ns3/dvhop-localization.h"
+#include "ns3/batch-localization.h"
+#include "ns3/analytical-engine.h"
+#include "ns3/grid-spectrum-channel.h"
+#include "ns3/spatial-grid.h"
+#include "ns3/dvhop-helper.h"
+#include "ns3/unit-disk-helper.h"
+#include "ns3/convergence-monitor.h"
+#include "ns3/packet.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/spectrum-module.h"
+#include "ns3/propagation-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <set>
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +71,2284 @@ DvhopTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Compact HELLO encoding: round trip through a packet keeps hops, sequence
+// numbers and addresses exact and positions within half a quantization step
+class DvhopCompactEncodingTestCase : public TestCase
+{
+public:
+  DvhopCompactEncodingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopCompactEncodingTestCase::DvhopCompactEncodingTestCase ()
+  : TestCase ("Compact encoding round trip with bounded quantization error")
+{
+}
+
+void
+DvhopCompactEncodingTestCase::DoRun (void)
+{
+  const uint16_t resolution = 10;                  // millimetres
+  const double maxError = resolution / 2000.0;     // half a step, in metres
+
+  // One beacon per packet
+  dvhop::FloodingHeader flooding (123.456789, -4534.4521, 300, 7, Ipv4Address ("10.0.0.9"));
+  flooding.SetCompact (true);
+  flooding.SetResolution (resolution);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (flooding);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), flooding.GetSerializedSize (), "Serialized size mismatch");
+  NS_TEST_ASSERT_MSG_LT (packet->GetSize (), dvhop::FloodingHeader ().GetSerializedSize (), "Compact header is not smaller");
+
+  dvhop::FloodingHeader received;
+  received.SetCompact (true);
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ_TOL (received.GetXPosition (), 123.456789, maxError, "X out of the quantization bound");
+  NS_TEST_ASSERT_MSG_EQ_TOL (received.GetYPosition (), -4534.4521, maxError, "Y out of the quantization bound");
+  NS_TEST_ASSERT_MSG_EQ (received.GetSequenceNumber (), 300, "Wrong sequence number");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHopCount (), 7, "Wrong hop count");
+  NS_TEST_ASSERT_MSG_EQ (received.GetBeaconAddress (), Ipv4Address ("10.0.0.9"), "Wrong beacon address");
+
+  // Several beacons per packet, the last one out of address order
+  dvhop::AdvertisementHeader raw;
+  dvhop::AdvertisementHeader compact;
+  compact.SetCompact (true);
+  compact.SetResolution (resolution);
+  std::vector<dvhop::FloodingHeader> entries;
+  for (uint32_t i = 0; i < 50; ++i)
+    {
+      entries.push_back (dvhop::FloodingHeader (50.0 * (i % 10) + 0.1234 * i, 50.0 * (i / 10) - 0.0071 * i,
+                                                1000 + i, i % 12 + 1, Ipv4Address (0x0a000001 + 2 * i)));
+    }
+  entries.push_back (dvhop::FloodingHeader (-12.5, 7.25, 65535, 0, Ipv4Address ("10.0.0.3")));
+  for (uint32_t i = 0; i < entries.size (); ++i)
+    {
+      uint32_t expected = compact.GetSerializedSize () + compact.GetEntrySerializedSize (entries[i]);
+      compact.AddEntry (entries[i]);
+      raw.AddEntry (entries[i]);
+      NS_TEST_ASSERT_MSG_EQ (compact.GetSerializedSize (), expected, "Wrong incremental size");
+    }
+  NS_TEST_ASSERT_MSG_LT (compact.GetSerializedSize (), 0.55 * raw.GetSerializedSize (), "Compact advertisement is not about half the size");
+
+  packet = Create<Packet> ();
+  packet->AddHeader (compact);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), compact.GetSerializedSize (), "Serialized size mismatch");
+  dvhop::AdvertisementHeader decoded;
+  decoded.SetCompact (true);
+  packet->RemoveHeader (decoded);
+  NS_TEST_ASSERT_MSG_EQ (decoded.GetNEntries (), entries.size (), "Wrong number of entries");
+  NS_TEST_ASSERT_MSG_EQ (decoded.GetResolution (), resolution, "Wrong resolution");
+  for (uint16_t i = 0; i < decoded.GetNEntries (); ++i)
+    {
+      dvhop::FloodingHeader const &e = decoded.GetEntry (i);
+      NS_TEST_ASSERT_MSG_EQ_TOL (e.GetXPosition (), entries[i].GetXPosition (), maxError, "X out of the quantization bound");
+      NS_TEST_ASSERT_MSG_EQ_TOL (e.GetYPosition (), entries[i].GetYPosition (), maxError, "Y out of the quantization bound");
+      NS_TEST_ASSERT_MSG_EQ (e.GetSequenceNumber (), entries[i].GetSequenceNumber (), "Wrong sequence number");
+      NS_TEST_ASSERT_MSG_EQ (e.GetHopCount (), entries[i].GetHopCount (), "Wrong hop count");
+      NS_TEST_ASSERT_MSG_EQ (e.GetBeaconAddress (), entries[i].GetBeaconAddress (), "Wrong beacon address");
+    }
+}
+
+// Plain advertisement: round trip through a packet keeps every field exact
+class DvhopAdvertisementTestCase : public TestCase
+{
+public:
+  DvhopAdvertisementTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopAdvertisementTestCase::DvhopAdvertisementTestCase ()
+  : TestCase ("Advertisement round trip")
+{
+}
+
+void
+DvhopAdvertisementTestCase::DoRun (void)
+{
+  dvhop::AdvertisementHeader advertisement;
+  std::vector<dvhop::FloodingHeader> entries;
+  for (uint32_t i = 0; i < 20; ++i)
+    {
+      entries.push_back (dvhop::FloodingHeader (12.56 * i - 100, 468.5 + 0.001 * i, 65530 + i, i % 7,
+                                                Ipv4Address (0x0a0000ff - 3 * i)));
+      advertisement.AddEntry (entries[i]);
+    }
+  NS_TEST_ASSERT_MSG_EQ (advertisement.GetSerializedSize (), 2 + 20 * entries[0].GetSerializedSize (),
+                         "A count, then the entries back to back");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (advertisement);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), advertisement.GetSerializedSize (), "Serialized size mismatch");
+  dvhop::AdvertisementHeader decoded;
+  packet->RemoveHeader (decoded);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 0, "The whole header is read back");
+  NS_TEST_ASSERT_MSG_EQ (decoded.GetNEntries (), entries.size (), "Wrong number of entries");
+  for (uint16_t i = 0; i < decoded.GetNEntries (); ++i)
+    {
+      dvhop::FloodingHeader const &e = decoded.GetEntry (i);
+      NS_TEST_ASSERT_MSG_EQ (e.GetXPosition (), entries[i].GetXPosition (), "X is carried exactly");
+      NS_TEST_ASSERT_MSG_EQ (e.GetYPosition (), entries[i].GetYPosition (), "Y is carried exactly");
+      NS_TEST_ASSERT_MSG_EQ (e.GetSequenceNumber (), entries[i].GetSequenceNumber (), "Wrong sequence number");
+      NS_TEST_ASSERT_MSG_EQ (e.GetHopCount (), entries[i].GetHopCount (), "Wrong hop count");
+      NS_TEST_ASSERT_MSG_EQ (e.GetBeaconAddress (), entries[i].GetBeaconAddress (), "Wrong beacon address");
+    }
+
+  advertisement.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (advertisement.GetNEntries (), 0, "Cleared");
+  NS_TEST_ASSERT_MSG_EQ (advertisement.GetSerializedSize (), 2, "An empty advertisement is its count");
+}
+
+// Nodes at the given positions, on a unit-disk channel of the given range and
+// MTU, running DV-Hop as configured in the helper. The listed nodes are
+// beacons, placed at their true position
+static NodeContainer
+CreateDvhopNetwork (std::vector<Vector> const &positions, std::vector<uint32_t> const &beacons,
+                    DVHopHelper const &dvhop, double range = 110, uint16_t mtu = 1500)
+{
+  NodeContainer nodes;
+  nodes.Create (positions.size ());
+  Ptr<ListPositionAllocator> allocator = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < positions.size (); ++i)
+    {
+      allocator->Add (positions[i]);
+    }
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (allocator);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  UnitDiskHelper unitDisk;
+  unitDisk.SetChannelAttribute ("Range", DoubleValue (range));
+  unitDisk.SetDeviceAttribute ("Mtu", UintegerValue (mtu));
+  NetDeviceContainer devices = unitDisk.Install (nodes);
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (dvhop);
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  address.Assign (devices);
+  for (uint32_t b = 0; b < beacons.size (); ++b)
+    {
+      Ptr<dvhop::RoutingProtocol> protocol = DynamicCast<dvhop::RoutingProtocol> (nodes.Get (beacons[b])->GetObject<Ipv4> ()->GetRoutingProtocol ());
+      protocol->SetIsBeacon (true);
+      protocol->SetPosition (positions[beacons[b]].x, positions[beacons[b]].y);
+    }
+  return nodes;
+}
+
+static Ptr<dvhop::RoutingProtocol>
+GetDvhop (Ptr<Node> node)
+{
+  return DynamicCast<dvhop::RoutingProtocol> (node->GetObject<Ipv4> ()->GetRoutingProtocol ());
+}
+
+// Type of a packet seen by HelloTx: legacy HELLOs are a bare FloodingHeader, without TypeHeader
+static dvhop::MessageType
+GetMessageType (Ptr<const Packet> packet)
+{
+  dvhop::TypeHeader type;
+  packet->PeekHeader (type);
+  return type.IsValid () ? type.Get () : dvhop::DVHOPTYPE_FLOODING;
+}
+
+// HELLOs carry the distance table, legacy or aggregated
+static bool
+IsHello (Ptr<const Packet> packet)
+{
+  dvhop::MessageType type = GetMessageType (packet);
+  return type != dvhop::DVHOPTYPE_NEIGHBOR_HELLO && type != dvhop::DVHOPTYPE_HOP_SIZE;
+}
+
+// A table larger than a frame is advertised in several frames, each within the MTU
+class DvhopAdvertisementMtuTestCase : public TestCase
+{
+public:
+  DvhopAdvertisementMtuTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void HelloTx (Ptr<const Packet> packet, Ipv4Address address);
+
+  std::map<Time, std::pair<uint32_t, uint32_t> > m_rounds;   // Frames and entries sent at each time
+  uint32_t m_largest;
+};
+
+DvhopAdvertisementMtuTestCase::DvhopAdvertisementMtuTestCase ()
+  : TestCase ("Advertisements split at the MTU"),
+    m_largest (0)
+{
+}
+
+void
+DvhopAdvertisementMtuTestCase::HelloTx (Ptr<const Packet> packet, Ipv4Address address)
+{
+  if (!IsHello (packet))
+    {
+      return;
+    }
+  Ptr<Packet> copy = packet->Copy ();
+  dvhop::TypeHeader type;
+  copy->RemoveHeader (type);
+  dvhop::AdvertisementHeader advertisement;
+  copy->RemoveHeader (advertisement);
+  m_rounds[Simulator::Now ()].first++;
+  m_rounds[Simulator::Now ()].second += advertisement.GetNEntries ();
+  m_largest = std::max (m_largest, packet->GetSize ());
+}
+
+void
+DvhopAdvertisementMtuTestCase::DoRun (void)
+{
+  // 40 beacons on a circle of 50 m around node 0, so it knows 40 beacons at one hop
+  const uint32_t nBeacons = 40;
+  const uint16_t mtu = 200;
+  std::vector<Vector> positions (1, Vector (500, 500, 0));
+  std::vector<uint32_t> beacons;
+  for (uint32_t b = 0; b < nBeacons; ++b)
+    {
+      positions.push_back (Vector (500 + 50 * std::cos (2 * M_PI * b / nBeacons), 500 + 50 * std::sin (2 * M_PI * b / nBeacons), 0));
+      beacons.push_back (b + 1);
+    }
+  DVHopHelper dvhop;
+  dvhop.Set ("TriggeredUpdates", BooleanValue (false));
+  dvhop.Set ("HelloFormat", EnumValue (dvhop::RoutingProtocol::AGGREGATED_HELLO));
+  NodeContainer nodes = CreateDvhopNetwork (positions, beacons, dvhop, 110, mtu);
+  GetDvhop (nodes.Get (0))->TraceConnectWithoutContext ("HelloTx", MakeCallback (&DvhopAdvertisementMtuTestCase::HelloTx, this));
+
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (GetDvhop (nodes.Get (0))->GetDistanceTable ().GetSize (), nBeacons, "Every beacon is known");
+  uint32_t frames = 0;
+  for (std::map<Time, std::pair<uint32_t, uint32_t> >::const_iterator r = m_rounds.begin (); r != m_rounds.end (); ++r)
+    {
+      if (r->second.second == nBeacons)
+        {
+          frames = r->second.first;
+        }
+    }
+  NS_TEST_ASSERT_MSG_GT (frames, 1, "The whole table is advertised in several frames");
+  NS_TEST_ASSERT_MSG_EQ ((m_largest + 20 + 8 <= mtu), true, "Every frame fits in the MTU with its IPv4 and UDP headers");
+  Simulator::Destroy ();
+}
+
+// Legacy HELLOs, the default, keep the original wire format: one bare FloodingHeader per beacon
+class DvhopLegacyHelloTestCase : public TestCase
+{
+public:
+  DvhopLegacyHelloTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void HelloTx (Ptr<const Packet> packet, Ipv4Address address);
+
+  uint32_t m_hellos;
+  bool m_bare;                                        // Every HELLO is a bare FloodingHeader
+};
+
+DvhopLegacyHelloTestCase::DvhopLegacyHelloTestCase ()
+  : TestCase ("Legacy HELLOs on the original wire format"),
+    m_hellos (0),
+    m_bare (true)
+{
+}
+
+void
+DvhopLegacyHelloTestCase::HelloTx (Ptr<const Packet> packet, Ipv4Address address)
+{
+  if (!IsHello (packet))
+    {
+      return;
+    }
+  dvhop::TypeHeader type;
+  packet->PeekHeader (type);
+  m_hellos++;
+  m_bare = m_bare && !type.IsValid () && packet->GetSize () == dvhop::FloodingHeader ().GetSerializedSize ();
+}
+
+void
+DvhopLegacyHelloTestCase::DoRun (void)
+{
+  // B1 - N - M, 100 m apart: M only learns B1 through the HELLOs of N
+  std::vector<Vector> positions;
+  positions.push_back (Vector (0, 0, 0));
+  positions.push_back (Vector (100, 0, 0));
+  positions.push_back (Vector (200, 0, 0));
+  DVHopHelper dvhop;
+  NodeContainer nodes = CreateDvhopNetwork (positions, std::vector<uint32_t> (1, 0), dvhop);
+  GetDvhop (nodes.Get (1))->TraceConnectWithoutContext ("HelloTx", MakeCallback (&DvhopLegacyHelloTestCase::HelloTx, this));
+
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_GT (m_hellos, 0, "N relays B1");
+  NS_TEST_ASSERT_MSG_EQ (m_bare, true, "Legacy HELLOs carry no TypeHeader");
+  NS_TEST_ASSERT_MSG_EQ (GetDvhop (nodes.Get (2))->GetDistanceTable ().GetHopsTo (Ipv4Address ("10.0.0.1")), 2, "M learns B1 from the bare HELLOs");
+  Simulator::Destroy ();
+}
+
+// Triggered updates: a jittered send after an improvement, bursts coalesced
+// under the hold-down, and a long chain learning a beacon in a fraction of
+// a HELLO interval
+class DvhopTriggeredUpdateTestCase : public TestCase
+{
+public:
+  DvhopTriggeredUpdateTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+  void HelloTx (Ptr<const Packet> packet, Ipv4Address address);
+  void ChainEnd (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+
+  std::vector<Time> m_updates;
+  std::vector<Time> m_frames;
+  Time m_reached;
+  uint16_t m_reachedHops;
+};
+
+DvhopTriggeredUpdateTestCase::DvhopTriggeredUpdateTestCase ()
+  : TestCase ("Triggered updates"),
+    m_reachedHops (0)
+{
+}
+
+void
+DvhopTriggeredUpdateTestCase::TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops)
+{
+  m_updates.push_back (Simulator::Now ());
+}
+
+void
+DvhopTriggeredUpdateTestCase::HelloTx (Ptr<const Packet> packet, Ipv4Address address)
+{
+  if (!IsHello (packet))
+    {
+      return;
+    }
+  m_frames.push_back (Simulator::Now ());
+}
+
+void
+DvhopTriggeredUpdateTestCase::ChainEnd (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops)
+{
+  if (newHops != 0 && m_reachedHops == 0)
+    {
+      m_reached = Simulator::Now ();
+      m_reachedHops = newHops;
+    }
+}
+
+void
+DvhopTriggeredUpdateTestCase::DoRun (void)
+{
+  // Every node sends its first HELLO one interval after the start: with a long interval,
+  // the beacons only spread through triggered updates until the second one
+  const Time helloInterval = Seconds (10);
+  const Time jitter = MilliSeconds (5);
+  const Time holdDown = MilliSeconds (500);
+
+  // Five beacons 50 m around node 0, which learns them within the 10 ms of broadcast jitter
+  std::vector<Vector> positions (1, Vector (500, 500, 0));
+  std::vector<uint32_t> beacons;
+  for (uint32_t b = 0; b < 5; ++b)
+    {
+      positions.push_back (Vector (500 + 50 * std::cos (2 * M_PI * b / 5), 500 + 50 * std::sin (2 * M_PI * b / 5), 0));
+      beacons.push_back (b + 1);
+    }
+  DVHopHelper dvhop;
+  dvhop.Set ("HelloInterval", TimeValue (helloInterval));
+  dvhop.Set ("HelloFormat", EnumValue (dvhop::RoutingProtocol::AGGREGATED_HELLO));
+  dvhop.Set ("TriggeredUpdateJitter", TimeValue (jitter));
+  dvhop.Set ("TriggeredUpdateHoldDown", TimeValue (holdDown));
+  NodeContainer nodes = CreateDvhopNetwork (positions, beacons, dvhop);
+  Ptr<dvhop::RoutingProtocol> hub = GetDvhop (nodes.Get (0));
+  hub->TraceConnectWithoutContext ("TableUpdate", MakeCallback (&DvhopTriggeredUpdateTestCase::TableUpdate, this));
+  hub->TraceConnectWithoutContext ("HelloTx", MakeCallback (&DvhopTriggeredUpdateTestCase::HelloTx, this));
+
+  Simulator::Stop (helloInterval + Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_updates.size (), 5, "One improvement per beacon");
+  NS_TEST_ASSERT_MSG_GT (m_frames.size (), 0, "The improvements are advertised before the next HELLO");
+  NS_TEST_ASSERT_MSG_LT (m_frames.size (), m_updates.size (), "The burst is coalesced");
+  if (!m_updates.empty () && !m_frames.empty ())
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_frames[0] >= m_updates[0] && m_frames[0] <= m_updates[0] + jitter), true,
+                             "The first update is sent within the jitter of the first improvement");
+    }
+  for (uint32_t i = 1; i < m_frames.size (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_frames[i] - m_frames[i - 1] >= holdDown), true, "Triggered updates are held down");
+    }
+  Simulator::Destroy ();
+
+  // A beacon at the end of a 24 hop chain, 100 m apart on a unit disk of 110 m
+  const uint32_t length = 25;
+  positions.clear ();
+  for (uint32_t i = 0; i < length; ++i)
+    {
+      positions.push_back (Vector (100.0 * i, 0, 0));
+    }
+  nodes = CreateDvhopNetwork (positions, std::vector<uint32_t> (1, 0), dvhop);
+  GetDvhop (nodes.Get (length - 1))->TraceConnectWithoutContext ("TableUpdate", MakeCallback (&DvhopTriggeredUpdateTestCase::ChainEnd, this));
+
+  Simulator::Stop (helloInterval + Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_reachedHops, length - 1, "The far end learns the beacon");
+  // At most 5 ms of trigger jitter and 10 ms of broadcast jitter per hop
+  NS_TEST_ASSERT_MSG_LT (m_reached, helloInterval + MilliSeconds (500), "Well under a second across the chain");
+  Simulator::Destroy ();
+}
+
+// Trickle: the interval doubles up to Imax while the tables are consistent,
+// falls back to Imin on a shorter path, and k consistent advertisements
+// suppress the HELLO of an interval
+class DvhopTrickleTestCase : public TestCase
+{
+public:
+  DvhopTrickleTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+  void RecordInterval ();
+  void BecomeBeacon (Ptr<dvhop::RoutingProtocol> protocol);
+  void HelloTx (Ptr<const Packet> packet, Ipv4Address address);
+
+  Ptr<dvhop::RoutingProtocol> m_watched;
+  std::vector<Time> m_intervals;
+  uint32_t m_frames;
+};
+
+DvhopTrickleTestCase::DvhopTrickleTestCase ()
+  : TestCase ("Trickle HELLO timer"),
+    m_frames (0)
+{
+}
+
+void
+DvhopTrickleTestCase::TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops)
+{
+  // The interval is reset right after the trace
+  if (Simulator::Now () >= Seconds (20))
+    {
+      Simulator::ScheduleNow (&DvhopTrickleTestCase::RecordInterval, this);
+    }
+}
+
+void
+DvhopTrickleTestCase::RecordInterval ()
+{
+  m_intervals.push_back (m_watched->GetTrickleInterval ());
+}
+
+void
+DvhopTrickleTestCase::BecomeBeacon (Ptr<dvhop::RoutingProtocol> protocol)
+{
+  RecordInterval ();
+  protocol->SetIsBeacon (true);
+  protocol->SetPosition (200, 0);
+}
+
+void
+DvhopTrickleTestCase::HelloTx (Ptr<const Packet> packet, Ipv4Address address)
+{
+  if (!IsHello (packet))
+    {
+      return;
+    }
+  ++m_frames;
+}
+
+void
+DvhopTrickleTestCase::DoRun (void)
+{
+  const Time imin = MilliSeconds (100);
+  const Time imax = MilliSeconds (1600);
+
+  // A beacon and two nodes in a line; the last one turns into a beacon at 20 s, a new
+  // beacon at one hop for the middle node
+  std::vector<Vector> positions;
+  positions.push_back (Vector (0, 0, 0));
+  positions.push_back (Vector (100, 0, 0));
+  positions.push_back (Vector (200, 0, 0));
+  DVHopHelper dvhop;
+  dvhop.Set ("Trickle", BooleanValue (true));
+  dvhop.Set ("HelloFormat", EnumValue (dvhop::RoutingProtocol::AGGREGATED_HELLO));
+  dvhop.Set ("TrickleImin", TimeValue (imin));
+  dvhop.Set ("TrickleImax", TimeValue (imax));
+  dvhop.Set ("TrickleK", UintegerValue (0));
+  NodeContainer nodes = CreateDvhopNetwork (positions, std::vector<uint32_t> (1, 0), dvhop);
+  m_watched = GetDvhop (nodes.Get (1));
+  Simulator::Schedule (Seconds (20), &DvhopTrickleTestCase::BecomeBeacon, this, GetDvhop (nodes.Get (2)));
+  m_watched->TraceConnectWithoutContext ("TableUpdate", MakeCallback (&DvhopTrickleTestCase::TableUpdate, this));
+
+  Simulator::Stop (Seconds (30));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_GT (m_intervals.size (), 1, "The new beacon reached the middle node");
+  if (m_intervals.size () > 1)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_intervals[0], imax, "Doubled up to Imax while consistent");
+      NS_TEST_ASSERT_MSG_EQ (m_intervals[1], imin, "Back to Imin on a shorter path");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_watched->GetSuppressedHellos (), 0, "TrickleK 0 never suppresses");
+  Simulator::Destroy ();
+  m_watched = 0;
+
+  // A beacon and eight nodes within range of each other: with k = 1 the first HELLO of
+  // an interval suppresses most of the others
+  positions.clear ();
+  for (uint32_t i = 0; i < 9; ++i)
+    {
+      positions.push_back (Vector (10.0 * (i % 3), 10.0 * (i / 3), 0));
+    }
+  uint32_t frames[2];
+  uint32_t suppressed[2];
+  for (uint32_t k = 0; k < 2; ++k)
+    {
+      dvhop.Set ("TrickleK", UintegerValue (k));
+      nodes = CreateDvhopNetwork (positions, std::vector<uint32_t> (1, 0), dvhop);
+      m_frames = 0;
+      for (uint32_t i = 0; i < nodes.GetN (); ++i)
+        {
+          GetDvhop (nodes.Get (i))->TraceConnectWithoutContext ("HelloTx", MakeCallback (&DvhopTrickleTestCase::HelloTx, this));
+        }
+      Simulator::Stop (Seconds (30));
+      Simulator::Run ();
+      frames[k] = m_frames;
+      suppressed[k] = 0;
+      for (uint32_t i = 0; i < nodes.GetN (); ++i)
+        {
+          suppressed[k] += GetDvhop (nodes.Get (i))->GetSuppressedHellos ();
+        }
+      Simulator::Destroy ();
+    }
+  NS_TEST_ASSERT_MSG_EQ (suppressed[0], 0, "Nothing suppressed without k");
+  NS_TEST_ASSERT_MSG_GT (suppressed[1], 0, "HELLOs suppressed with k = 1");
+  NS_TEST_ASSERT_MSG_LT (2 * frames[1], frames[0], "Less than half the HELLOs in a clique");
+}
+
+// Duplicate cache: stale and repeated advertisements are rejected, also
+// across the wraparound of the 16 bit sequence numbers
+class DvhopDuplicateCacheTestCase : public TestCase
+{
+public:
+  DvhopDuplicateCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopDuplicateCacheTestCase::DvhopDuplicateCacheTestCase ()
+  : TestCase ("Duplicate cache with wraparound-safe sequence numbers")
+{
+}
+
+void
+DvhopDuplicateCacheTestCase::DoRun (void)
+{
+  dvhop::DuplicateCache cache;
+  Ipv4Address beacon ("10.0.0.7");
+
+  NS_TEST_ASSERT_MSG_EQ (cache.IsFresh (beacon, 65534, 3), true, "First advertisement must be fresh");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsFresh (beacon, 65534, 3), false, "Repeated advertisement must be dropped");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsFresh (beacon, 65534, 4), false, "Longer path, same seqNo, must be dropped");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsFresh (beacon, 65534, 2), true, "Shorter path, same seqNo, must be fresh");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsFresh (beacon, 1, 5), true, "Sequence number after the wraparound must be fresh");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsFresh (beacon, 65535, 1), false, "Sequence number before the wraparound must be stale");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsFresh (Ipv4Address ("10.0.0.8"), 65535, 1), true, "Other beacons are independent");
+
+  NS_TEST_ASSERT_MSG_EQ (dvhop::SeqNoIsNewer (0, 65535), true, "0 follows 65535");
+  NS_TEST_ASSERT_MSG_EQ (dvhop::SeqNoIsNewer (65535, 0), false, "65535 precedes 0");
+  NS_TEST_ASSERT_MSG_EQ (dvhop::SeqNoIsNewer (10, 10), false, "A sequence number is not newer than itself");
+}
+
+// Flat distance table: entries kept in address order through inserts,
+// replacements and removals, and visited in that order by ForEach
+class DvhopFlatTableTestCase : public TestCase
+{
+public:
+  DvhopFlatTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopFlatTableTestCase::DvhopFlatTableTestCase ()
+  : TestCase ("Flat distance table")
+{
+}
+
+void
+DvhopFlatTableTestCase::DoRun (void)
+{
+  dvhop::DistanceTable table;
+  // Inserted out of address order, at x = i
+  uint32_t addresses[] = { 0x0a000009, 0x0a000002, 0x0a000010, 0x0a000001, 0x0a000005, 0x0b000000 };
+  uint16_t distances[] = { 4, 6, 3, 5, 7, 2 };
+  for (uint32_t i = 0; i < 6; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.AddBeacon (Ipv4Address (addresses[i]), distances[i], i, -1.0 * i, 10 + i), true, "Inserted");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 6, "Six entries");
+
+  // Replace: a shorter path keeps the position and records the new sequence number
+  table.AddBeacon (Ipv4Address (0x0a000002), 1, 99.0, 99.0, 20);
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 6, "Replacing does not insert");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (Ipv4Address (0x0a000002)), 1, "Replaced hops");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSequenceNumber (Ipv4Address (0x0a000002)), 20, "Replaced sequence number");
+  NS_TEST_ASSERT_MSG_EQ (table.GetBeaconPosition (Ipv4Address (0x0a000002)).first, 1.0, "The position is kept");
+
+  std::vector<Ipv4Address> visited;
+  std::vector<uint16_t> hops;
+  std::vector<double> xs;
+  table.ForEach ([&visited, &hops, &xs] (Ipv4Address beacon, dvhop::BeaconInfo const &info)
+    {
+      visited.push_back (beacon);
+      hops.push_back (info.GetHops ());
+      xs.push_back (info.GetPosition ().first);
+    });
+  uint32_t sorted[] = { 0x0a000001, 0x0a000002, 0x0a000005, 0x0a000009, 0x0a000010, 0x0b000000 };
+  uint16_t sortedHops[] = { 5, 1, 7, 4, 3, 2 };
+  double sortedX[] = { 3, 1, 4, 0, 2, 5 };
+  NS_TEST_ASSERT_MSG_EQ (visited.size (), 6, "Every entry is visited once");
+  for (uint32_t i = 0; i < visited.size (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (visited[i], Ipv4Address (sorted[i]), "Visited in address order");
+      NS_TEST_ASSERT_MSG_EQ (hops[i], sortedHops[i], "Hops of the entry");
+      NS_TEST_ASSERT_MSG_EQ (xs[i], sortedX[i], "Position of the entry");
+    }
+
+  // Removal through a hop radius: the entries beyond it leave, the others keep their order
+  table.SetHorizon (0, 3);
+  std::vector<Ipv4Address> kept = table.GetKnownBeacons ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), kept.size (), "Size follows the removals");
+  NS_TEST_ASSERT_MSG_EQ (kept.size (), 3, "Three entries within 3 hops");
+  NS_TEST_ASSERT_MSG_EQ (kept[0], Ipv4Address (0x0a000002), "First kept entry");
+  NS_TEST_ASSERT_MSG_EQ (kept[1], Ipv4Address (0x0a000010), "Second kept entry");
+  NS_TEST_ASSERT_MSG_EQ (kept[2], Ipv4Address (0x0b000000), "Third kept entry");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (Ipv4Address (0x0a000001)), 0, "Removed entries are not found");
+  NS_TEST_ASSERT_MSG_EQ (table.GetBeaconPosition (Ipv4Address (0x0b000000)).second, -5.0, "Positions follow their entries");
+
+  // Inserting after removals keeps the order
+  table.AddBeacon (Ipv4Address (0x0a000003), 2, 7.0, 7.0, 1);
+  kept = table.GetKnownBeacons ();
+  NS_TEST_ASSERT_MSG_EQ (kept.size (), 4, "Inserted after the removals");
+  NS_TEST_ASSERT_MSG_EQ (kept[1], Ipv4Address (0x0a000003), "Inserted in address order");
+}
+
+// Distance table change tracking used by the delta HELLOs: only a change
+// of hops (or a new beacon) makes an entry advertised again
+class DvhopTableGenerationTestCase : public TestCase
+{
+public:
+  DvhopTableGenerationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopTableGenerationTestCase::DvhopTableGenerationTestCase ()
+  : TestCase ("Distance table change tracking")
+{
+}
+
+void
+DvhopTableGenerationTestCase::DoRun (void)
+{
+  dvhop::DistanceTable table;
+  Ipv4Address b1 ("10.0.0.1");
+  Ipv4Address b2 ("10.0.0.2");
+
+  table.AddBeacon (b1, 3, 0.0, 0.0, 1);
+  table.AddBeacon (b2, 5, 50.0, 0.0, 1);
+  uint32_t advertised = table.GetGeneration ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetChangedBeacons (0).size (), 2, "Both beacons are new");
+  NS_TEST_ASSERT_MSG_EQ (table.GetChangedBeacons (advertised).size (), 0, "Nothing changed yet");
+
+  table.RefreshBeacon (b1, 2);
+  table.AddBeacon (b2, 5, 50.0, 0.0, 2);
+  NS_TEST_ASSERT_MSG_EQ (table.GetChangedBeacons (advertised).size (), 0, "A new sequence number alone is not a change");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSequenceNumber (b1), 2, "Refresh must record the sequence number");
+
+  table.AddBeacon (b2, 4, 50.0, 0.0, 3);
+  std::vector<Ipv4Address> changed = table.GetChangedBeacons (advertised);
+  NS_TEST_ASSERT_MSG_EQ (changed.size (), 1, "Only the shorter path changed");
+  NS_TEST_ASSERT_MSG_EQ (changed[0], b2, "Wrong changed beacon");
+}
+
+// Bounded horizon: only the K nearest beacons within the hop radius are kept
+class DvhopTableHorizonTestCase : public TestCase
+{
+public:
+  DvhopTableHorizonTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopTableHorizonTestCase::DvhopTableHorizonTestCase ()
+  : TestCase ("Distance table K-nearest horizon")
+{
+}
+
+void
+DvhopTableHorizonTestCase::DoRun (void)
+{
+  dvhop::DistanceTable table;
+  Ipv4Address b1 ("10.0.0.1"), b2 ("10.0.0.2"), b3 ("10.0.0.3"), b4 ("10.0.0.4");
+
+  table.SetHorizon (2, 5);
+  NS_TEST_ASSERT_MSG_EQ (table.AddBeacon (b1, 4, 0.0, 0.0), true, "Room left");
+  NS_TEST_ASSERT_MSG_EQ (table.AddBeacon (b2, 2, 0.0, 0.0), true, "Room left");
+  NS_TEST_ASSERT_MSG_EQ (table.AddBeacon (b3, 6, 0.0, 0.0), false, "Beyond the hop radius");
+  NS_TEST_ASSERT_MSG_EQ (table.AddBeacon (b3, 5, 0.0, 0.0), false, "Farther than every kept beacon");
+  NS_TEST_ASSERT_MSG_EQ (table.AddBeacon (b4, 3, 0.0, 0.0), true, "Nearer than b1");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 2, "Bounded to two entries");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (b1), 0, "b1 was evicted");
+
+  std::vector<Ipv4Address> nearest = table.GetNearestBeacons (5);
+  NS_TEST_ASSERT_MSG_EQ (nearest.size (), 2, "Only two beacons known");
+  NS_TEST_ASSERT_MSG_EQ (nearest[0], b2, "b2 is the nearest");
+  NS_TEST_ASSERT_MSG_EQ (nearest[1], b4, "b4 comes next");
+
+  table.AddBeacon (b4, 1, 0.0, 0.0);
+  NS_TEST_ASSERT_MSG_EQ (table.GetNearestBeacons (1)[0], b4, "The hop index follows hop changes");
+
+  table.SetHorizon (1, 0);
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 1, "Shrinking the horizon evicts");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (b4), 1, "The nearest one stays");
+}
+
+// Entry lifetimes enforced by the timer wheel of the table
+class DvhopTableExpiryTestCase : public TestCase
+{
+public:
+  DvhopTableExpiryTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void ExpireLate (void);
+};
+
+DvhopTableExpiryTestCase::DvhopTableExpiryTestCase ()
+  : TestCase ("Distance table entry expiry")
+{
+}
+
+void
+DvhopTableExpiryTestCase::DoRun (void)
+{
+  dvhop::DistanceTable table;
+  Ipv4Address b1 ("10.0.0.1"), b2 ("10.0.0.2");
+
+  table.SetLifetime (Seconds (16));
+  NS_TEST_ASSERT_MSG_EQ (table.GetExpiryTick (), Seconds (1), "Sixteen ticks per lifetime");
+  table.AddBeacon (b1, 1, 0.0, 0.0);
+  table.AddBeacon (b2, 2, 0.0, 0.0);
+
+  // Evicting b2 and learning it again leaves a stale record in the wheel
+  table.SetHorizon (1, 0);
+  table.SetHorizon (0, 0);
+  table.AddBeacon (b2, 2, 0.0, 0.0);
+
+  NS_TEST_ASSERT_MSG_EQ (table.Expire (Seconds (15)), 0, "Nothing expires before the lifetime");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 2, "Both entries are alive");
+  NS_TEST_ASSERT_MSG_EQ (table.Expire (Seconds (16)), 2, "Both entries expire once, the stale record is ignored");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 0, "The table is empty");
+  NS_TEST_ASSERT_MSG_EQ (table.Expire (Seconds (100)), 0, "The wheel is empty");
+
+  Simulator::Schedule (Seconds (5), &DvhopTableExpiryTestCase::ExpireLate, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+DvhopTableExpiryTestCase::ExpireLate (void)
+{
+  // Nanosecond ticks: five seconds in, the wheel is past tick 2^32
+  dvhop::DistanceTable table;
+  table.SetLifetime (NanoSeconds (16));
+  NS_TEST_ASSERT_MSG_EQ (table.GetExpiryTick (), NanoSeconds (1), "Sixteen ticks per lifetime");
+  table.AddBeacon (Ipv4Address ("10.0.0.1"), 1, 0.0, 0.0);
+  NS_TEST_ASSERT_MSG_EQ (table.Expire (Simulator::Now () + NanoSeconds (15)), 0, "Nothing expires before the lifetime");
+  NS_TEST_ASSERT_MSG_EQ (table.Expire (Simulator::Now () + NanoSeconds (16)), 1, "Expired on its 64-bit tick");
+}
+
+// Tables stored in a shared arena behave like flat ones, and share the beacons
+class DvhopTableArenaTestCase : public TestCase
+{
+public:
+  DvhopTableArenaTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopTableArenaTestCase::DvhopTableArenaTestCase ()
+  : TestCase ("Distance tables in a shared arena")
+{
+}
+
+void
+DvhopTableArenaTestCase::DoRun (void)
+{
+  Ptr<dvhop::DistanceTableArena> arena = Create<dvhop::DistanceTableArena> ();
+  dvhop::DistanceTable t1, t2;
+  t1.UseArena (arena);
+  t2.UseArena (arena);
+
+  // Two tables sharing the interned beacons, each with its own entries
+  for (uint32_t i = 1; i <= 100; ++i)
+    {
+      t1.AddBeacon (Ipv4Address (0x0a000000 + i), i, i, 2.0 * i, 1);
+      if (i % 2 == 0)
+        {
+          t2.AddBeacon (Ipv4Address (0x0a000000 + i), 1, -1.0, -1.0, 1);
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (arena->GetNBeacons (), 100, "Each beacon is interned once");
+  NS_TEST_ASSERT_MSG_EQ (t1.GetSize (), 100, "t1 knows every beacon");
+  NS_TEST_ASSERT_MSG_EQ (t2.GetSize (), 50, "t2 knows half of them");
+  NS_TEST_ASSERT_MSG_EQ (t1.GetHopsTo (Ipv4Address (0x0a000000 + 40)), 40, "t1 hops");
+  NS_TEST_ASSERT_MSG_EQ (t2.GetHopsTo (Ipv4Address (0x0a000000 + 40)), 1, "Tables are independent");
+  NS_TEST_ASSERT_MSG_EQ (t2.GetHopsTo (Ipv4Address (0x0a000000 + 41)), 0, "t2 does not know odd beacons");
+  NS_TEST_ASSERT_MSG_EQ (t1.GetBeaconPosition (Ipv4Address (0x0a000000 + 40)).second, 80.0, "Each table keeps the position it heard");
+  NS_TEST_ASSERT_MSG_EQ (t2.GetBeaconPosition (Ipv4Address (0x0a000000 + 40)).second, -1.0, "Each table keeps the position it heard");
+
+  // A move reaches only the table that heard it, and returns to a shared position
+  Ipv4Address moved (0x0a000000 + 4);
+  NS_TEST_ASSERT_MSG_EQ (t1.MoveBeacon (moved, 5.0, 6.0), true, "The beacon moved for t1");
+  NS_TEST_ASSERT_MSG_EQ (t1.MoveBeacon (moved, 5.0, 6.0), false, "Already there");
+  NS_TEST_ASSERT_MSG_EQ ((t1.GetBeaconPosition (moved) == dvhop::Position (5.0, 6.0)), true, "t1 sees the new position");
+  NS_TEST_ASSERT_MSG_EQ ((t2.GetBeaconPosition (moved) == dvhop::Position (-1.0, -1.0)), true, "t2 has not heard the move");
+  NS_TEST_ASSERT_MSG_EQ (t2.MoveBeacon (moved, 5.0, 6.0), true, "The beacon moved for t2 as well");
+  NS_TEST_ASSERT_MSG_EQ ((t2.GetBeaconPosition (moved) == dvhop::Position (5.0, 6.0)), true, "t2 sees the new position");
+  NS_TEST_ASSERT_MSG_EQ (t1.GetHopsTo (moved), 4, "Moves keep the hops");
+
+  uint32_t generation = t2.GetGeneration ();
+  t2.AddBeacon (Ipv4Address (0x0a000000 + 2), 3, 0.0, 0.0, 2);
+  NS_TEST_ASSERT_MSG_EQ (t2.GetChangedBeacons (generation).size (), 1, "Change tracking works on arena tables");
+  uint32_t visited = 0;
+  t2.ForEach ([&visited] (Ipv4Address beacon, dvhop::BeaconInfo const &info)
+    {
+      visited += beacon.Get () % 2 == 0 ? 1 : 100;
+    });
+  NS_TEST_ASSERT_MSG_EQ (visited, 50, "ForEach only visits the entries of the table");
+
+  t1.SetHorizon (10, 0);
+  NS_TEST_ASSERT_MSG_EQ (t1.GetSize (), 10, "The horizon evicts from arena tables");
+  NS_TEST_ASSERT_MSG_EQ (t1.GetNearestBeacons (1)[0], Ipv4Address (0x0a000000 + 1), "Nearest beacon");
+  NS_TEST_ASSERT_MSG_EQ (t2.GetNearestBeacons (50).size (), 50, "Nearest beacons without a horizon");
+  NS_TEST_ASSERT_MSG_EQ (t1.GetHopsTo (Ipv4Address (0x0a000000 + 11)), 0, "Evicted entries leave the table");
+  NS_TEST_ASSERT_MSG_EQ (t1.AddBeacon (Ipv4Address (0x0a000000 + 11), 11, 0.0, 0.0, 1), false, "Out of the horizon");
+}
+
+// Multipoint relay selection over a known 2-hop neighbourhood, and the
+// neighbour HELLO that carries it
+class DvhopMprSelectionTestCase : public TestCase
+{
+public:
+  DvhopMprSelectionTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopMprSelectionTestCase::DvhopMprSelectionTestCase ()
+  : TestCase ("Multipoint relay selection")
+{
+}
+
+void
+DvhopMprSelectionTestCase::DoRun (void)
+{
+  Ipv4Address n1 ("10.0.0.1"), n2 ("10.0.0.2"), n3 ("10.0.0.3");
+  Ipv4Address t1 ("10.0.1.1"), t2 ("10.0.1.2"), t3 ("10.0.1.3"), t4 ("10.0.1.4");
+
+  // n1 alone reaches t1; n2 reaches t2, t3, t4; n3 reaches t3 and t4
+  std::vector<Ipv4Address> l1, l2, l3;
+  l1.push_back (t1); l1.push_back (t2);
+  l2.push_back (t2); l2.push_back (t3); l2.push_back (t4); l2.push_back (n3);
+  l3.push_back (t3); l3.push_back (t4); l3.push_back (n2);
+
+  dvhop::NeighborTable table;
+  table.Update (n1, l1, false, Seconds (3));
+  table.Update (n2, l2, false, Seconds (3));
+  table.Update (n3, l3, true, Seconds (2));
+  NS_TEST_ASSERT_MSG_EQ (table.HasMprSelectors (), true, "n3 selected this node");
+
+  std::set<Ipv4Address> mprs = table.ComputeMprSet ();
+  NS_TEST_ASSERT_MSG_EQ (mprs.size (), 2, "n1 and n2 cover the whole 2-hop neighbourhood");
+  NS_TEST_ASSERT_MSG_EQ (mprs.count (n1), 1, "n1 is the only way to t1");
+  NS_TEST_ASSERT_MSG_EQ (mprs.count (n2), 1, "n2 covers the most of what is left");
+
+  table.Purge (Seconds (2));
+  NS_TEST_ASSERT_MSG_EQ (table.GetNeighbors ().size (), 2, "n3 expired");
+  NS_TEST_ASSERT_MSG_EQ (table.HasMprSelectors (), false, "The selector expired with n3");
+
+  dvhop::NeighborHelloHeader hello;
+  hello.AddNeighbor (n1, true);
+  hello.AddNeighbor (n2, false);
+  Ptr<Packet> p = Create<Packet> ();
+  p->AddHeader (hello);
+  NS_TEST_ASSERT_MSG_EQ (p->GetSize (), 12, "Two neighbours take 2 + 2 * 5 bytes");
+  dvhop::NeighborHelloHeader received;
+  p->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetNNeighbors (), 2, "Neighbour count");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNeighbor (0), n1, "First neighbour");
+  NS_TEST_ASSERT_MSG_EQ (received.IsMpr (0), true, "First neighbour is MPR");
+  NS_TEST_ASSERT_MSG_EQ (received.IsMpr (1), false, "Second neighbour is not MPR");
+}
+
+// Hop size corrections on the wire, and the table removals beacons use to keep
+// their hop size sums up to date
+class DvhopHopSizeTestCase : public TestCase
+{
+public:
+  DvhopHopSizeTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Removed (Ipv4Address beacon, uint16_t hops, dvhop::Position pos);
+
+  uint32_t m_removedHops;
+};
+
+DvhopHopSizeTestCase::DvhopHopSizeTestCase ()
+  : TestCase ("Hop size corrections"),
+    m_removedHops (0)
+{
+}
+
+void
+DvhopHopSizeTestCase::Removed (Ipv4Address beacon, uint16_t hops, dvhop::Position pos)
+{
+  m_removedHops += hops;
+}
+
+void
+DvhopHopSizeTestCase::DoRun (void)
+{
+  Ipv4Address b1 ("10.0.0.1"), b2 ("10.0.0.2"), b3 ("10.0.0.3");
+
+  dvhop::HopSizeHeader hopSize (b1, 7, 3, 41.25);
+  Ptr<Packet> p = Create<Packet> ();
+  p->AddHeader (hopSize);
+  NS_TEST_ASSERT_MSG_EQ (p->GetSize (), 16, "Hop size header size");
+  dvhop::HopSizeHeader received;
+  p->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetBeaconAddress (), b1, "Originator");
+  NS_TEST_ASSERT_MSG_EQ (received.GetSequenceNumber (), 7, "Sequence number");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHopCount (), 3, "Hop count");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHopSize (), 41.25, "The hop size is carried exactly");
+
+  dvhop::DistanceTable table;
+  table.SetRemovalCallback (MakeCallback (&DvhopHopSizeTestCase::Removed, this));
+  table.AddBeacon (b1, 1, 0.0, 0.0);
+  table.AddBeacon (b2, 2, 0.0, 0.0);
+  table.AddBeacon (b3, 4, 0.0, 0.0);
+  table.SetHorizon (0, 2);
+  NS_TEST_ASSERT_MSG_EQ (m_removedHops, 4, "b3 is reported with its hops when it leaves the radius");
+  table.SetHorizon (1, 0);
+  NS_TEST_ASSERT_MSG_EQ (m_removedHops, 6, "b2 is reported when evicted");
+
+  uint32_t generation = table.GetGeneration ();
+  NS_TEST_ASSERT_MSG_EQ (table.MoveBeacon (b1, 0.0, 0.0), false, "Same position");
+  NS_TEST_ASSERT_MSG_EQ (table.MoveBeacon (b1, 3.0, 4.0), true, "New position");
+  NS_TEST_ASSERT_MSG_EQ (table.GetBeaconPosition (b1).second, 4.0, "The position follows the beacon");
+  NS_TEST_ASSERT_MSG_EQ (table.GetChangedBeacons (generation).size (), 1, "A move is advertised like a new path");
+}
+
+// Hop size corrections in a network: each node takes and relays those of its
+// nearest beacon only, each once, and the beacons follow a beacon that moves
+class DvhopHopSizeFloodTestCase : public TestCase
+{
+public:
+  DvhopHopSizeFloodTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Sent (Ptr<const Packet> packet);
+  void Heard (Ptr<const Packet> packet);
+  static bool GetCorrection (Ptr<const Packet> packet, std::pair<Ipv4Address, uint16_t> &correction);
+
+  std::map<std::pair<Ipv4Address, uint16_t>, uint32_t> m_sent;    // Times each correction was relayed
+  std::map<std::pair<Ipv4Address, uint16_t>, uint32_t> m_heard;
+};
+
+DvhopHopSizeFloodTestCase::DvhopHopSizeFloodTestCase ()
+  : TestCase ("Hop size corrections of the nearest beacon")
+{
+}
+
+bool
+DvhopHopSizeFloodTestCase::GetCorrection (Ptr<const Packet> packet, std::pair<Ipv4Address, uint16_t> &correction)
+{
+  Ptr<Packet> copy = packet->Copy ();
+  Ipv4Header ipv4;
+  UdpHeader udp;
+  dvhop::TypeHeader type;
+  copy->RemoveHeader (ipv4);
+  copy->RemoveHeader (udp);
+  copy->RemoveHeader (type);
+  if (type.Get () != dvhop::DVHOPTYPE_HOP_SIZE)
+    {
+      return false;
+    }
+  dvhop::HopSizeHeader hopSize;
+  copy->RemoveHeader (hopSize);
+  correction = std::make_pair (hopSize.GetBeaconAddress (), hopSize.GetSequenceNumber ());
+  return true;
+}
+
+void
+DvhopHopSizeFloodTestCase::Sent (Ptr<const Packet> packet)
+{
+  std::pair<Ipv4Address, uint16_t> correction;
+  if (GetCorrection (packet, correction))
+    {
+      m_sent[correction]++;
+    }
+}
+
+void
+DvhopHopSizeFloodTestCase::Heard (Ptr<const Packet> packet)
+{
+  std::pair<Ipv4Address, uint16_t> correction;
+  if (GetCorrection (packet, correction))
+    {
+      m_heard[correction]++;
+    }
+}
+
+void
+DvhopHopSizeFloodTestCase::DoRun (void)
+{
+  // B1 - n1 - n2 - n3 - B2 - n4 - B3 on a line, 100 m apart but the last 60 m.
+  // Hop sizes: B1 (400 + 560) / (4 + 6) = 96, B2 (400 + 160) / (4 + 2) = 93.3
+  double xs[] = { 0, 100, 200, 300, 400, 500, 560 };
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < 7; ++i)
+    {
+      positions.push_back (Vector (xs[i], 0, 0));
+    }
+  std::vector<uint32_t> beacons;
+  beacons.push_back (0);
+  beacons.push_back (4);
+  beacons.push_back (6);
+  DVHopHelper dvhop;
+  NodeContainer nodes = CreateDvhopNetwork (positions, beacons, dvhop);
+  Ptr<NetDevice> device = nodes.Get (1)->GetDevice (0);
+  device->TraceConnectWithoutContext ("MacTx", MakeCallback (&DvhopHopSizeFloodTestCase::Sent, this));
+  device->TraceConnectWithoutContext ("MacRx", MakeCallback (&DvhopHopSizeFloodTestCase::Heard, this));
+
+  // B3 moves 20 m closer at 30 s: B1 (400 + 540) / 10 = 94, B2 (400 + 140) / 6 = 90
+  Simulator::Schedule (Seconds (30), &dvhop::RoutingProtocol::SetPosition, GetDvhop (nodes.Get (6)), 540.0, 0.0);
+  Simulator::Stop (Seconds (40));
+  Simulator::Run ();
+
+  Ptr<dvhop::RoutingProtocol> b1 = GetDvhop (nodes.Get (0));
+  Ptr<dvhop::RoutingProtocol> b2 = GetDvhop (nodes.Get (4));
+  NS_TEST_ASSERT_MSG_EQ_TOL (b1->GetHopSize (), 94, 1e-9, "B1 follows the move of B3");
+  NS_TEST_ASSERT_MSG_EQ_TOL (b2->GetHopSize (), 90, 1e-9, "B2 follows the move of B3");
+  NS_TEST_ASSERT_MSG_EQ (GetDvhop (nodes.Get (1))->GetHopSize (), b1->GetHopSize (), "n1 takes the correction of B1, one hop away");
+  NS_TEST_ASSERT_MSG_EQ (GetDvhop (nodes.Get (3))->GetHopSize (), b2->GetHopSize (), "n3 takes the correction of B2, one hop away");
+
+  Ipv4Address b1Address = nodes.Get (0)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  Ipv4Address b2Address = nodes.Get (4)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  uint32_t b1Relayed = 0, b1Heard = 0, b2Relayed = 0;
+  for (std::map<std::pair<Ipv4Address, uint16_t>, uint32_t>::const_iterator c = m_sent.begin (); c != m_sent.end (); ++c)
+    {
+      NS_TEST_ASSERT_MSG_EQ (c->second, 1, "Each correction is relayed once");
+      b1Relayed += c->first.first == b1Address ? 1 : 0;
+      b2Relayed += c->first.first == b2Address ? 1 : 0;
+    }
+  for (std::map<std::pair<Ipv4Address, uint16_t>, uint32_t>::const_iterator c = m_heard.begin (); c != m_heard.end (); ++c)
+    {
+      b1Heard += c->first.first == b1Address ? c->second : 0;
+    }
+  NS_TEST_ASSERT_MSG_GT (b1Relayed, 1, "The corrections of B1 are relayed");
+  NS_TEST_ASSERT_MSG_GT (b1Heard, b1Relayed, "Duplicates, relayed back by n2, are heard but not relayed");
+  // Only the first correction of B2 can get ahead of the one of B1
+  NS_TEST_ASSERT_MSG_LT (b2Relayed, 2, "The corrections of B2, three hops away, are ignored");
+  Simulator::Destroy ();
+}
+
+// What TableUpdate, TableSize and HelloTx report, as a beacon is learnt, then expires
+class DvhopTraceSourcesTestCase : public TestCase
+{
+public:
+  DvhopTraceSourcesTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+  void TableSize (uint32_t oldSize, uint32_t newSize);
+  void HelloTx (Ptr<const Packet> packet, Ipv4Address address);
+
+  Ptr<dvhop::RoutingProtocol> m_node;
+  std::vector<std::pair<Ipv4Address, std::pair<uint16_t, uint16_t> > > m_updates;
+  std::vector<uint32_t> m_sizes;
+  bool m_sizesMatch;                                  // Every reported size is the table size
+  std::set<Ipv4Address> m_senders;
+  std::map<dvhop::MessageType, uint32_t> m_types;
+};
+
+DvhopTraceSourcesTestCase::DvhopTraceSourcesTestCase ()
+  : TestCase ("Trace sources"),
+    m_sizesMatch (true)
+{
+}
+
+void
+DvhopTraceSourcesTestCase::TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops)
+{
+  m_updates.push_back (std::make_pair (beacon, std::make_pair (oldHops, newHops)));
+}
+
+void
+DvhopTraceSourcesTestCase::TableSize (uint32_t oldSize, uint32_t newSize)
+{
+  m_sizes.push_back (newSize);
+  m_sizesMatch = m_sizesMatch && newSize == m_node->GetDistanceTable ().GetSize ();
+}
+
+void
+DvhopTraceSourcesTestCase::HelloTx (Ptr<const Packet> packet, Ipv4Address address)
+{
+  m_senders.insert (address);
+  m_types[GetMessageType (packet)]++;
+}
+
+void
+DvhopTraceSourcesTestCase::DoRun (void)
+{
+  // B1 - N - B2, 100 m apart: N relays the HELLOs and the hop size corrections of both.
+  // B2 goes out of range at 20 s, and expires from the table of N 5 s later
+  std::vector<Vector> positions;
+  positions.push_back (Vector (0, 0, 0));
+  positions.push_back (Vector (100, 0, 0));
+  positions.push_back (Vector (200, 0, 0));
+  std::vector<uint32_t> beacons;
+  beacons.push_back (0);
+  beacons.push_back (2);
+  DVHopHelper dvhop;
+  dvhop.Set ("MprEnabled", BooleanValue (true));
+  dvhop.Set ("BeaconLifetime", TimeValue (Seconds (5)));
+  dvhop.Set ("HelloFormat", EnumValue (dvhop::RoutingProtocol::AGGREGATED_HELLO));
+  NodeContainer nodes = CreateDvhopNetwork (positions, beacons, dvhop);
+  m_node = GetDvhop (nodes.Get (1));
+  m_node->TraceConnectWithoutContext ("TableUpdate", MakeCallback (&DvhopTraceSourcesTestCase::TableUpdate, this));
+  m_node->TraceConnectWithoutContext ("TableSize", MakeCallback (&DvhopTraceSourcesTestCase::TableSize, this));
+  m_node->TraceConnectWithoutContext ("HelloTx", MakeCallback (&DvhopTraceSourcesTestCase::HelloTx, this));
+  Simulator::Schedule (Seconds (20), &MobilityModel::SetPosition, nodes.Get (2)->GetObject<MobilityModel> (), Vector (1000, 0, 0));
+  Simulator::Stop (Seconds (30));
+  Simulator::Run ();
+
+  Ipv4Address b1 ("10.0.0.1");
+  Ipv4Address b2 ("10.0.0.3");
+  NS_TEST_ASSERT_MSG_EQ (m_updates.size (), 3, "Two beacons learnt, one expired");
+  if (m_updates.size () == 3)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_updates[0].second == std::make_pair<uint16_t, uint16_t> (0, 1)), true, "Learnt at 1 hop");
+      NS_TEST_ASSERT_MSG_EQ ((m_updates[1].second == std::make_pair<uint16_t, uint16_t> (0, 1)), true, "Learnt at 1 hop");
+      NS_TEST_ASSERT_MSG_EQ ((m_updates[0].first == b1 || m_updates[0].first == b2), true, "A beacon");
+      NS_TEST_ASSERT_MSG_EQ ((m_updates[1].first == b1 || m_updates[1].first == b2), true, "A beacon");
+      NS_TEST_ASSERT_MSG_EQ (m_updates[2].first, b2, "B2 expires");
+      NS_TEST_ASSERT_MSG_EQ ((m_updates[2].second == std::make_pair<uint16_t, uint16_t> (1, 0)), true, "Removed from 1 hop");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_sizes.size (), 3, "One size change per table change");
+  if (m_sizes.size () == 3)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_sizes[0], 1, "First beacon");
+      NS_TEST_ASSERT_MSG_EQ (m_sizes[1], 2, "Second beacon");
+      NS_TEST_ASSERT_MSG_EQ (m_sizes[2], 1, "The expiry is reported");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_sizesMatch, true, "TableSize follows the table");
+  NS_TEST_ASSERT_MSG_EQ (m_node->GetDistanceTable ().GetSize (), 1, "B1 left");
+
+  NS_TEST_ASSERT_MSG_EQ (m_senders.size (), 1, "One interface");
+  NS_TEST_ASSERT_MSG_EQ ((m_senders.count (Ipv4Address ("10.0.0.2")) == 1), true, "Sent from the address of N");
+  NS_TEST_ASSERT_MSG_GT (m_types[dvhop::DVHOPTYPE_ADVERTISEMENT], 0, "HELLOs");
+  NS_TEST_ASSERT_MSG_GT (m_types[dvhop::DVHOPTYPE_NEIGHBOR_HELLO], 0, "Neighbour HELLOs");
+  NS_TEST_ASSERT_MSG_GT (m_types[dvhop::DVHOPTYPE_HOP_SIZE], 0, "Relayed hop size corrections");
+  m_node = 0;
+  Simulator::Destroy ();
+}
+
+// N (0, 0) has one beacon in range, S (100, 0), which gives its hop size. B4 (100, 180) is
+// 2 hops from S through q (150, 90) and 3 from N, B2 (-100, -100) 2 hops from N through
+// p (-50, -50). r starts out of range, at (1000, 1000), as a relay or as a fourth beacon
+static NodeContainer
+CreateEstimateNetwork (DVHopHelper const &dvhop, bool beaconR = false)
+{
+  double xs[] = { 0, 100, 150, 100, -50, -100, 1000 };
+  double ys[] = { 0, 0, 90, 180, -50, -100, 1000 };
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < 7; ++i)
+    {
+      positions.push_back (Vector (xs[i], ys[i], 0));
+    }
+  std::vector<uint32_t> beacons;
+  beacons.push_back (1);
+  beacons.push_back (3);
+  beacons.push_back (5);
+  if (beaconR)
+    {
+      beacons.push_back (6);
+    }
+  return CreateDvhopNetwork (positions, beacons, dvhop);
+}
+
+// The lazy estimate: table changes coalesced within EstimateInterval, small hop changes
+// kept under EstimateHysteresis, beacon moves always solved again
+class DvhopLazyEstimateTestCase : public TestCase
+{
+public:
+  DvhopLazyEstimateTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+  void EstimateUpdate (Vector position, uint32_t beacons);
+  void Record (Ptr<dvhop::RoutingProtocol> node);
+  // Runs the network below until 40 s, with one change at 30 s, and returns node N
+  Ptr<dvhop::RoutingProtocol> RunChange (uint32_t hysteresis, bool shortcut);
+
+  std::vector<Time> m_changes;
+  std::vector<Time> m_estimates;
+  Vector m_before;
+};
+
+DvhopLazyEstimateTestCase::DvhopLazyEstimateTestCase ()
+  : TestCase ("Lazy position estimate")
+{
+}
+
+void
+DvhopLazyEstimateTestCase::TableUpdate (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops)
+{
+  m_changes.push_back (Simulator::Now ());
+}
+
+void
+DvhopLazyEstimateTestCase::EstimateUpdate (Vector position, uint32_t beacons)
+{
+  m_estimates.push_back (Simulator::Now ());
+}
+
+void
+DvhopLazyEstimateTestCase::Record (Ptr<dvhop::RoutingProtocol> node)
+{
+  m_before = node->GetPosition ();
+}
+
+Ptr<dvhop::RoutingProtocol>
+DvhopLazyEstimateTestCase::RunChange (uint32_t hysteresis, bool shortcut)
+{
+  DVHopHelper dvhop;
+  dvhop.Set ("EstimateHysteresis", UintegerValue (hysteresis));
+  NodeContainer nodes = CreateEstimateNetwork (dvhop);
+  Ptr<dvhop::RoutingProtocol> n = GetDvhop (nodes.Get (0));
+  n->TraceConnectWithoutContext ("EstimateUpdate", MakeCallback (&DvhopLazyEstimateTestCase::EstimateUpdate, this));
+
+  m_estimates.clear ();
+  Simulator::Schedule (Seconds (29), &DvhopLazyEstimateTestCase::Record, this, n);
+  if (shortcut)
+    {
+      // r moves in range of N and B4, but also of S, which keeps its 2 hops to B4: N gets
+      // 1 hop closer to B4, with the same hop size
+      Simulator::Schedule (Seconds (30), &MobilityModel::SetPosition, nodes.Get (6)->GetObject<MobilityModel> (), Vector (50, 90, 0));
+    }
+  else
+    {
+      Simulator::Schedule (Seconds (30), &dvhop::RoutingProtocol::SetPosition, GetDvhop (nodes.Get (5)), -100.0, -120.0);
+    }
+  Simulator::Stop (Seconds (40));
+  Simulator::Run ();
+  return n;
+}
+
+void
+DvhopLazyEstimateTestCase::DoRun (void)
+{
+  // Solved on a timer: N learns its 3 beacons and its hop size within a few HELLOs, and
+  // each burst of changes is solved once
+  const Time interval = Seconds (1);
+  DVHopHelper dvhop;
+  dvhop.Set ("EstimateInterval", TimeValue (interval));
+  NodeContainer nodes = CreateEstimateNetwork (dvhop);
+  Ptr<dvhop::RoutingProtocol> n = GetDvhop (nodes.Get (0));
+  n->TraceConnectWithoutContext ("TableUpdate", MakeCallback (&DvhopLazyEstimateTestCase::TableUpdate, this));
+  n->TraceConnectWithoutContext ("EstimateUpdate", MakeCallback (&DvhopLazyEstimateTestCase::EstimateUpdate, this));
+  Simulator::Stop (Seconds (20));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_changes.size () >= 3, true, "N learns its 3 beacons");
+  NS_TEST_ASSERT_MSG_GT (m_estimates.size (), 0, "N is localized without reading its position");
+  NS_TEST_ASSERT_MSG_LT (m_estimates.size (), m_changes.size (), "Several changes are solved at once");
+  if (!m_changes.empty () && !m_estimates.empty ())
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_estimates[0] >= m_changes[0] + interval), true, "The first change waits for the interval");
+    }
+  for (uint32_t i = 1; i < m_estimates.size (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_estimates[i] - m_estimates[i - 1] >= interval), true, "At most one solve per interval");
+    }
+  Simulator::Destroy ();
+
+  // On demand: one hop less to B4 is below a hysteresis of 2, the position read at 29 s is kept
+  n = RunChange (2, true);
+  Ipv4Address b4 = Ipv4Address ("10.0.0.4");
+  NS_TEST_ASSERT_MSG_EQ (n->GetDistanceTable ().GetHopsTo (b4), 2, "N gets closer to B4");
+  Vector after = n->GetPosition ();
+  NS_TEST_ASSERT_MSG_EQ (m_estimates.empty () || m_estimates.back () < Seconds (30), true, "No estimate after the change");
+  NS_TEST_ASSERT_MSG_EQ ((after.x == m_before.x && after.y == m_before.y), true, "Small hop changes keep the estimate");
+  Simulator::Destroy ();
+
+  // The same change without hysteresis gives a new estimate
+  n = RunChange (0, true);
+  NS_TEST_ASSERT_MSG_EQ (n->GetDistanceTable ().GetHopsTo (b4), 2, "N gets closer to B4");
+  after = n->GetPosition ();
+  NS_TEST_ASSERT_MSG_EQ ((!m_estimates.empty () && m_estimates.back () >= Seconds (30)), true, "Solved again when read");
+  NS_TEST_ASSERT_MSG_EQ ((after.x != m_before.x || after.y != m_before.y), true, "The estimate follows the hop change");
+  Simulator::Destroy ();
+
+  // A beacon move invalidates the estimate whatever the hysteresis
+  n = RunChange (1000, false);
+  after = n->GetPosition ();
+  NS_TEST_ASSERT_MSG_EQ ((!m_estimates.empty () && m_estimates.back () >= Seconds (30)), true, "Solved again when read");
+  NS_TEST_ASSERT_MSG_EQ ((after.x != m_before.x || after.y != m_before.y), true, "The estimate follows the beacon");
+  Simulator::Destroy ();
+}
+
+// A new beacon restarts the refined estimate from the linear solution, where a warm start
+// would only take a step from the old estimate
+class DvhopWarmStartTestCase : public TestCase
+{
+public:
+  DvhopWarmStartTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Record (Ptr<dvhop::RoutingProtocol> node);
+
+  Vector m_before;
+};
+
+DvhopWarmStartTestCase::DvhopWarmStartTestCase ()
+  : TestCase ("Refined estimate with a new beacon")
+{
+}
+
+void
+DvhopWarmStartTestCase::Record (Ptr<dvhop::RoutingProtocol> node)
+{
+  m_before = node->GetPosition ();
+}
+
+void
+DvhopWarmStartTestCase::DoRun (void)
+{
+  // One iteration per estimate, so that a warm start cannot reach the new optimum
+  DVHopHelper dvhop;
+  dvhop.Set ("Refinement", BooleanValue (true));
+  dvhop.Set ("RefinementIterations", UintegerValue (1));
+  NodeContainer nodes = CreateEstimateNetwork (dvhop, true);
+  Ptr<dvhop::RoutingProtocol> n = GetDvhop (nodes.Get (0));
+  Ptr<dvhop::RoutingProtocol> r = GetDvhop (nodes.Get (6));
+
+  // The fourth beacon r comes 1 hop from N, at (-60, 80)
+  Simulator::Schedule (Seconds (29), &DvhopWarmStartTestCase::Record, this, n);
+  Simulator::Schedule (Seconds (30), &MobilityModel::SetPosition, nodes.Get (6)->GetObject<MobilityModel> (), Vector (-60, 80, 0));
+  Simulator::Schedule (Seconds (30), &dvhop::RoutingProtocol::SetPosition, r, -60.0, 80.0);
+  Simulator::Stop (Seconds (40));
+  Simulator::Run ();
+
+  dvhop::DistanceTable const &table = n->GetDistanceTable ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 4, "N learns the fourth beacon");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (Ipv4Address ("10.0.0.7")), 1, "One hop away");
+  Vector after = n->GetPosition ();
+  NS_TEST_ASSERT_MSG_GT (std::hypot (after.x - m_before.x, after.y - m_before.y), 1, "The new beacon moves the estimate");
+
+  // The same solve and single iteration, from scratch
+  dvhop::Localization loc;
+  table.ForEach ([&loc] (Ipv4Address, dvhop::BeaconInfo const &info)
+    {
+      loc.AddBeacon (info.GetPosition ().first, info.GetPosition ().second, info.GetHops ());
+    });
+  double x = 0, y = 0;
+  NS_TEST_ASSERT_MSG_EQ (loc.Solve (n->GetHopSize (), x, y), true, "4 beacons, not collinear");
+  dvhop::Localization::Refine (table, n->GetHopSize (), 1, 0.01, x, y);
+  NS_TEST_ASSERT_MSG_EQ_TOL (after.x, x, 1e-6, "Restarted from the linear solution");
+  NS_TEST_ASSERT_MSG_EQ_TOL (after.y, y, 1e-6, "Restarted from the linear solution");
+  Simulator::Destroy ();
+}
+
+// Least-squares multilateration against exact and noisy ranges
+class DvhopLocalizationTestCase : public TestCase
+{
+public:
+  DvhopLocalizationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopLocalizationTestCase::DvhopLocalizationTestCase ()
+  : TestCase ("Least-squares multilateration")
+{
+}
+
+void
+DvhopLocalizationTestCase::DoRun (void)
+{
+  double bx[] = { 250, 150, 350, 0, 500 };
+  double by[] = { 400, 200, 150, 0, 500 };
+  double px = 210, py = 260;
+  double x = -1, y = -1;
+
+  dvhop::Localization loc;
+  loc.AddBeacon (bx[0], by[0], std::hypot (px - bx[0], py - by[0]));
+  loc.AddBeacon (bx[1], by[1], std::hypot (px - bx[1], py - by[1]));
+  NS_TEST_ASSERT_MSG_EQ (loc.Solve (1.0, x, y), false, "Two beacons are not enough");
+  loc.AddBeacon (bx[2], by[2], std::hypot (px - bx[2], py - by[2]));
+  NS_TEST_ASSERT_MSG_EQ (loc.Solve (1.0, x, y), true, "Three beacons are enough");
+  NS_TEST_ASSERT_MSG_EQ_TOL (x, px, 1e-9, "Exact ranges give the exact X");
+  NS_TEST_ASSERT_MSG_EQ_TOL (y, py, 1e-9, "Exact ranges give the exact Y");
+
+  // Ranges 10% long, as with hop counts, still land near the node with 5 beacons
+  loc.Reset ();
+  for (uint32_t i = 0; i < 5; ++i)
+    {
+      loc.AddBeacon (bx[i], by[i], 1.1 * std::hypot (px - bx[i], py - by[i]));
+    }
+  NS_TEST_ASSERT_MSG_EQ (loc.Solve (1.0, x, y), true, "Overdetermined system");
+  NS_TEST_ASSERT_MSG_LT (std::hypot (x - px, y - py), 40, "Estimate close to the node");
+
+  // Rank-one removals and hop size scaling give the same answer as a fresh system
+  double ix, iy, fx, fy;
+  loc.RemoveBeacon (bx[4], by[4], 1.1 * std::hypot (px - bx[4], py - by[4]));
+  loc.RemoveBeacon (bx[0], by[0], 1.1 * std::hypot (px - bx[0], py - by[0]));
+  loc.Solve (2.0, ix, iy);
+  dvhop::Localization fresh;
+  for (uint32_t i = 1; i < 4; ++i)
+    {
+      fresh.AddBeacon (bx[i], by[i], 2.2 * std::hypot (px - bx[i], py - by[i]));
+    }
+  fresh.Solve (1.0, fx, fy);
+  NS_TEST_ASSERT_MSG_EQ (loc.GetNBeacons (), 3, "Two beacons removed");
+  NS_TEST_ASSERT_MSG_EQ_TOL (ix, fx, 1e-6, "Incremental X");
+  NS_TEST_ASSERT_MSG_EQ_TOL (iy, fy, 1e-6, "Incremental Y");
+
+  loc.Reset ();
+  loc.AddBeacon (0, 0, 10);
+  loc.AddBeacon (100, 100, 10);
+  loc.AddBeacon (200, 200, 10);
+  NS_TEST_ASSERT_MSG_EQ (loc.Solve (1.0, x, y), false, "Collinear beacons have no solution");
+}
+
+// The batch engine against the per-node solve, scalar, vectorized and threaded
+class DvhopBatchLocalizationTestCase : public TestCase
+{
+public:
+  DvhopBatchLocalizationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopBatchLocalizationTestCase::DvhopBatchLocalizationTestCase ()
+  : TestCase ("Batch localization")
+{
+}
+
+void
+DvhopBatchLocalizationTestCase::DoRun (void)
+{
+  const uint32_t nodes = 1000;
+  std::vector<dvhop::DistanceTable *> tables;
+  dvhop::BatchLocalization batch;
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      tables.push_back (new dvhop::DistanceTable ());
+      // From no beacon at all up to 22, to hit the tails of the vector kernel
+      for (uint32_t b = 0; b < n % 23; ++b)
+        {
+          tables[n]->AddBeacon (Ipv4Address (0x0a000001 + b), 1 + (n * 7 + b * 3) % 11, (b * 37) % 500 + 0.37 * b, (b * b * 11) % 500 + 0.11 * n);
+        }
+      batch.AddNode (*tables[n], 30 + n % 5);
+    }
+
+  batch.SetSimd (false);
+  batch.SetThreads (1);
+  batch.Solve ();
+  std::vector<double> scalarX (nodes), scalarY (nodes);
+  std::vector<bool> scalarSolved (nodes);
+  uint32_t solved = 0;
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      dvhop::Localization loc;
+      tables[n]->ForEach ([&loc] (Ipv4Address, dvhop::BeaconInfo const &info)
+        {
+          loc.AddBeacon (info.GetPosition ().first, info.GetPosition ().second, info.GetHops ());
+        });
+      double x = 0, y = 0;
+      bool expected = loc.Solve (30 + n % 5, x, y);
+      scalarSolved[n] = batch.GetPosition (n, scalarX[n], scalarY[n]);
+      NS_TEST_ASSERT_MSG_EQ (scalarSolved[n], expected, "Same nodes solved");
+      if (expected)
+        {
+          NS_TEST_ASSERT_MSG_EQ (scalarX[n], x, "The scalar kernel is bit-identical");
+          NS_TEST_ASSERT_MSG_EQ (scalarY[n], y, "The scalar kernel is bit-identical");
+          solved++;
+        }
+    }
+  NS_TEST_ASSERT_MSG_GT (solved, nodes / 2, "Most nodes have a solution");
+
+  // Threaded scalar, then vectorized on one thread and on several: the same nodes are solved
+  // every time, at the same positions
+  if (!dvhop::BatchLocalization::HasSimd ())
+    {
+      std::cout << GetName () << ": no AVX2 kernel on this CPU or in this build, "
+                << "vectorized runs skipped" << std::endl;
+    }
+  const bool simd[] = {false, true, true};
+  const uint32_t threads[] = {4, 1, 4};
+  for (uint32_t run = 0; run < 3; ++run)
+    {
+      if (simd[run] && !dvhop::BatchLocalization::HasSimd ())
+        {
+          continue;
+        }
+      batch.SetSimd (simd[run]);
+      batch.SetThreads (threads[run]);
+      batch.Solve ();
+      for (uint32_t n = 0; n < nodes; ++n)
+        {
+          double x = 0, y = 0;
+          bool ok = batch.GetPosition (n, x, y);
+          NS_TEST_ASSERT_MSG_EQ (ok, scalarSolved[n], "Same nodes solved, run " << run);
+          if (ok)
+            {
+              NS_TEST_ASSERT_MSG_EQ_TOL (x, scalarX[n], 1e-6, "Same X, run " << run);
+              NS_TEST_ASSERT_MSG_EQ_TOL (y, scalarY[n], 1e-6, "Same Y, run " << run);
+            }
+        }
+    }
+  for (uint32_t n = 0; n < nodes; ++n)
+    {
+      delete tables[n];
+    }
+}
+
+// Levenberg-Marquardt refinement of an estimate, cold and warm started
+class DvhopRefinementTestCase : public TestCase
+{
+public:
+  DvhopRefinementTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopRefinementTestCase::DvhopRefinementTestCase ()
+  : TestCase ("Position refinement")
+{
+}
+
+void
+DvhopRefinementTestCase::DoRun (void)
+{
+  // Beacons on a ring around the node, at hop counts that are exact for a hop size of 50
+  dvhop::DistanceTable table;
+  dvhop::Localization loc;
+  double px = 300, py = 200;
+  for (uint32_t b = 0; b < 8; ++b)
+    {
+      double angle = b * M_PI / 4;
+      uint16_t hops = 1 + b % 3;
+      double bx = px + 50 * hops * std::cos (angle);
+      double by = py + 50 * hops * std::sin (angle);
+      table.AddBeacon (Ipv4Address (0x0a000001 + b), hops, bx, by);
+      loc.AddBeacon (bx, by, hops);
+    }
+
+  // Hop sizes 10% off make the linear estimate miss the node
+  double x, y;
+  loc.Solve (55, x, y);
+  double linearError = std::hypot (x - px, y - py);
+  dvhop::Refinement refinement = dvhop::Localization::Refine (table, 50, 20, 1e-6, x, y);
+  NS_TEST_ASSERT_MSG_LT (std::hypot (x - px, y - py), 1e-3, "The refinement lands on the node");
+  NS_TEST_ASSERT_MSG_LT (std::hypot (x - px, y - py), linearError, "Better than the linear estimate");
+  NS_TEST_ASSERT_MSG_EQ ((refinement.iterations <= 20), true, "Bounded iterations");
+
+  // Warm started from a close estimate, it stops early
+  x = px + 0.5;
+  y = py - 0.5;
+  refinement = dvhop::Localization::Refine (table, 50, 20, 0.01, x, y);
+  NS_TEST_ASSERT_MSG_EQ ((refinement.iterations <= 2), true, "One or two iterations from a warm start");
+  NS_TEST_ASSERT_MSG_EQ (refinement.exit, dvhop::Refinement::CONVERGED, "Stopped on a short accepted step");
+  NS_TEST_ASSERT_MSG_LT (std::hypot (x - px, y - py), 0.01, "Warm start refined");
+
+  // Exact ranges of 50 m from (0, 0): there the residuals, and so the steps, are exactly zero,
+  // which never lowers the cost. A rejected step is no convergence, whatever its length
+  dvhop::DistanceTable exact;
+  exact.AddBeacon (Ipv4Address ("10.0.1.1"), 1, 30, 40);
+  exact.AddBeacon (Ipv4Address ("10.0.1.2"), 1, -40, 30);
+  exact.AddBeacon (Ipv4Address ("10.0.1.3"), 1, 0, -50);
+  x = 0;
+  y = 0;
+  refinement = dvhop::Localization::Refine (exact, 50, 5, 0.01, x, y);
+  NS_TEST_ASSERT_MSG_EQ (refinement.exit, dvhop::Refinement::REJECTED, "Every step is rejected");
+  NS_TEST_ASSERT_MSG_EQ (refinement.iterations, 5, "Rejected steps do not stop the refinement");
+  NS_TEST_ASSERT_MSG_EQ (refinement.cost, 0, "At the optimum");
+  NS_TEST_ASSERT_MSG_EQ ((x == 0 && y == 0), true, "Never moved");
+}
+
+// The same system solved with each numeric policy
+class DvhopLocalizationPrecisionTestCase : public TestCase
+{
+public:
+  DvhopLocalizationPrecisionTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopLocalizationPrecisionTestCase::DvhopLocalizationPrecisionTestCase ()
+  : TestCase ("Localization precisions")
+{
+}
+
+void
+DvhopLocalizationPrecisionTestCase::DoRun (void)
+{
+  dvhop::LocalizationSolver::Precision precisions[] = { dvhop::LocalizationSolver::DOUBLE,
+                                                        dvhop::LocalizationSolver::FLOAT,
+                                                        dvhop::LocalizationSolver::FIXED };
+  double tolerances[] = { 1e-6, 0.5, 0.5 };
+  double px = 1210.3, py = 2260.8;
+
+  for (uint32_t p = 0; p < 3; ++p)
+    {
+      dvhop::LocalizationSolver loc;
+      loc.SetPrecision (precisions[p]);
+      for (uint32_t b = 0; b < 12; ++b)
+        {
+          double bx = 1000 + (b * 131) % 700 + 0.25 * b;
+          double by = 2000 + (b * 257) % 600 - 0.5 * b;
+          loc.AddBeacon (bx, by, std::hypot (px - bx, py - by) / 40);
+        }
+      // A beacon that comes and goes, as with the incremental updates
+      loc.AddBeacon (1500, 2500, 3);
+      loc.RemoveBeacon (1500, 2500, 3);
+
+      double x, y;
+      NS_TEST_ASSERT_MSG_EQ (loc.GetNBeacons (), 12, "Beacon count");
+      NS_TEST_ASSERT_MSG_EQ (loc.Solve (40, x, y), true, "Solved");
+      NS_TEST_ASSERT_MSG_EQ_TOL (x, px, tolerances[p], "X within the precision");
+      NS_TEST_ASSERT_MSG_EQ_TOL (y, py, tolerances[p], "Y within the precision");
+    }
+
+  // The fixed-point sums hold n beacons up to 104 km / cbrt (n) from the first one
+  NS_TEST_ASSERT_MSG_EQ (dvhop::FixedPrecision::InRange (104000, 1, 1), true, "One beacon, 104 km");
+  NS_TEST_ASSERT_MSG_EQ (dvhop::FixedPrecision::InRange (104100, 1, 1), false, "One beacon, beyond 104 km");
+  NS_TEST_ASSERT_MSG_EQ (dvhop::FixedPrecision::InRange (48000, 100, 10), true, "10 beacons, 48 km");
+  NS_TEST_ASSERT_MSG_EQ (dvhop::FixedPrecision::InRange (48500, 100, 10), false, "10 beacons, beyond 48 km");
+
+  // 10 beacons up to 44 km from the first one, just under the bound: on whole meters and
+  // hops, the exact fixed-point sums give the double solution
+  dvhop::LocalizationSolver exact, fixed;
+  fixed.SetPrecision (dvhop::LocalizationSolver::FIXED);
+  px = 21500;
+  py = 17250;
+  for (uint32_t b = 0; b < 10; ++b)
+    {
+      double bx = (b * 13711) % 45000;
+      double by = (b * 29573) % 45000;
+      double hops = std::floor (std::hypot (px - bx, py - by) / 800 + 0.5);
+      exact.AddBeacon (bx, by, hops);
+      fixed.AddBeacon (bx, by, hops);
+    }
+  double ex, ey, fx, fy;
+  NS_TEST_ASSERT_MSG_EQ (exact.Solve (800, ex, ey), true, "Solved in double");
+  NS_TEST_ASSERT_MSG_EQ (fixed.Solve (800, fx, fy), true, "Solved in fixed point");
+  NS_TEST_ASSERT_MSG_EQ_TOL (fx, ex, 1e-3, "X near the bound");
+  NS_TEST_ASSERT_MSG_EQ_TOL (fy, ey, 1e-3, "Y near the bound");
+
+  // A beacon 200 km away leaves the fixed-point system without a solution, not the
+  // simulation, and its removal alone is not enough: the extent is that of a rebuild
+  exact.AddBeacon (200000, 0, 250);
+  fixed.AddBeacon (200000, 0, 250);
+  NS_TEST_ASSERT_MSG_EQ (exact.IsInRange (), true, "Double has no bound");
+  NS_TEST_ASSERT_MSG_EQ (fixed.IsInRange (), false, "Out of the fixed-point range");
+  NS_TEST_ASSERT_MSG_EQ (fixed.Solve (800, fx, fy), false, "No fixed-point solution");
+  NS_TEST_ASSERT_MSG_EQ (exact.Solve (800, ex, ey), true, "Still solved in double");
+  fixed.RemoveBeacon (200000, 0, 250);
+  NS_TEST_ASSERT_MSG_EQ (fixed.GetNBeacons (), 10, "Removed");
+  NS_TEST_ASSERT_MSG_EQ (fixed.Solve (800, fx, fy), false, "No solution until rebuilt");
+  fixed.Reset ();
+  for (uint32_t b = 0; b < 10; ++b)
+    {
+      double bx = (b * 13711) % 45000;
+      double by = (b * 29573) % 45000;
+      fixed.AddBeacon (bx, by, std::floor (std::hypot (px - bx, py - by) / 800 + 0.5));
+    }
+  NS_TEST_ASSERT_MSG_EQ (fixed.IsInRange (), true, "Rebuilt from the beacons left");
+  NS_TEST_ASSERT_MSG_EQ (fixed.Solve (800, fx, fy), true, "Solved again");
+}
+
+// Analytical engine: links, hop counts and hop sizes on a small known topology
+class DvhopAnalyticalEngineTestCase : public TestCase
+{
+public:
+  DvhopAnalyticalEngineTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopAnalyticalEngineTestCase::DvhopAnalyticalEngineTestCase ()
+  : TestCase ("Analytical engine")
+{
+}
+
+void
+DvhopAnalyticalEngineTestCase::DoRun (void)
+{
+  // 8x8 grid, 100 m apart, range 100 m: the hop counts are Manhattan distances
+  dvhop::AnalyticalEngine engine;
+  engine.SetRange (100);
+  engine.SetThreads (2);
+  for (uint32_t i = 0; i < 64; ++i)
+    {
+      bool beacon = i == 0 || i == 7 || i == 56 || i == 63 || i == 27;
+      engine.AddNode ((i % 8) * 100.0, (i / 8) * 100.0, beacon);
+    }
+  engine.Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (engine.GetNBeacons (), 5, "Beacon count");
+  NS_TEST_ASSERT_MSG_EQ (engine.GetNLinks (), 2 * 8 * 7, "Grid links");
+  for (uint32_t node = 0; node < 64; ++node)
+    {
+      for (uint32_t b = 0; b < engine.GetNBeacons (); ++b)
+        {
+          uint32_t beacon = engine.GetBeaconNode (b);
+          uint16_t expected = std::abs (int (node % 8) - int (beacon % 8)) + std::abs (int (node / 8) - int (beacon / 8));
+          NS_TEST_ASSERT_MSG_EQ (engine.GetHops (node, b), expected, "Manhattan hop count");
+        }
+    }
+  // Beacon 0 reaches 7 and 56 in 7 hops, 700 m, 63 in 14 hops, 990 m, and 27 in 6 hops, 424 m
+  double expectedHopSize = (700 + 700 + std::hypot (700, 700) + std::hypot (300, 300)) / (7 + 7 + 14 + 6);
+  NS_TEST_ASSERT_MSG_EQ_TOL (engine.GetHopSize (0), expectedHopSize, 1e-9, "Hop size of a beacon");
+  NS_TEST_ASSERT_MSG_EQ_TOL (engine.GetHopSize (1), expectedHopSize, 1e-9, "Hop size of the nearest beacon");
+
+  double x, y;
+  NS_TEST_ASSERT_MSG_EQ (engine.GetPosition (0, x, y), false, "Beacons are not estimated");
+  NS_TEST_ASSERT_MSG_EQ (engine.GetPosition (36, x, y), true, "Estimated");
+
+  // The table of a node holds what the engine found
+  dvhop::DistanceTable table;
+  engine.FillTable (36, table);
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 5, "Every beacon reached");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (Ipv4Address ("10.0.0.28")), 2, "Node 36 is 2 hops from node 27");
+
+  // A node out of reach of everyone
+  engine.AddNode (5000, 5000, false);
+  engine.Run ();
+  NS_TEST_ASSERT_MSG_EQ (engine.GetHopSize (64), 0, "No beacon, no hop size");
+  NS_TEST_ASSERT_MSG_EQ (engine.GetPosition (64, x, y), false, "Not localized");
+}
+
+// Analytical hop counts against the tables of a converged packet-level run, over
+// ad hoc Wi-Fi or over unit-disk devices
+class DvhopAnalyticalValidationTestCase : public TestCase
+{
+public:
+  DvhopAnalyticalValidationTestCase (bool unitDisk);
+
+private:
+  virtual void DoRun (void);
+  bool m_unitDisk;
+};
+
+DvhopAnalyticalValidationTestCase::DvhopAnalyticalValidationTestCase (bool unitDisk)
+  : TestCase (unitDisk ? "Analytical engine against a packet-level run on unit-disk devices"
+                       : "Analytical engine against a packet-level run"),
+    m_unitDisk (unitDisk)
+{
+}
+
+void
+DvhopAnalyticalValidationTestCase::DoRun (void)
+{
+  // 5x5 grid, 100 m apart, radios cut at 110 m: only the grid neighbours hear each other
+  const uint32_t width = 5;
+  const double step = 100;
+  const double range = 110;
+  uint32_t beacons[] = { 0, 4, 12, 20, 24 };
+
+  NodeContainer nodes;
+  nodes.Create (width * width);
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      positions->Add (Vector ((i % width) * step, (i / width) * step, 0));
+    }
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  NetDeviceContainer devices;
+  if (m_unitDisk)
+    {
+      UnitDiskHelper unitDisk;
+      unitDisk.SetChannelAttribute ("Range", DoubleValue (range));
+      devices = unitDisk.Install (nodes);
+    }
+  else
+    {
+      WifiMacHelper wifiMac;
+      wifiMac.SetType ("ns3::AdhocWifiMac");
+      YansWifiChannelHelper wifiChannel;
+      wifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
+      wifiChannel.AddPropagationLoss ("ns3::RangePropagationLossModel", "MaxRange", DoubleValue (range));
+      YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
+      wifiPhy.SetChannel (wifiChannel.Create ());
+      WifiHelper wifi;
+      wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
+      devices = wifi.Install (wifiPhy, wifiMac, nodes);
+    }
+
+  DVHopHelper dvhop;
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (dvhop);
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  address.Assign (devices);
+
+  dvhop::AnalyticalEngine engine;
+  engine.SetRange (range);
+  std::vector<Ptr<dvhop::RoutingProtocol> > protocols;
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      protocols.push_back (DynamicCast<dvhop::RoutingProtocol> (nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ()));
+      bool beacon = std::find (beacons, beacons + 5, i) != beacons + 5;
+      if (beacon)
+        {
+          protocols[i]->SetIsBeacon (true);
+          protocols[i]->SetPosition ((i % width) * step, (i / width) * step);
+        }
+      engine.AddNode ((i % width) * step, (i / width) * step, beacon);
+    }
+  engine.Run ();
+
+  // Plenty of HELLO rounds for the 8 hops of the diameter
+  Simulator::Stop (Seconds (30));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      dvhop::DistanceTable const &table = protocols[i]->GetDistanceTable ();
+      uint32_t reached = 0;
+      for (uint32_t b = 0; b < engine.GetNBeacons (); ++b)
+        {
+          uint16_t hops = engine.GetHops (i, b);
+          reached += hops != 0 ? 1 : 0;
+          NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (engine.GetAddress (engine.GetBeaconNode (b))), hops,
+                                 "Hops of node " << i << " to beacon " << engine.GetBeaconNode (b));
+        }
+      NS_TEST_ASSERT_MSG_EQ (table.GetSize (), reached, "Same beacons in the table of node " << i);
+    }
+  Simulator::Destroy ();
+}
+
+// Records every signal handed to it by a channel: transmitter, receiver and time
+class ReceptionRecorder : public SpectrumPhy
+{
+public:
+  typedef std::set<std::pair<std::pair<uint32_t, uint32_t>, int64_t> > Receptions;
+
+  ReceptionRecorder (uint32_t id, Receptions *receptions) : m_id (id), m_receptions (receptions) {}
+
+  virtual void SetDevice (Ptr<NetDevice> d)                 {}
+  virtual Ptr<NetDevice> GetDevice () const                 { return Ptr<NetDevice> (); }
+  virtual void SetMobility (Ptr<MobilityModel> m)           { m_mobility = m; }
+  virtual Ptr<MobilityModel> GetMobility ()                 { return m_mobility; }
+  virtual void SetChannel (Ptr<SpectrumChannel> c)          {}
+  virtual Ptr<const SpectrumModel> GetRxSpectrumModel () const { return Ptr<const SpectrumModel> (); }
+  virtual Ptr<AntennaModel> GetRxAntenna ()                 { return Ptr<AntennaModel> (); }
+  virtual void StartRx (Ptr<SpectrumSignalParameters> params)
+  {
+    uint32_t sender = DynamicCast<ReceptionRecorder> (params->txPhy)->m_id;
+    m_receptions->insert (std::make_pair (std::make_pair (sender, m_id), Simulator::Now ().GetTimeStep ()));
+  }
+
+private:
+  uint32_t m_id;
+  Receptions *m_receptions;
+  Ptr<MobilityModel> m_mobility;
+};
+
+// Candidates of the spatial grid against a brute-force search
+class DvhopSpatialGridTestCase : public TestCase
+{
+public:
+  DvhopSpatialGridTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DvhopSpatialGridTestCase::DvhopSpatialGridTestCase ()
+  : TestCase ("Spatial grid")
+{
+}
+
+void
+DvhopSpatialGridTestCase::DoRun (void)
+{
+  const double range = 50;
+  // A dense cluster, and two points far away, which make the cells coarser
+  std::vector<double> xs, ys;
+  for (uint32_t i = 0; i < 200; ++i)
+    {
+      xs.push_back ((i * 137) % 400 - 100.5);
+      ys.push_back ((i * 251) % 300 - 50.25);
+    }
+  xs.push_back (1e5);
+  ys.push_back (-3e4);
+  xs.push_back (-2e4);
+  ys.push_back (7e4);
+
+  dvhop::SpatialGrid grid;
+  for (uint32_t i = 0; i < xs.size (); ++i)
+    {
+      grid.Add (1000 + i, xs[i], ys[i]);
+    }
+  grid.Build (range);
+  NS_TEST_ASSERT_MSG_EQ (grid.GetNItems (), xs.size (), "Every point indexed");
+  NS_TEST_ASSERT_MSG_EQ ((grid.GetCellSize () >= range), true, "Cells never narrower than the range");
+  NS_TEST_ASSERT_MSG_EQ ((grid.GetNCells () <= 4 * xs.size ()), true, "Cells bounded by the points");
+
+  // From every point, and from positions outside the box of the points
+  std::vector<double> qx (xs), qy (ys);
+  qx.push_back (-1e6);
+  qy.push_back (0);
+  qx.push_back (1e5 + 30);
+  qy.push_back (-3e4 - 30);
+  for (uint32_t q = 0; q < qx.size (); ++q)
+    {
+      std::vector<uint32_t> near;
+      grid.GetNear (qx[q], qy[q], near);
+      std::set<uint32_t> found (near.begin (), near.end ());
+      NS_TEST_ASSERT_MSG_EQ (found.size (), near.size (), "No point twice");
+      for (uint32_t i = 0; i < xs.size (); ++i)
+        {
+          if (std::hypot (xs[i] - qx[q], ys[i] - qy[q]) <= range)
+            {
+              NS_TEST_ASSERT_MSG_EQ (found.count (1000 + i), 1, "Point " << i << " in range of query " << q);
+            }
+        }
+    }
+
+  grid.Clear ();
+  grid.Build (range);
+  std::vector<uint32_t> near;
+  grid.GetNear (0, 0, near);
+  NS_TEST_ASSERT_MSG_EQ (near.size (), 0, "Empty grid");
+}
+
+// Grid channel against the stock single-model channel: same receivers, at the same times
+class DvhopGridChannelTestCase : public TestCase
+{
+public:
+  DvhopGridChannelTestCase ();
+
+private:
+  virtual void DoRun (void);
+  // Every PHY transmits once, 1 ms apart, on the channel
+  ReceptionRecorder::Receptions Transmit (Ptr<SpectrumChannel> channel);
+};
+
+DvhopGridChannelTestCase::DvhopGridChannelTestCase ()
+  : TestCase ("Grid spectrum channel")
+{
+}
+
+ReceptionRecorder::Receptions
+DvhopGridChannelTestCase::Transmit (Ptr<SpectrumChannel> channel)
+{
+  const double range = 120;
+  channel->SetAttribute ("MaxLossDb", DoubleValue (150));
+  Ptr<RangePropagationLossModel> loss = CreateObject<RangePropagationLossModel> ();
+  loss->SetAttribute ("MaxRange", DoubleValue (range));
+  channel->AddPropagationLossModel (loss);
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  ReceptionRecorder::Receptions receptions;
+  std::vector<Ptr<ReceptionRecorder> > phys;
+  for (uint32_t i = 0; i < 60; ++i)
+    {
+      Ptr<ReceptionRecorder> phy = Create<ReceptionRecorder> (i, &receptions);
+      Ptr<MobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      // Scattered over 500 x 500 m, some at negative coordinates
+      mobility->SetPosition (Vector ((i * 137) % 500 - 100.5, (i * 251) % 500 - 50.25, 0));
+      phy->SetMobility (mobility);
+      channel->AddRx (phy);
+      phys.push_back (phy);
+    }
+
+  Ptr<SpectrumModel> model = Create<SpectrumModel> (std::vector<double> (1, 2.4e9));
+  for (uint32_t i = 0; i < phys.size (); ++i)
+    {
+      Ptr<SpectrumSignalParameters> params = Create<SpectrumSignalParameters> ();
+      params->psd = Create<SpectrumValue> (model);
+      params->txPhy = phys[i];
+      params->duration = MicroSeconds (100);
+      Simulator::Schedule (MilliSeconds (i), &SpectrumChannel::StartTx, channel, params);
+    }
+  Simulator::Run ();
+  return receptions;
+}
+
+void
+DvhopGridChannelTestCase::DoRun (void)
+{
+  ReceptionRecorder::Receptions stock = Transmit (CreateObject<SingleModelSpectrumChannel> ());
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_GT (stock.size (), 0, "Some PHYs are in range of each other");
+
+  // A cutoff at the range, and one beyond it: the loss model decides
+  double cutoffs[] = { 120, 300 };
+  for (uint32_t c = 0; c < 2; ++c)
+    {
+      Ptr<dvhop::GridSpectrumChannel> grid = CreateObject<dvhop::GridSpectrumChannel> ();
+      grid->SetAttribute ("Cutoff", DoubleValue (cutoffs[c]));
+      ReceptionRecorder::Receptions indexed = Transmit (grid);
+      NS_TEST_ASSERT_MSG_EQ (indexed.size (), stock.size (), "Same number of receptions, cutoff " << cutoffs[c]);
+      NS_TEST_ASSERT_MSG_EQ ((indexed == stock), true, "Same receivers at the same times, cutoff " << cutoffs[c]);
+      if (cutoffs[c] == 120)
+        {
+          NS_TEST_ASSERT_MSG_LT (grid->GetNCachedLinks (), 60 * 59 / 2, "Only the pairs of nearby cells are evaluated");
+        }
+      Simulator::Destroy ();
+    }
+}
+
+// Reach, delay and losses of the unit-disk channel, on bare devices
+class DvhopUnitDiskTestCase : public TestCase
+{
+public:
+  DvhopUnitDiskTestCase ();
+
+private:
+  virtual void DoRun (void);
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from);
+  void Lost (Ptr<const Packet> packet);
+
+  std::vector<std::pair<Ptr<NetDevice>, Time> > m_received;
+  uint32_t m_lost;
+};
+
+DvhopUnitDiskTestCase::DvhopUnitDiskTestCase ()
+  : TestCase ("Unit-disk devices"),
+    m_lost (0)
+{
+}
+
+bool
+DvhopUnitDiskTestCase::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from)
+{
+  m_received.push_back (std::make_pair (device, Simulator::Now ()));
+  return true;
+}
+
+void
+DvhopUnitDiskTestCase::Lost (Ptr<const Packet> packet)
+{
+  ++m_lost;
+}
+
+void
+DvhopUnitDiskTestCase::DoRun (void)
+{
+  // Three nodes on a line: 1 is 60 m from 0, 2 is 150 m from 0 and 90 m from 1
+  NodeContainer nodes;
+  nodes.Create (3);
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 0));
+  positions->Add (Vector (60, 0, 0));
+  positions->Add (Vector (150, 0, 0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  UnitDiskHelper unitDisk;
+  unitDisk.SetChannelAttribute ("Range", DoubleValue (100));
+  unitDisk.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
+  NetDeviceContainer devices = unitDisk.Install (nodes);
+  for (uint32_t i = 0; i < devices.GetN (); ++i)
+    {
+      devices.Get (i)->SetReceiveCallback (MakeCallback (&DvhopUnitDiskTestCase::Receive, this));
+      devices.Get (i)->TraceConnectWithoutContext ("Loss", MakeCallback (&DvhopUnitDiskTestCase::Lost, this));
+    }
+
+  // A broadcast from 0 at 1 s only reaches 1; a unicast from 1 to 0 only reaches 0
+  Simulator::Schedule (Seconds (1), &NetDevice::Send, devices.Get (0), Create<Packet> (20),
+                       devices.Get (0)->GetBroadcast (), 0x0800);
+  Simulator::Schedule (Seconds (2), &NetDevice::Send, devices.Get (1), Create<Packet> (20),
+                       devices.Get (0)->GetAddress (), 0x0800);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_received.size (), 2, "One receiver per frame");
+  if (m_received.size () == 2)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_received[0].first, devices.Get (1), "The broadcast reaches the node in range");
+      NS_TEST_ASSERT_MSG_EQ (m_received[0].second, Seconds (1) + MilliSeconds (2), "After the channel delay");
+      NS_TEST_ASSERT_MSG_EQ (m_received[1].first, devices.Get (0), "The unicast reaches its destination only");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_lost, 0, "No loss by default");
+
+  // Every link lost: the receivers are told, nothing is passed up
+  m_received.clear ();
+  Ptr<dvhop::UnitDiskChannel> channel = DynamicCast<dvhop::UnitDiskChannel> (devices.Get (0)->GetChannel ());
+  channel->SetAttribute ("LossProbability", DoubleValue (1));
+  Simulator::Schedule (Seconds (1), &NetDevice::Send, devices.Get (1), Create<Packet> (20),
+                       devices.Get (1)->GetBroadcast (), 0x0800);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_received.size (), 0, "Nothing received");
+  NS_TEST_ASSERT_MSG_EQ (m_lost, 2, "Both neighbours of 1 lose the frame");
+
+  // A longer range is taken at the next send: 0 now reaches 2 as well
+  m_received.clear ();
+  channel->SetAttribute ("LossProbability", DoubleValue (0));
+  channel->SetAttribute ("Range", DoubleValue (200));
+  Simulator::Schedule (Seconds (1), &NetDevice::Send, devices.Get (0), Create<Packet> (20),
+                       devices.Get (0)->GetBroadcast (), 0x0800);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_received.size (), 2, "Both other nodes in the new range");
+  Simulator::Destroy ();
+}
+
+// Early stop once the tables are quiet, checked against the BFS oracle
+class DvhopConvergenceTestCase : public TestCase
+{
+public:
+  DvhopConvergenceTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Converged (Time convergenceTime);
+
+  std::vector<Time> m_converged;
+};
+
+DvhopConvergenceTestCase::DvhopConvergenceTestCase ()
+  : TestCase ("Convergence monitor")
+{
+}
+
+void
+DvhopConvergenceTestCase::Converged (Time convergenceTime)
+{
+  m_converged.push_back (convergenceTime);
+}
+
+void
+DvhopConvergenceTestCase::DoRun (void)
+{
+  // 5x5 grid, 100 m apart, unit disk of 110 m, beacons at the corners and the centre
+  const uint32_t width = 5;
+  const double step = 100;
+  const double range = 110;
+  uint32_t beacons[] = { 0, 4, 12, 20, 24 };
+
+  NodeContainer nodes;
+  nodes.Create (width * width);
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      positions->Add (Vector ((i % width) * step, (i / width) * step, 0));
+    }
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  UnitDiskHelper unitDisk;
+  unitDisk.SetChannelAttribute ("Range", DoubleValue (range));
+  NetDeviceContainer devices = unitDisk.Install (nodes);
+  DVHopHelper dvhop;
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (dvhop);
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  address.Assign (devices);
+  for (uint32_t b = 0; b < 5; ++b)
+    {
+      Ptr<dvhop::RoutingProtocol> protocol = DynamicCast<dvhop::RoutingProtocol> (nodes.Get (beacons[b])->GetObject<Ipv4> ()->GetRoutingProtocol ());
+      protocol->SetIsBeacon (true);
+      protocol->SetPosition ((beacons[b] % width) * step, (beacons[b] / width) * step);
+    }
+
+  Ptr<dvhop::ConvergenceMonitor> monitor = CreateObject<dvhop::ConvergenceMonitor> ();
+  monitor->SetAttribute ("QuietIntervals", UintegerValue (3));
+  monitor->SetAttribute ("OracleRange", DoubleValue (range));
+  monitor->Install (nodes);
+
+  // A horizon far beyond the few seconds the 8 hops of the diameter take
+  Simulator::Stop (Seconds (1000));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (monitor->IsConverged (), true, "Converged");
+  NS_TEST_ASSERT_MSG_LT (Simulator::Now (), Seconds (1000), "Stopped at convergence");
+  NS_TEST_ASSERT_MSG_EQ (Simulator::Now (), monitor->GetDetectionTime (), "Stopped when detected");
+  NS_TEST_ASSERT_MSG_GT (monitor->GetConvergenceTime (), Seconds (0), "Tables were filled");
+  NS_TEST_ASSERT_MSG_GT (monitor->GetDetectionTime () - monitor->GetConvergenceTime (), Seconds (2),
+                         "Quiet for the checks after the last change");
+  NS_TEST_ASSERT_MSG_EQ (monitor->GetNOracleMismatches (), 0, "Tables match the BFS hop counts");
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((monitor->GetLastChange (i) <= monitor->GetConvergenceTime ()), true, "Last change of node " << i);
+    }
+  Simulator::Destroy ();
+
+  // Without stopping, a beacon that moves after the convergence changes the tables again,
+  // but not the convergence time
+  std::vector<Vector> line;
+  line.push_back (Vector (0, 0, 0));
+  line.push_back (Vector (100, 0, 0));
+  line.push_back (Vector (200, 0, 0));
+  std::vector<uint32_t> ends;
+  ends.push_back (0);
+  ends.push_back (2);
+  nodes = CreateDvhopNetwork (line, ends, dvhop);
+  monitor = CreateObject<dvhop::ConvergenceMonitor> ();
+  monitor->SetAttribute ("QuietIntervals", UintegerValue (3));
+  monitor->SetAttribute ("StopOnConvergence", BooleanValue (false));
+  monitor->TraceConnectWithoutContext ("Converged", MakeCallback (&DvhopConvergenceTestCase::Converged, this));
+  monitor->Install (nodes);
+  Simulator::Schedule (Seconds (20), &dvhop::RoutingProtocol::SetPosition, GetDvhop (nodes.Get (2)), 200.0, 10.0);
+  Simulator::Stop (Seconds (30));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (monitor->IsConverged (), true, "Converged before the move");
+  NS_TEST_ASSERT_MSG_LT (monitor->GetDetectionTime (), Seconds (20), "Detected before the move");
+  NS_TEST_ASSERT_MSG_GT (monitor->GetLastChange (), Seconds (20), "The move changes the tables");
+  NS_TEST_ASSERT_MSG_LT (monitor->GetConvergenceTime (), monitor->GetDetectionTime (), "Frozen at the convergence");
+  NS_TEST_ASSERT_MSG_EQ (m_converged.size (), 1, "Reported once");
+  if (!m_converged.empty ())
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_converged[0], monitor->GetConvergenceTime (), "The trace reports the convergence time");
+    }
+  Simulator::Destroy ();
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +2364,35 @@ DvhopTestSuite::DvhopTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new DvhopTestCase1, TestCase::QUICK);
+  AddTestCase (new DvhopCompactEncodingTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopAdvertisementTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopDuplicateCacheTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopFlatTableTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopTableGenerationTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopTableHorizonTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopTableExpiryTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopTableArenaTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopMprSelectionTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopHopSizeTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopLocalizationTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopBatchLocalizationTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopRefinementTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopLocalizationPrecisionTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopAnalyticalEngineTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopAnalyticalValidationTestCase (false), TestCase::QUICK);
+  AddTestCase (new DvhopAnalyticalValidationTestCase (true), TestCase::QUICK);
+  AddTestCase (new DvhopSpatialGridTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopGridChannelTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopUnitDiskTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopAdvertisementMtuTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopLegacyHelloTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopTriggeredUpdateTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopTrickleTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopHopSizeFloodTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopLazyEstimateTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopWarmStartTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopTraceSourcesTestCase, TestCase::QUICK);
+  AddTestCase (new DvhopConvergenceTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite